@@ -14,6 +14,9 @@ def main():
   ap.add_argument("--output-csv", "-ocsv", help="csv file for output data", default="out.csv")
   ap.add_argument("--output-plot", "-oplot", help="plot file dest", default="plot.pdf")
   ap.add_argument("--rows-to-plot", "-rplot", help="comma-separated list of rows to generate plots for (i.e. 0,1,2); or `all` to plot all rows", default="all")
+  ap.add_argument("--trials", "-t", type=int, help="number of benchmark runs per cpu count; with more than 1, the output csv reports the median and minimum of the runtime, and with at least 6, the 95%% confidence interval of the median", default=1)
+  ap.add_argument("--warmup", "-w", type=int, help="number of untimed benchmark runs per cpu count before the timed runs", default=0)
+  ap.add_argument("--check-system", action="store_true", help="warn about hyperthreading and CPU frequency scaling reported by lscpu")
   ap.add_argument("--args", "-a", nargs="*", help="binary arguments", default="")
 
   args = ap.parse_args()
@@ -33,7 +36,8 @@ def main():
     logger.warning("matplotlib required to generate plot.")
 
   # generate data and save to out_csv (defaults to out.csv)
-  run(bin_instrument, bin_bench, bin_args, out_csv, cpu_counts)
+  run(bin_instrument, bin_bench, bin_args, out_csv, cpu_counts,
+      max(1, args.trials), max(0, args.warmup), args.check_system)
 
   cpus = get_cpu_ordering()
   if can_plot and cpus:
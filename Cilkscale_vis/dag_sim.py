@@ -0,0 +1,236 @@
+import argparse
+import collections
+import heapq
+import random
+import statistics
+import struct
+import sys
+
+# Simulate the execution of a computation dag, recorded by Cilkscale when
+# CILKSCALE_DAG is set, under a randomized work-stealing scheduler.  See
+# cilkscale/dag.h for the file format.
+#
+# The simulator models the work-first scheduling of the OpenCilk runtime.
+# Each worker has a deque of continuations.  On a spawn, a worker pushes the
+# continuation of the spawning frame onto the bottom of its deque and executes
+# the spawned task.  When the task returns, the worker pops the continuation
+# from the bottom of its deque, if it is still there.  An idle worker
+# repeatedly picks a random victim and, after the steal latency, takes the
+# continuation at the top of the victim's deque, if any.  A frame that syncs
+# with outstanding children is suspended and then resumed by the worker that
+# completes its last child.
+
+MAGIC = b"CSCLDAG1"
+RECORD = struct.Struct("=qB7x")
+
+STRAND, SPAWN, TASK_EXIT, SYNC, CALL, RETURN, REGION_BEGIN, REGION_END = \
+  range(8)
+
+# Items of a frame
+ITEM_STRAND, ITEM_SPAWN, ITEM_CALL, ITEM_SYNC = range(4)
+
+class Frame:
+  """An execution of a spawning function or of a spawned task."""
+  __slots__ = ["items", "spawned", "parent", "pc", "outstanding", "suspended"]
+
+  def __init__(self, spawned=False, parent=None):
+    self.items = []
+    self.spawned = spawned
+    self.parent = parent
+    self.reset()
+
+  def reset(self):
+    self.pc = 0
+    self.outstanding = 0
+    self.suspended = False
+
+  def add_strand(self, time):
+    if time <= 0:
+      return
+    if self.items and self.items[-1][0] == ITEM_STRAND:
+      self.items[-1] = (ITEM_STRAND, self.items[-1][1] + time)
+    else:
+      self.items.append((ITEM_STRAND, time))
+
+def read_dag(path):
+  """Return the units, scale, and burden recorded in the file at path, and the
+  list of root frames of the recorded dags."""
+  with open(path, "rb") as f:
+    data = f.read()
+
+  if data[:len(MAGIC)] != MAGIC:
+    raise ValueError("%s is not a Cilkscale dag file" % path)
+  pos = len(MAGIC)
+  (units_len,) = struct.unpack_from("=I", data, pos)
+  pos += 4
+  units = data[pos:pos + units_len].decode()
+  pos += units_len
+  scale, burden, num_records = struct.unpack_from("=dqQ", data, pos)
+  pos += struct.calcsize("=dqQ")
+
+  roots = []
+  stack = []
+  for time, event in RECORD.iter_unpack(
+      data[pos:pos + num_records * RECORD.size]):
+    if event == REGION_BEGIN or not stack:
+      # Each recorded region, or else the whole computation, is a separate
+      # dag.
+      root = Frame()
+      roots.append(root)
+      stack = [root]
+      if event == REGION_BEGIN:
+        continue
+
+    frame = stack[-1]
+    frame.add_strand(time)
+    if event == SPAWN:
+      child = Frame(True, frame)
+      frame.items.append((ITEM_SPAWN, child))
+      stack.append(child)
+    elif event == CALL:
+      child = Frame(False, frame)
+      frame.items.append((ITEM_CALL, child))
+      stack.append(child)
+    elif event == TASK_EXIT or event == RETURN:
+      # Ignore unmatched task exits and returns at the root of a region.
+      if len(stack) > 1:
+        stack.pop()
+    elif event == SYNC:
+      frame.items.append((ITEM_SYNC, None))
+    elif event == REGION_END:
+      stack = []
+
+  return units, scale, burden, roots
+
+def reset_frames(root):
+  todo = [root]
+  while todo:
+    frame = todo.pop()
+    frame.reset()
+    todo.extend(child for kind, child in frame.items
+                if kind == ITEM_SPAWN or kind == ITEM_CALL)
+
+def simulate(root, P, latency, rng):
+  """Return the simulated running time of the dag rooted at root on P
+  workers."""
+  reset_frames(root)
+  deques = [collections.deque() for _ in range(P)]
+  # Events are (time, seq, worker, frame); frame is None for a worker that is
+  # trying to steal.
+  events = [(0, 0, 0, root)]
+  seq = 1
+  for w in range(1, P):
+    events.append((latency, seq, w, None))
+    seq += 1
+  heapq.heapify(events)
+
+  while events:
+    now, _, w, frame = heapq.heappop(events)
+    deque = deques[w]
+
+    if frame is None:
+      # Attempt a steal from a random victim.
+      if P > 1:
+        victim = rng.randrange(P - 1)
+        if victim >= w:
+          victim += 1
+        if deques[victim]:
+          frame = deques[victim].popleft()
+      if frame is None:
+        heapq.heappush(events, (now + latency, seq, w, None))
+        seq += 1
+        continue
+
+    # Execute frame until the worker runs a strand or runs out of work.
+    while frame is not None:
+      if frame.pc == len(frame.items):
+        # Implicit sync at the end of the frame.
+        if frame.outstanding:
+          frame.suspended = True
+          frame = None
+          break
+        if frame is root:
+          return now
+        parent = frame.parent
+        if not frame.spawned:
+          frame = parent
+          continue
+        parent.outstanding -= 1
+        if deque:
+          frame = deque.pop()
+        elif parent.suspended and not parent.outstanding:
+          parent.suspended = False
+          frame = parent
+        else:
+          frame = None
+        continue
+
+      kind, arg = frame.items[frame.pc]
+      frame.pc += 1
+      if kind == ITEM_STRAND:
+        heapq.heappush(events, (now + arg, seq, w, frame))
+        seq += 1
+        break
+      elif kind == ITEM_SPAWN:
+        frame.outstanding += 1
+        deque.append(frame)
+        frame = arg
+      elif kind == ITEM_CALL:
+        frame = arg
+      elif frame.outstanding:
+        frame.suspended = True
+        frame = None
+
+    if frame is None:
+      heapq.heappush(events, (now + latency, seq, w, None))
+      seq += 1
+
+  raise RuntimeError("simulation ended before the computation completed")
+
+def main():
+  ap = argparse.ArgumentParser(
+    description="Simulate a dag recorded by Cilkscale under a randomized "
+    "work-stealing scheduler.")
+  ap.add_argument("dag", help="dag file written by Cilkscale (CILKSCALE_DAG)")
+  ap.add_argument("--max-workers", "-p", type=int, default=8,
+                  help="simulate 1 to this many workers")
+  ap.add_argument("--steal-latency", "-l", type=float,
+                  help="time of each steal attempt, in the units of the "
+                  "recorded times (default: the burden used by Cilkscale)")
+  ap.add_argument("--trials", "-t", type=int, default=5,
+                  help="number of simulations per worker count; the median "
+                  "time is reported")
+  ap.add_argument("--seed", type=int, default=0, help="random seed")
+  ap.add_argument("--output-csv", "-ocsv",
+                  help="csv file for output data (default: stdout)")
+  args = ap.parse_args()
+
+  units, scale, burden, roots = read_dag(args.dag)
+  if not roots:
+    sys.exit("%s contains no recorded dag" % args.dag)
+  if args.steal_latency is None:
+    latency = max(burden, 1)
+  else:
+    latency = max(args.steal_latency / scale, 1)
+
+  rng = random.Random(args.seed)
+  rows = ["workers,time (%s),speedup" % units]
+  t1 = None
+  for P in range(1, args.max_workers + 1):
+    # Multiple recorded regions are assumed to execute one after another.
+    time = statistics.median(
+      sum(simulate(root, P, latency, rng) for root in roots)
+      for _ in range(max(1, args.trials)))
+    if t1 is None:
+      t1 = time
+    rows.append("%d,%g,%g" % (P, time * scale,
+                              t1 / time if time else float("nan")))
+
+  if args.output_csv:
+    with open(args.output_csv, "w") as out:
+      out.write("\n".join(rows) + "\n")
+  else:
+    print("\n".join(rows))
+
+if __name__ == '__main__':
+  main()
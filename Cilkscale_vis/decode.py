@@ -0,0 +1,99 @@
+import argparse
+import struct
+import sys
+
+# Decode the binary output written by Cilkscale or cilkscale-benchmark when
+# CILKSCALE_OUT_BINARY is set, and print it in the CSV format those tools
+# otherwise produce.  See cilkscale/binary_sink.h for the file format.
+
+MAGIC = b"CSCLBIN1"
+MAX_VALUES = 3
+RECORD = struct.Struct("=QII%dq" % MAX_VALUES)
+
+class Reader:
+  def __init__(self, data):
+    self.data = data
+    self.pos = 0
+
+  def at_end(self):
+    return self.pos >= len(self.data)
+
+  def unpack(self, fmt):
+    values = struct.unpack_from(fmt, self.data, self.pos)
+    self.pos += struct.calcsize(fmt)
+    return values
+
+  def bytes(self, n):
+    if self.pos + n > len(self.data):
+      raise ValueError("truncated file")
+    value = self.data[self.pos:self.pos + n]
+    self.pos += n
+    return value
+
+def read_results(path):
+  """Return the number of values per record, the units, the scale, and the
+  list of (tag, values) records in the order they were recorded."""
+  with open(path, "rb") as f:
+    r = Reader(f.read())
+
+  if r.bytes(len(MAGIC)) != MAGIC:
+    raise ValueError("%s is not a Cilkscale binary output file" % path)
+  num_values, units_len = r.unpack("=II")
+  units = r.bytes(units_len).decode()
+  (scale,) = r.unpack("=d")
+
+  records = []
+  while not r.at_end():
+    (num_tags,) = r.unpack("=I")
+    tags = []
+    for _ in range(num_tags):
+      (length,) = r.unpack("=I")
+      tags.append(r.bytes(length).decode(errors="replace"))
+    (num_records,) = r.unpack("=Q")
+    for _ in range(num_records):
+      seq, tag, _, *values = RECORD.unpack(r.bytes(RECORD.size))
+      records.append((seq, tags[tag], values[:num_values]))
+
+  records.sort(key=lambda rec: rec[0])
+  return num_values, units, scale, [(tag, values) for _, tag, values in records]
+
+def fmt(x):
+  # Match the default formatting of floating-point values by iostreams.
+  return "%g" % x
+
+def ratio(num, den):
+  if den == 0:
+    return float("nan") if num == 0 else float("inf")
+  return num / den
+
+def write_csv(out, num_values, units, scale, records):
+  if num_values == 1:
+    out.write("tag,time (%s)\n" % units)
+    for tag, (time,) in records:
+      out.write("%s,%s\n" % (tag, fmt(time * scale)))
+    return
+
+  out.write("tag,work (%s),span (%s),parallelism,burdened_span (%s),"
+            "burdened_parallelism\n" % (units, units, units))
+  for tag, (work, span, bspan) in records:
+    out.write("%s,%s,%s,%s,%s,%s\n" % (
+      tag, fmt(work * scale), fmt(span * scale), fmt(ratio(work, span)),
+      fmt(bspan * scale), fmt(ratio(work, bspan))))
+
+def main():
+  ap = argparse.ArgumentParser(
+    description="Convert Cilkscale binary output to CSV.")
+  ap.add_argument("input", help="binary output file written by Cilkscale")
+  ap.add_argument("--output-csv", "-ocsv",
+                  help="csv file for output data (default: stdout)")
+  args = ap.parse_args()
+
+  num_values, units, scale, records = read_results(args.input)
+  if args.output_csv:
+    with open(args.output_csv, "w") as out:
+      write_csv(out, num_values, units, scale, records)
+  else:
+    write_csv(sys.stdout, num_values, units, scale, records)
+
+if __name__ == '__main__':
+  main()
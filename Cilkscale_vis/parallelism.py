@@ -0,0 +1,62 @@
+import argparse
+import csv
+import logging
+import sys
+from plotter import can_plot
+
+# Plot the parallelism profile written by Cilkscale when CILKSCALE_PARALLELISM
+# is set: the available parallelism over the execution of the program's serial
+# elision.
+
+logger = logging.getLogger(sys.argv[0])
+
+def read_profile(profile_csv):
+  with open(profile_csv, "r") as f:
+    rows = list(csv.reader(f, delimiter=","))
+  units = rows[0][0].split("(", 1)[1].rstrip(")") if "(" in rows[0][0] else ""
+  begin = [float(row[0]) for row in rows[1:]]
+  end = [float(row[1]) for row in rows[1:]]
+  parallelism = [float(row[2]) for row in rows[1:]]
+  return units, begin, end, parallelism
+
+def plot_parallelism(profile_csv, out_plot="parallelism.pdf", max_workers=0):
+  units, begin, end, parallelism = read_profile(profile_csv)
+
+  # matplotlib.use() must be called before importing matplotlib.pyplot.
+  import matplotlib
+  matplotlib.use('PDF')
+  import matplotlib.pyplot as plt
+  fig, ax = plt.subplots(figsize=(12,6))
+
+  widths = [e - b for b, e in zip(begin, end)]
+  ax.bar(begin, parallelism, width=widths, align="edge", color="m",
+         label="Parallelism")
+  if max_workers:
+    ax.axhline(y=max_workers, ls=":", c="gray",
+               label=str(max_workers) + " workers")
+
+  ax.set_xlabel("Work of serial execution (" + units + ")")
+  ax.set_ylabel("Parallelism")
+  ax.set_yscale("log")
+  ax.set_title("Parallelism profile")
+  ax.set_facecolor([0.97] * 3)
+  ax.grid(linestyle=":")
+  ax.legend(loc="upper right")
+
+  logger.info("Generating parallelism profile plot " + out_plot)
+  plt.savefig(out_plot)
+
+def main():
+  ap = argparse.ArgumentParser()
+  ap.add_argument("profile_csv", help="parallelism profile written by Cilkscale (CILKSCALE_PARALLELISM)")
+  ap.add_argument("--output-plot", "-oplot", help="plot file dest", default="parallelism.pdf")
+  ap.add_argument("--max-workers", "-p", type=int, help="number of workers to mark on the plot", default=0)
+  args = ap.parse_args()
+
+  logging.basicConfig(level=logging.INFO)
+  if not can_plot:
+    sys.exit("matplotlib required to generate plot.")
+  plot_parallelism(args.profile_csv, args.output_plot, args.max_workers)
+
+if __name__ == '__main__':
+  main()
@@ -48,27 +48,30 @@ def get_row_data(out_csv, rows_to_plot, max_cpus=0):
     num_cpus = 0
 
     par_col = 0
-    bench_col_start = 0
+    # runtime column for each cpu count, and the columns of the confidence
+    # interval of the runtime if the runner performed multiple trials
+    time_cols = {}
+    ci_cols = {}
 
     for row in rows:
       if row_num == 0:
-        header = row
-        # get num cpus (extracts num_cpus from, for example, "32c time (seconds)" )
-        if re.match(r"\d+c", row[-1].split()[0]):
-          num_cpus = int(row[-1].split()[0][:-1])
-        else:
-          num_cpus = 0
-
-        # find parallelism col and start of benchmark cols
+        # find parallelism col and benchmark cols (e.g., "32c time (seconds)",
+        # "32c ci_low (seconds)", and "32c ci_high (seconds)")
         for i in range(len(row)):
+          m = re.match(r"(\d+)c (\w+)", row[i])
           if row[i] == "burdened_parallelism":
             par_col = i
-          elif bench_col_start == 0 and re.match(r"(\d+)c", row[i]):
-            min_count = int(re.match(r"(\d+)c", row[i]).group(1))
-            if min_count != 1:
-              logger.warning("Estimating 1-core running time from " + str(min_count) + " core running time")
-            # subtract 1 because we will add 1-indexed cpu counts to this value
-            bench_col_start = i-1
+          elif m and m.group(2) == "time":
+            time_cols[int(m.group(1))] = i
+          elif m and m.group(2) == "ci_low":
+            ci_cols.setdefault(int(m.group(1)), [0, 0])[0] = i
+          elif m and m.group(2) == "ci_high":
+            ci_cols.setdefault(int(m.group(1)), [0, 0])[1] = i
+        if time_cols:
+          num_cpus = max(time_cols)
+          min_count = min(time_cols)
+          if min_count != 1:
+            logger.warning("Estimating 1-core running time from " + str(min_count) + " core running time")
         if max_cpus == 0:
           max_cpus = num_cpus
 
@@ -79,33 +82,41 @@ def get_row_data(out_csv, rows_to_plot, max_cpus=0):
         if num_cpus == 0:
           single_core_runtime = float("nan")
         else:
-          single_core_runtime = float(row[bench_col_start+1]) * min_count
+          single_core_runtime = float(row[time_cols[min_count]]) * min_count
 
         data = {}
         data["num_workers"] = []
         data["obs_runtime"] = []
+        data["obs_runtime_err"] = [[], []]
         data["perf_lin_runtime"] = []
         data["greedy_runtime"] = []
         data["span_runtime"] = []
         data["obs_speedup"] = []
+        data["obs_speedup_err"] = [[], []]
         data["perf_lin_speedup"] = []
         data["greedy_speedup"] = []
         data["span_speedup"] = []
 
-        bench_col = bench_col_start + 1
         for i in range(1, max_cpus+1):
           data["num_workers"].append(i)
 
-          if i > num_cpus or bench_col >= len(row) or i != int(re.match(r"(\d+)c", header[bench_col]).group(1)):
+          if i not in time_cols or time_cols[i] >= len(row):
             data["obs_runtime"].append(float("nan"))
             data["obs_speedup"].append(float("nan"))
+            lo = hi = float("nan")
           else:
-            data["obs_runtime"].append(float(row[bench_col]))
-            if 0.0 == float(row[bench_col]):
+            runtime = float(row[time_cols[i]])
+            data["obs_runtime"].append(runtime)
+            if 0.0 == runtime:
               data["obs_speedup"].append(float("nan"))
             else:
-              data["obs_speedup"].append(single_core_runtime/float(row[bench_col]))
-            bench_col += 1
+              data["obs_speedup"].append(single_core_runtime/runtime)
+            if i in ci_cols:
+              lo = float(row[ci_cols[i][0]])
+              hi = float(row[ci_cols[i][1]])
+            else:
+              lo = hi = runtime
+          add_error_bar(data, lo, hi, single_core_runtime)
           data["perf_lin_runtime"].append(single_core_runtime/i)
           greedy_runtime_bound = bound_runtime(single_core_runtime, parallelism, i)
           data["greedy_runtime"].append(greedy_runtime_bound)
@@ -124,6 +135,21 @@ def get_row_data(out_csv, rows_to_plot, max_cpus=0):
 
   return all_data
 
+# record the distances from the observed runtime and speedup to the bounds of
+# the confidence interval [lo, hi] of the runtime
+def add_error_bar(data, lo, hi, single_core_runtime):
+  runtime = data["obs_runtime"][-1]
+  speedup = data["obs_speedup"][-1]
+  data["obs_runtime_err"][0].append(max(0.0, runtime - lo))
+  data["obs_runtime_err"][1].append(max(0.0, hi - runtime))
+  if 0.0 == lo or 0.0 == hi:
+    data["obs_speedup_err"][0].append(0.0)
+    data["obs_speedup_err"][1].append(0.0)
+  else:
+    # a longer runtime gives a lower speedup
+    data["obs_speedup_err"][0].append(max(0.0, speedup - single_core_runtime/hi))
+    data["obs_speedup_err"][1].append(max(0.0, single_core_runtime/lo - speedup))
+
 # by default, plots the last row (i.e. overall execution)
 def plot(out_csv="out.csv", out_plot="plot.pdf", rows_to_plot=[0], cpus=[]):
 
@@ -148,7 +174,7 @@ def plot(out_csv="out.csv", out_plot="plot.pdf", rows_to_plot=[0], cpus=[]):
       tag = "(No tag)"
 
     # legend shared between subplots.
-    axs[r,0].plot(data["num_workers"], data["obs_runtime"], "mo", label="Observed", linestyle='None', markersize = 5)
+    axs[r,0].errorbar(data["num_workers"], data["obs_runtime"], yerr=data["obs_runtime_err"], fmt="mo", label="Observed", markersize = 5, capsize = 3)
     axs[r,0].plot(data["num_workers"], data["perf_lin_runtime"], "g", label="Perfect linear speedup")
     axs[r,0].plot(data["num_workers"], data["greedy_runtime"], "c", label="Burdened-dag bound")
     axs[r,0].plot(data["num_workers"], data["span_runtime"], "y", label="Span bound = " + "{:.5f} s".format(data["span_runtime"][0]))
@@ -171,7 +197,7 @@ def plot(out_csv="out.csv", out_plot="plot.pdf", rows_to_plot=[0], cpus=[]):
     axs[r,0].legend(loc="upper right")
 
 
-    axs[r,1].plot(data["num_workers"], data["obs_speedup"], "mo", label="Observed", linestyle='None', markersize = 5)
+    axs[r,1].errorbar(data["num_workers"], data["obs_speedup"], yerr=data["obs_speedup_err"], fmt="mo", label="Observed", markersize = 5, capsize = 3)
     axs[r,1].plot(data["num_workers"], data["perf_lin_speedup"], "g", label="Perfect linear speedup")
     axs[r,1].plot(data["num_workers"], data["greedy_speedup"], "c", label="Burdened-dag bound")
     axs[r,1].plot(data["num_workers"], data["span_speedup"], "y", label="Parallelism = " +
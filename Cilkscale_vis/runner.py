@@ -4,6 +4,8 @@ import sys
 import os
 import time
 import csv
+import math
+import re
 
 logger = logging.getLogger(__name__)
 
@@ -35,10 +37,10 @@ def run_command(cmd, asyn = False):
 def get_n_cpus():
   return len(get_cpu_ordering())
 
-def benchmark_tmp_output(n):
-  return ".out.bench." + str(n) + ".csv"
+def benchmark_tmp_output(n, trial=0):
+  return ".out.bench." + str(n) + "." + str(trial) + ".csv"
 
-def run_on_p_workers(P, rcommand):
+def run_on_p_workers(P, rcommand, trial=0):
   cpu_ordering = get_cpu_ordering()
   cpu_online = cpu_ordering[:P]
 
@@ -46,11 +48,78 @@ def run_on_p_workers(P, rcommand):
   if sys.platform != "darwin":
     rcommand = "taskset -c " + ",".join([str(p) for (p,m) in cpu_online]) + " " + rcommand
   logger.info('CILK_NWORKERS=' + str(P) + ' ' + rcommand)
-  bench_out_csv = benchmark_tmp_output(P)
+  bench_out_csv = benchmark_tmp_output(P, trial)
   proc = subprocess.Popen(['CILK_NWORKERS=' + str(P) + ' ' + "CILKSCALE_OUT=" + bench_out_csv + " " + rcommand], shell=True, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
   out,err=proc.communicate()
   err = str(err, "utf-8")
 
+def read_benchmark_times(bench_out_csv):
+  # return the header of the runtime column and the runtime of each row, as
+  # written by the benchmark
+  with open(bench_out_csv, "r") as csvfile:
+    rows = list(csv.reader(csvfile, delimiter=','))
+  return rows[0][1].strip(), [row[1].strip() for row in rows[1:]]
+
+def median(samples):
+  s = sorted(samples)
+  n = len(s)
+  return s[n//2] if n % 2 else 0.5 * (s[n//2 - 1] + s[n//2])
+
+# Remove outliers, i.e., samples whose modified z-score, which is based on the
+# median absolute deviation, exceeds 3.5.  Returns the remaining samples and
+# the number of outliers removed.
+def remove_outliers(samples):
+  if len(samples) < 3:
+    return samples, 0
+  med = median(samples)
+  mad = median([abs(x - med) for x in samples])
+  if mad == 0:
+    return samples, 0
+  kept = [x for x in samples if 0.6745 * abs(x - med) / mad <= 3.5]
+  return kept, len(samples) - len(kept)
+
+# Minimum number of trials for which the runner reports a confidence interval.
+MIN_CI_TRIALS = 6
+
+# Distribution-free 95% confidence interval for the median, based on order
+# statistics of the samples.  With fewer than MIN_CI_TRIALS samples, no pair of
+# order statistics achieves 95% coverage, and the interval returned is the
+# range of the samples.
+def median_confidence_interval(samples):
+  s = sorted(samples)
+  n = len(s)
+  half_width = 1.96 * math.sqrt(n) / 2
+  lo = max(0, int(math.floor(n / 2 - half_width)))
+  hi = min(n - 1, int(math.ceil(n / 2 + half_width)))
+  return s[lo], s[hi]
+
+def check_system():
+  # warn about system settings that make benchmark results noisy
+  if sys.platform == "darwin":
+    return
+  out,err = run_command("lscpu")
+  info = dict()
+  for l in str(out, 'utf-8').splitlines():
+    if ':' in l:
+      key, value = l.split(':', 1)
+      info[key.strip()] = value.strip()
+
+  threads_per_core = info.get("Thread(s) per core", "1")
+  if threads_per_core.isdigit() and int(threads_per_core) > 1:
+    logger.warning("Hyperthreading is enabled (" + threads_per_core +
+                   " threads per core).  Benchmarks run on one thread per " +
+                   "core, but other processes on sibling threads can add noise.")
+
+  max_mhz = info.get("CPU max MHz")
+  min_mhz = info.get("CPU min MHz")
+  try:
+    if max_mhz and min_mhz and float(max_mhz) != float(min_mhz):
+      logger.warning("CPU frequency scaling is enabled (" + min_mhz + "-" +
+                     max_mhz + " MHz).  Consider fixing the CPU frequency " +
+                     "for reproducible benchmarks.")
+  except ValueError:
+    pass
+
 def get_cpu_ordering():
   if sys.platform == "darwin":
     # TODO: Replace with something that analyzes CPU configuration on Darwin
@@ -82,7 +151,11 @@ def get_cpu_ordering():
     ret.append((x[2], x[0]))
   return ret
 
-def run(bin_instrument, bin_bench, bin_args, out_csv="out.csv", cpu_counts=None):
+def run(bin_instrument, bin_bench, bin_args, out_csv="out.csv", cpu_counts=None,
+        trials=1, warmup=0, check=False):
+  if check:
+    check_system()
+
   # get parallelism
   out,err = get_parallelism(bin_instrument, bin_args, out_csv)
 
@@ -101,12 +174,26 @@ def run(bin_instrument, bin_bench, bin_args, out_csv="out.csv", cpu_counts=None)
   # this will be prepended with CILK_NWORKERS and CILKSCALE_OUT in run_on_p_workers
   # any tmp files will be destroyed
   run_command = bin_bench + " " + " ".join(bin_args)
+  # for each cpu count, the header of the runtime column and the list of
+  # samples for each row
   results = dict()
   last_CPU = NCPUS+1
   for i in range(1, NCPUS+1):
     if i in cpu_counts:
       try:
-        results[i] = run_on_p_workers(i, run_command)
+        for w in range(warmup):
+          run_on_p_workers(i, run_command, "warmup")
+          os.remove(benchmark_tmp_output(i, "warmup"))
+        samples = None
+        for t in range(trials):
+          run_on_p_workers(i, run_command, t)
+          header, times = read_benchmark_times(benchmark_tmp_output(i, t))
+          os.remove(benchmark_tmp_output(i, t))
+          if samples is None:
+            samples = [[] for _ in times]
+          for row, sample in zip(samples, times):
+            row.append(sample)
+        results[i] = (header, samples)
       except KeyboardInterrupt:
         logger.info("Benchmarking stopped early at " + str(i-1) + " cpus.")
         last_CPU = i
@@ -121,23 +208,38 @@ def run(bin_instrument, bin_bench, bin_args, out_csv="out.csv", cpu_counts=None)
     for i in range(len(new_rows)):
       new_rows[i] = new_rows[i].strip("\n")
 
-    # join all the csv data
+    # join all the csv data.  With a single trial, each cpu count adds a
+    # column with the runtime reported by the benchmark.  With multiple
+    # trials, the runtime column holds the median runtime, followed by a
+    # column for the minimum runtime and, with at least MIN_CI_TRIALS trials,
+    # columns for the bounds of the 95% confidence interval of the median.
     for i in range(1, last_CPU):
-      if i not in cpu_counts:
+      if i not in results:
         continue
-      with open(benchmark_tmp_output(i), "r") as csvfile:
-        reader = csv.reader(csvfile, delimiter=',')
-        row_num = 0
-        for row in reader:
-          if row_num == 0:
-            col_header = str(i) + "c " + row[1].strip()
-            new_rows[row_num] += "," + col_header
-          else:
-            # second col contains runtime
-            time = row[1].strip()
-            new_rows[row_num] += "," + time
-          row_num += 1
-      os.remove(benchmark_tmp_output(i))
+      header, samples = results[i]
+      col_header = str(i) + "c " + header
+      new_rows[0] += "," + col_header
+      if trials == 1:
+        for row_num in range(len(samples)):
+          new_rows[row_num+1] += "," + samples[row_num][0]
+        continue
+      units = re.sub(r"^time ", "", header)
+      stats = ["min"]
+      if trials >= MIN_CI_TRIALS:
+        stats += ["ci_low", "ci_high"]
+      for stat in stats:
+        new_rows[0] += "," + str(i) + "c " + stat + " " + units
+      for row_num in range(len(samples)):
+        row_samples = [float(x) for x in samples[row_num]]
+        kept, num_outliers = remove_outliers(row_samples)
+        if num_outliers:
+          logger.warning("Discarded " + str(num_outliers) + " outlier(s) of " +
+                         str(len(row_samples)) + " trials for row " +
+                         str(row_num+1) + " on " + str(i) + " cpus.")
+        new_rows[row_num+1] += ",%g,%g" % (median(kept), min(row_samples))
+        if trials >= MIN_CI_TRIALS:
+          ci_low, ci_high = median_confidence_interval(kept)
+          new_rows[row_num+1] += ",%g,%g" % (ci_low, ci_high)
 
     for i in range(len(new_rows)):
       new_rows[i] += "\n"
@@ -145,4 +247,3 @@ def run(bin_instrument, bin_bench, bin_args, out_csv="out.csv", cpu_counts=None)
   # write the joined data to out_csv
   with open(out_csv, "w") as out_csv_file:
     out_csv_file.writelines(new_rows)
-
@@ -12,6 +12,7 @@
 #include "simple_shadow_mem.h"
 #include "spbag.h"
 #include "stack.h"
+#include "suppressions.h"
 
 // FILE io used to print error messages
 FILE *err_io = stderr;
@@ -608,20 +609,29 @@ CilkSanImpl_t::record_mem_helper(const csi_id_t acc_id, uintptr_t addr,
   if (!mem_size)
     return;
 
+  if (__builtin_expect(false_sharing_active, false))
+    shadow_memory->check_false_sharing<is_read>(acc_id, type, addr, mem_size,
+                                                frame_stack.head());
+
   // Use fast path for small, statically aligned accesses.
   if (alignment && mem_size <= alignment &&
       alignment <= (1 << SimpleShadowMem::getLgSmallAccessSize())) {
     // We're committed to using the fast-path check.  Update the occupied bits,
     // and if that process discovers unoccupied entries, perform the check.
+    CILKSAN_STAT(fast_path_checks++);
     if (shadow_memory->setOccupiedFast(is_read, addr, mem_size)) {
+      CILKSAN_STAT(occupancy_misses++);
       FrameData_t *f = frame_stack.head();
       check_races_and_update_fast<is_read>(acc_id, type, addr, mem_size, f,
                                            *shadow_memory);
+    } else {
+      CILKSAN_STAT(occupancy_hits++);
     }
     // Return early.
     return;
   }
 
+  CILKSAN_STAT(slow_path_checks++);
   FrameData_t *f = frame_stack.head();
   check_races_and_update<is_read>(acc_id, type, addr, mem_size, f,
                                   *shadow_memory);
@@ -636,6 +646,10 @@ void CilkSanImpl_t::record_locked_mem_helper(const csi_id_t acc_id,
   if (!mem_size)
     return;
 
+  if (__builtin_expect(false_sharing_active, false))
+    shadow_memory->check_false_sharing<is_read>(acc_id, type, addr, mem_size,
+                                                frame_stack.head());
+
   // TODO: Add a fast path for handling locked accesses.
 
   // // Use fast path for small, statically aligned accesses.
@@ -652,6 +666,7 @@ void CilkSanImpl_t::record_locked_mem_helper(const csi_id_t acc_id,
   //   return;
   // }
 
+  CILKSAN_STAT(slow_path_checks++);
   FrameData_t *f = frame_stack.head();
   check_data_races_and_update<is_read>(acc_id, type, addr, mem_size, f, lockset,
                                        *shadow_memory);
@@ -663,6 +678,10 @@ void CilkSanImpl_t::record_free(uintptr_t addr, size_t mem_size,
   if (!mem_size)
     return;
 
+  // Freed memory is no longer private to any strand.
+  if (__builtin_expect(!private_regions.empty(), false))
+    private_regions.remove(addr, addr + mem_size);
+
   FrameData_t *f = frame_stack.head();
   if (locks_held()) {
     check_data_races_and_update<false>(acc_id, type, addr, mem_size, f,
@@ -711,8 +730,11 @@ void check_races_and_update(const csi_id_t acc_id, MAType_t type,
   // in the same strand at runtime.  If we find that all occupancy bits for
   // [addr, addr+mem_size) are already set, then this access is redundant with a
   // previous access in the same strand, and we can quit early.
-  if (!shadow_memory.setOccupied(is_read, addr, mem_size))
+  if (!shadow_memory.setOccupied(is_read, addr, mem_size)) {
+    CILKSAN_STAT(occupancy_hits++);
     return;
+  }
+  CILKSAN_STAT(occupancy_misses++);
 
   if (is_read)
     check_races_and_update_with_read(acc_id, type, addr, mem_size, f,
@@ -788,8 +810,11 @@ void check_data_races_and_update(const csi_id_t acc_id, MAType_t type,
   // in the same strand at runtime.  If we find that all occupancy bits for
   // [addr, addr+mem_size) are already set, then this access is redundant with a
   // previous access in the same strand, and we can quit early.
-  if (!shadow_memory.setOccupied(is_read, addr, mem_size))
+  if (!shadow_memory.setOccupied(is_read, addr, mem_size)) {
+    CILKSAN_STAT(occupancy_hits++);
     return;
+  }
+  CILKSAN_STAT(occupancy_misses++);
 
   if (is_read)
     check_data_races_and_update_with_read(acc_id, type, addr, mem_size, f,
@@ -806,8 +831,7 @@ void CilkSanImpl_t::do_read(const csi_id_t load_id, uintptr_t addr,
   DBG_TRACE(MEMORY, "record read %lu: %lu bytes at addr %p and rip %p.\n",
             load_id, mem_size, addr,
             (load_id != UNKNOWN_CSI_ID) ? load_pc[load_id] : 0);
-  if (collect_stats)
-    collect_read_stat(mem_size);
+  collect_read_stat(mem_size);
 
   bool on_stack = is_on_stack(addr);
   if (on_stack)
@@ -822,8 +846,7 @@ void CilkSanImpl_t::do_write(const csi_id_t store_id, uintptr_t addr,
   WHEN_CILKSAN_DEBUG(cilksan_assert(CILKSAN_INITIALIZED));
   DBG_TRACE(MEMORY, "record write %ld: %lu bytes at addr %p and rip %p.\n",
             store_id, mem_size, addr, store_pc[store_id]);
-  if (collect_stats)
-    collect_write_stat(mem_size);
+  collect_write_stat(mem_size);
 
   bool on_stack = is_on_stack(addr);
   if (on_stack)
@@ -863,8 +886,7 @@ void CilkSanImpl_t::do_locked_read(const csi_id_t load_id, uintptr_t addr,
             "record read %lu: %lu bytes at addr %p and rip %p, locked.\n",
             load_id, mem_size, addr,
             (load_id != UNKNOWN_CSI_ID) ? load_pc[load_id] : 0);
-  if (collect_stats)
-    collect_read_stat(mem_size);
+  collect_read_stat(mem_size);
 
   bool on_stack = is_on_stack(addr);
   if (on_stack)
@@ -880,8 +902,7 @@ void CilkSanImpl_t::do_locked_write(const csi_id_t store_id, uintptr_t addr,
   DBG_TRACE(MEMORY,
             "record write %ld: %lu bytes at addr %p and rip %p, locked.\n",
             store_id, mem_size, addr, store_pc[store_id]);
-  if (collect_stats)
-    collect_write_stat(mem_size);
+  collect_write_stat(mem_size);
 
   bool on_stack = is_on_stack(addr);
   if (on_stack)
@@ -910,6 +931,73 @@ void CilkSanImpl_t::clear_shadow_memory(size_t start, size_t size) {
     return;
   DBG_TRACE(MEMORY, "cilksan_clear_shadow_memory(%p, %ld)\n", start, size);
   shadow_memory->clear(start, size);
+  // Memory that is deallocated or reallocated is no longer private.
+  if (__builtin_expect(!private_regions.empty(), false))
+    private_regions.remove(start, start + size);
+}
+
+// Annotate [start, start+size) as private to the current strand.  Like a new
+// allocation, the region starts with clear shadow memory.
+void CilkSanImpl_t::mark_private(uintptr_t start, size_t size) {
+  if (!size)
+    return;
+  DBG_TRACE(MEMORY, "cilksan_mark_private(%p, %ld)\n", start, size);
+  clear_shadow_memory(start, size);
+  PrivateRegion_t *region = private_regions.insert(start, start + size);
+  // The current strand owns the region.
+  SBag_t *sbag = frame_stack.head()->getSbagForAccess();
+  region->last_access.set(sbag->get_ds(), sbag->get_version(), UNKNOWN_CSI_ID,
+                          MAType_t::FNRW);
+}
+
+// Remove the private annotation from [start, start+size).  Subsequent accesses
+// are checked normally, starting from clear shadow memory.
+void CilkSanImpl_t::unmark_private(uintptr_t start, size_t size) {
+  if (!size)
+    return;
+  DBG_TRACE(MEMORY, "cilksan_unmark_private(%p, %ld)\n", start, size);
+  // Clearing the shadow memory also removes the private regions.
+  clear_shadow_memory(start, size);
+}
+
+// Check an access to a private region against the last access to that region.
+// If the two accesses are logically in parallel, then the private annotation is
+// violated.
+bool CilkSanImpl_t::check_private_access(bool is_read, const csi_id_t acc_id,
+                                         uintptr_t addr, size_t size) {
+  PrivateRegion_t *region = private_regions.find(addr, size);
+  if (!region)
+    return false;
+
+  FrameData_t *f = frame_stack.head();
+  if (__builtin_expect(
+          MemoryAccess_t::previousAccessInParallel(&region->last_access, f),
+          false)) {
+    const csan_source_loc_t *src_loc = nullptr;
+    if (UNKNOWN_CSI_ID != acc_id)
+      src_loc = is_read ? __csan_get_load_source_loc(acc_id)
+                        : __csan_get_store_source_loc(acc_id);
+    fprintf(err_io,
+            "Cilksan Warning: Private region [%p, %p) accessed by parallel "
+            "strands at %s (%s:%d:%d)\n",
+            (void *)region->start, (void *)region->end,
+            ((src_loc && src_loc->name) ? src_loc->name
+                                        : "<no function name>"),
+            ((src_loc && src_loc->filename) ? src_loc->filename
+                                            : "<no file name>"),
+            (src_loc ? src_loc->line_number : 0),
+            (src_loc ? src_loc->column_number : 0));
+    // Stop treating this region as private, so that subsequent accesses to it
+    // are checked normally.
+    private_regions.remove(region->start, region->end);
+    return false;
+  }
+
+  // Record this access as the last access to the region.
+  SBag_t *sbag = f->getSbagForAccess();
+  region->last_access.set(sbag->get_ds(), sbag->get_version(), acc_id,
+                          MAType_t::RW);
+  return true;
 }
 
 void CilkSanImpl_t::record_alloc(size_t start, size_t size,
@@ -929,23 +1017,11 @@ void CilkSanImpl_t::clear_alloc(size_t start, size_t size) {
 }
 
 inline void CilkSanImpl_t::print_stats() {
-  std::cout << ",size (bytes),count\n";
-
-  for (std::pair<size_t, uint64_t> reads : num_reads_checked)
-    std::cout << "reads," << reads.first << "," << reads.second << "\n";
-  std::cout << "total reads,," << total_reads_checked << "\n";
-
-  for (std::pair<size_t, uint64_t> writes : num_writes_checked)
-    std::cout << "writes," << writes.first << "," << writes.second << "\n";
-  std::cout << "total writes,," << total_writes_checked << "\n";
-
-  std::cout << "total strands,," << strand_count << "\n";
-
-  for (std::pair<size_t, uint64_t> reads : max_num_reads_checked)
-    std::cout << "max reads," << reads.first << "," << reads.second << "\n";
-
-  for (std::pair<size_t, uint64_t> writes : max_num_writes_checked)
-    std::cout << "max writes," << writes.first << "," << writes.second << "\n";
+  fflush(stdout);
+  if (stats_json)
+    cilksan_stats.print_json(stdout);
+  else
+    cilksan_stats.print_csv(stdout);
 }
 
 ///////////////////////////////////////////////////////////////////////////
@@ -959,10 +1035,19 @@ void CilkSanImpl_t::deinit() {
     return; // deinit-ed already
 
   print_race_report();
+  if (false_sharing_active)
+    print_false_sharing_report();
+  if (reducer_profile_active)
+    print_reducer_profile();
   // Optionally print statistics.
-  if (collect_stats)
+  if (stats_active)
     print_stats();
 
+  // Release the references private regions hold on disjoint sets.
+  private_regions.clear();
+  // Release the references the false-sharing reports hold on call stacks.
+  false_sharing_found.clear();
+
   // Remove references to the disjoint set nodes so they can be freed.
   // We expect just 1 frame on the stack at this point, unless the
   // program terminated from within a function, e.g., by calling
@@ -1066,6 +1151,7 @@ static void csan_destroy(void) {
     free(free_pc);
     free_pc = nullptr;
   }
+  free_suppressions();
 }
 
 CilkSanImpl_t::~CilkSanImpl_t() {
@@ -1079,8 +1165,10 @@ void CilkSanImpl_t::init() {
   // Enable stats collection if requested
   {
     char *e = getenv("CILKSAN_STATS");
-    if (e && 0 != strcmp(e, "0"))
-      collect_stats = true;
+    if (e && 0 != strcmp(e, "0")) {
+      stats_active = true;
+      stats_json = (0 == strcmp(e, "json"));
+    }
   }
   // Enable checking of atomics if requested
   {
@@ -1093,6 +1181,20 @@ void CilkSanImpl_t::init() {
     }
   }
 
+  // Enable checking for false sharing if requested
+  {
+    char *e = getenv("CILKSAN_FALSE_SHARING");
+    if (e && 0 != strcmp(e, "0"))
+      false_sharing_active = true;
+  }
+
+  // Enable profiling of reducer overheads if requested
+  {
+    char *e = getenv("CILKSAN_REDUCER_PROFILE");
+    if (e && 0 != strcmp(e, "0"))
+      reducer_profile_active = true;
+  }
+
   std::cerr << "Running Cilksan race detector.\n";
 
   // these are true upon creation of the stack
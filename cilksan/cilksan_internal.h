@@ -13,8 +13,11 @@
 #include "frame_data.h"
 #include "hypertable.h"
 #include "locksets.h"
+#include "private_regions.h"
+#include "reducer_profile.h"
 #include "shadow_mem_allocator.h"
 #include "stack.h"
+#include "stats.h"
 
 extern bool CILKSAN_INITIALIZED;
 
@@ -157,12 +160,13 @@ public:
 
   hyper_table *get_or_create_reducer_views() {
     FrameData_t *f = frame_stack.head();
-    if (f->in_continuation())
-      return f->get_or_create_reducer_views();
-
-    cilksan_assert(f->get_parent_continuation() > 0);
-    return frame_stack.ancestor(f->get_parent_continuation())
-        ->get_or_create_reducer_views();
+    if (!f->in_continuation()) {
+      cilksan_assert(f->get_parent_continuation() > 0);
+      f = frame_stack.ancestor(f->get_parent_continuation());
+    }
+    if (__builtin_expect(reducer_profile_active, false) && !f->reducer_views)
+      reducer_profile.begin_steal(f->get_or_create_reducer_views());
+    return f->get_or_create_reducer_views();
   }
 
   // Attempt to look up a view for a reducer.  Returns a pointer to a view if it
@@ -189,7 +193,10 @@ public:
     DBG_TRACE(REDUCER, "create_reducer_view(%p): created view %p -> %p\n",
               (void *)reducer_views, (void *)key, new_view);
     mark_alloc(new_view, size);
-    identity(new_view);
+    if (__builtin_expect(reducer_profile_active, false))
+      reducer_profile.identity(reducer_views, key, identity, new_view);
+    else
+      identity(new_view);
 
     // Insert the view into the table of reducer_views.
     hyper_table::bucket new_bucket = {
@@ -235,6 +242,19 @@ public:
   void record_free(size_t start, size_t size, csi_id_t acc_id, MAType_t type);
   void clear_alloc(size_t start, size_t size);
 
+  // Methods for strand-private memory regions
+  void mark_private(uintptr_t start, size_t size);
+  void unmark_private(uintptr_t start, size_t size);
+  // Returns true if [addr, addr+size) lies within a private region, in which
+  // case the access needs no further checking.
+  __attribute__((always_inline)) bool
+  is_private_access(bool is_read, const csi_id_t acc_id, uintptr_t addr,
+                    size_t size) {
+    if (__builtin_expect(private_regions.empty(), true))
+      return false;
+    return check_private_access(is_read, acc_id, addr, size);
+  }
+
   // Methods for locked accesses
   inline void do_acquire_lock(LockID_t lock_id) {
     lockset.insert(lock_id);
@@ -289,6 +309,25 @@ public:
   void print_race_report();
   int get_num_races_found();
 
+  // Methods for reporting false sharing
+  // Count a conflict on the cache line at line.  Returns true if the line has
+  // no example conflict yet, in which case the caller should provide one with
+  // report_false_sharing().
+  bool record_false_sharing(uintptr_t line) {
+    FalseSharingInfo_t &info = false_sharing_found[line];
+    ++info.conflicts;
+    return !info.first.isValid();
+  }
+  void report_false_sharing(uintptr_t line, const AccessLoc_t &first_inst,
+                            const AccessLoc_t &second_inst,
+                            const AccessLoc_t &first_alloc,
+                            const AccessLoc_t &second_alloc,
+                            enum RaceType_t type);
+  void print_false_sharing_report();
+
+  // Print the profile of reducer overheads.
+  void print_reducer_profile();
+
   // Map from malloc'd address to size of memory allocation
   AddrMap_t<size_t> malloc_sizes;
 
@@ -307,6 +346,8 @@ private:
   template <bool is_read, MAType_t type>
   inline void record_locked_mem_helper(const csi_id_t acc_id, uintptr_t addr,
                                        size_t mem_size, unsigned alignment);
+  bool check_private_access(bool is_read, const csi_id_t acc_id,
+                            uintptr_t addr, size_t size);
   inline void print_stats();
   static bool ColorizeReports();
   static bool PauseOnRace();
@@ -343,6 +384,9 @@ private:
   // and allocation.
   SimpleShadowMem *shadow_memory = nullptr;
 
+  // Memory regions annotated as private to a strand.
+  PrivateRegions_t private_regions;
+
   // Use separate allocators for each dictionary in the shadow memory.
   MALineAllocator MAAlloc[3];
 
@@ -364,64 +408,22 @@ private:
   RaceMap_t races_found;
   // The number of duplicated races found
   uint32_t duplicated_races = 0;
+
+  // Flag for whether to check for false sharing between logically parallel
+  // accesses to the same cache line.
+  bool false_sharing_active = false;
+  // Map from the address of a cache line to the false sharing found on it.
+  std::unordered_map<uintptr_t, FalseSharingInfo_t> false_sharing_found;
   const bool color_report;
 
   // Basic statistics
-  bool collect_stats = false;
-  uint64_t strand_count = 0;
-  uint64_t total_reads_checked = 0;
-  uint64_t total_writes_checked = 0;
-  std::unordered_map<size_t, uint64_t> num_reads_checked;
-  std::unordered_map<size_t, uint64_t> num_writes_checked;
-
-  std::unordered_map<size_t, uint64_t> max_num_reads_checked;
-  std::unordered_map<size_t, uint64_t> max_num_writes_checked;
-
-  std::unordered_map<size_t, uint64_t> strand_num_reads_checked;
-  std::unordered_map<size_t, uint64_t> strand_num_writes_checked;
-
   void collect_read_stat(size_t mem_size) {
-    ++total_reads_checked;
-    if (!num_reads_checked.count(mem_size))
-      num_reads_checked.insert(std::make_pair(mem_size, 0));
-    ++num_reads_checked[mem_size];
-
-    if (!strand_num_reads_checked.count(mem_size))
-      strand_num_reads_checked.insert(std::make_pair(mem_size, 0));
-    ++strand_num_reads_checked[mem_size];
+    CILKSAN_STAT(collect_read(mem_size));
   }
   void collect_write_stat(size_t mem_size) {
-    ++total_writes_checked;
-    if (!num_writes_checked.count(mem_size))
-      num_writes_checked.insert(std::make_pair(mem_size, 0));
-    ++num_writes_checked[mem_size];
-
-    if (!strand_num_writes_checked.count(mem_size))
-      strand_num_writes_checked.insert(std::make_pair(mem_size, 0));
-    ++strand_num_writes_checked[mem_size];
-  }
-
-  void update_strand_stats() {
-    if (!collect_stats)
-      return;
-
-    ++strand_count;
-
-    for (auto &entry : strand_num_reads_checked) {
-      if (!max_num_reads_checked.count(entry.first))
-        max_num_reads_checked.insert(entry);
-      else if (max_num_reads_checked[entry.first] < entry.second)
-        max_num_reads_checked[entry.first] = entry.second;
-    }
-    strand_num_reads_checked.clear();
-    for (auto &entry : strand_num_writes_checked) {
-      if (!max_num_writes_checked.count(entry.first))
-        max_num_writes_checked.insert(entry);
-      else if (max_num_writes_checked[entry.first] < entry.second)
-        max_num_writes_checked[entry.first] = entry.second;
-    }
-    strand_num_writes_checked.clear();
+    CILKSAN_STAT(collect_write(mem_size));
   }
+  void update_strand_stats() { CILKSAN_STAT(end_strand()); }
 };
 
 #endif // __CILKSAN_INTERNAL_H__
@@ -68,6 +68,9 @@ typedef enum {
   NUM_OBJ_TYPES // Must be last
 } obj_type_t;
 
+// Names of the allocation and free functions, indexed by the allocfn_ty and
+// free_ty properties, respectively.  cilkscale/csanrt.cpp has copies of these
+// tables; keep the two in sync.
 const char *allocfn_str[] =
   {
    "void *malloc(size_t size)",
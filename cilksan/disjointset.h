@@ -10,6 +10,7 @@
 #include "aligned_alloc.h"
 #include "debug_util.h"
 #include "race_info.h"
+#include "stats.h"
 
 #if DISJOINTSET_DEBUG
 #define WHEN_DISJOINTSET_DEBUG(stmt) do { stmt; } while(0)
@@ -619,6 +620,7 @@ public:
   static DSAllocator &Alloc;
 
   void *operator new(size_t size) {
+    CILKSAN_STAT(ds_node_allocated());
     return Alloc.getDJSet();
     // if (free_list) {
     //   DisjointSet_t *new_node = free_list;
@@ -629,6 +631,7 @@ public:
   }
 
   void operator delete(__attribute__((noescape)) void *ptr) {
+    CILKSAN_STAT(ds_freed++);
     Alloc.freeDJSet(ptr);
     // DisjointSet_t *del_node = reinterpret_cast<DisjointSet_t *>(ptr);
     // del_node->_set_parent = free_list;
@@ -15,6 +15,7 @@
 #include "race_detect_update.h"
 #include "simple_shadow_mem.h"
 #include "stack.h"
+#include "suppressions.h"
 
 // FILE io used to print error messages
 extern FILE *err_io;
@@ -198,6 +199,10 @@ static void grow_pc_table(uintptr_t *&table, csi_id_t &table_cap,
 CILKSAN_API
 void __csan_unit_init(const char *const file_name,
                       const csan_instrumentation_counts_t counts) {
+  // Compute the suppressed CSI ID's in this unit.  This must happen before the
+  // tables below are grown, which updates the total counts of CSI ID's.
+  init_unit_suppressions(counts);
+
   // Grow the tables mapping CSI ID's to PC values.
   if (counts.num_call)
     grow_pc_table(call_pc, total_call, counts.num_call);
@@ -265,6 +270,7 @@ CILKSAN_API void __csan_func_entry(const csi_id_t func_id,
   if (!should_check())
     return;
 
+  CILKSAN_STAT(hooks[STAT_HOOK_FUNC_ENTRY]++);
   // Try to detect stack switching by comparing the current stack and base
   // pointers to their previous values.  We use this approach, rather than
   // overlead the Sanitizer methods to communicate fiber switching, to avoid
@@ -324,6 +330,7 @@ CILKSAN_API void __csan_func_exit(const csi_id_t func_exit_id,
   if (!should_check())
     return;
 
+  CILKSAN_STAT(hooks[STAT_HOOK_FUNC_EXIT]++);
 #if CILKSAN_DEBUG
   const csan_source_loc_t *srcloc = __csan_get_func_exit_source_loc(func_exit_id);
 #endif
@@ -460,6 +467,7 @@ __csan_detach(const csi_id_t detach_id, const unsigned sync_reg,
   if (!should_check())
     return;
 
+  CILKSAN_STAT(hooks[STAT_HOOK_DETACH]++);
   DBG_TRACE(CALLBACK, "__csan_detach(%ld)\n", detach_id);
   WHEN_CILKSAN_DEBUG(cilksan_assert(last_event == NONE));
   WHEN_CILKSAN_DEBUG(last_event = NONE);
@@ -489,6 +497,7 @@ __csan_task(const csi_id_t task_id, const csi_id_t detach_id,
   if (!should_check())
     return;
 
+  CILKSAN_STAT(hooks[STAT_HOOK_TASK]++);
   // Update the low address of the stack
   if (stack_low_addr > (uintptr_t)sp) {
     // Try to detect stack switching by comparing the current stack and base
@@ -542,6 +551,7 @@ __csan_task_exit(const csi_id_t task_exit_id, const csi_id_t task_id,
   if (!should_check())
     return;
 
+  CILKSAN_STAT(hooks[STAT_HOOK_TASK_EXIT]++);
   DBG_TRACE(CALLBACK, "__csan_task_exit(%ld, %ld, %ld, %d, %d)\n", task_exit_id,
             task_id, detach_id, sync_reg, prop.is_tapir_loop_body);
 
@@ -581,6 +591,7 @@ __csan_detach_continue(const csi_id_t detach_continue_id,
   if (!should_check())
     return;
 
+  CILKSAN_STAT(hooks[STAT_HOOK_DETACH_CONTINUE]++);
   DBG_TRACE(CALLBACK, "__csan_detach_continue(%ld)\n", detach_id);
 
   // OpenCilk semantics dictate that an implicit sync occurs upon entering the
@@ -605,6 +616,7 @@ CILKSAN_API void __csan_sync(csi_id_t sync_id, const unsigned sync_reg) {
   if (!should_check())
     return;
 
+  CILKSAN_STAT(hooks[STAT_HOOK_SYNC]++);
   // Because this is a serial tool, we can safely perform all operations related
   // to a sync.
   CilkSanImpl.do_sync(sync_reg);
@@ -629,6 +641,7 @@ void __csan_load(csi_id_t load_id, const void *addr, int32_t size,
   if (!CILKSAN_INITIALIZED)
     return;
 
+  CILKSAN_STAT(hooks[STAT_HOOK_LOAD]++);
   if (!should_check()) {
     DBG_TRACE(MEMORY, "SKIP %s read (%p, %ld)\n", __FUNCTION__, addr, size);
     return;
@@ -639,10 +652,20 @@ void __csan_load(csi_id_t load_id, const void *addr, int32_t size,
     return;
   }
 
+  if (is_suppressed(load_suppressed, load_id)) {
+    DBG_TRACE(MEMORY, "SKIP %s read (%p, %ld) at suppressed site\n",
+              __FUNCTION__, addr, size);
+    return;
+  }
+
   // Record the address of this load.
   if (__builtin_expect(!load_pc[load_id], false))
     load_pc[load_id] = CALLERPC;
 
+  // Skip accesses to memory that is private to the current strand.
+  if (CilkSanImpl.is_private_access(true, load_id, (uintptr_t)addr, size))
+    return;
+
   DBG_TRACE(MEMORY, "%s read (%p, %ld)\n", __FUNCTION__, addr, size);
 
   if (is_running_under_rr)
@@ -669,6 +692,7 @@ void __csan_large_load(csi_id_t load_id, const void *addr, size_t size,
   if (!CILKSAN_INITIALIZED)
     return;
 
+  CILKSAN_STAT(hooks[STAT_HOOK_LARGE_LOAD]++);
   if (!should_check()) {
     DBG_TRACE(MEMORY, "SKIP %s read (%p, %ld)\n", __FUNCTION__, addr, size);
     return;
@@ -679,10 +703,20 @@ void __csan_large_load(csi_id_t load_id, const void *addr, size_t size,
     return;
   }
 
+  if (is_suppressed(load_suppressed, load_id)) {
+    DBG_TRACE(MEMORY, "SKIP %s read (%p, %ld) at suppressed site\n",
+              __FUNCTION__, addr, size);
+    return;
+  }
+
   // Record the address of this load.
   if (__builtin_expect(!load_pc[load_id], false))
     load_pc[load_id] = CALLERPC;
 
+  // Skip accesses to memory that is private to the current strand.
+  if (CilkSanImpl.is_private_access(true, load_id, (uintptr_t)addr, size))
+    return;
+
   DBG_TRACE(MEMORY, "%s read (%p, %ld)\n", __FUNCTION__, addr, size);
 
   if (is_running_under_rr)
@@ -709,6 +743,7 @@ void __csan_store(csi_id_t store_id, const void *addr, int32_t size,
   if (!CILKSAN_INITIALIZED)
     return;
 
+  CILKSAN_STAT(hooks[STAT_HOOK_STORE]++);
   if (!should_check()) {
     DBG_TRACE(MEMORY, "SKIP %s wrote (%p, %ld)\n", __FUNCTION__, addr, size);
     return;
@@ -719,10 +754,20 @@ void __csan_store(csi_id_t store_id, const void *addr, int32_t size,
     return;
   }
 
+  if (is_suppressed(store_suppressed, store_id)) {
+    DBG_TRACE(MEMORY, "SKIP %s wrote (%p, %ld) at suppressed site\n",
+              __FUNCTION__, addr, size);
+    return;
+  }
+
   // Record the address of this store.
   if (__builtin_expect(!store_pc[store_id], false))
     store_pc[store_id] = CALLERPC;
 
+  // Skip accesses to memory that is private to the current strand.
+  if (CilkSanImpl.is_private_access(false, store_id, (uintptr_t)addr, size))
+    return;
+
   DBG_TRACE(MEMORY, "%s wrote (%p, %ld)\n", __FUNCTION__, addr, size);
 
   if (is_running_under_rr)
@@ -749,6 +794,7 @@ void __csan_large_store(csi_id_t store_id, const void *addr, size_t size,
   if (!CILKSAN_INITIALIZED)
     return;
 
+  CILKSAN_STAT(hooks[STAT_HOOK_LARGE_STORE]++);
   if (!should_check()) {
     DBG_TRACE(MEMORY, "SKIP %s wrote (%p, %ld)\n", __FUNCTION__, addr, size);
     return;
@@ -759,10 +805,20 @@ void __csan_large_store(csi_id_t store_id, const void *addr, size_t size,
     return;
   }
 
+  if (is_suppressed(store_suppressed, store_id)) {
+    DBG_TRACE(MEMORY, "SKIP %s wrote (%p, %ld) at suppressed site\n",
+              __FUNCTION__, addr, size);
+    return;
+  }
+
   // Record the address of this store.
   if (__builtin_expect(!store_pc[store_id], false))
     store_pc[store_id] = CALLERPC;
 
+  // Skip accesses to memory that is private to the current strand.
+  if (CilkSanImpl.is_private_access(false, store_id, (uintptr_t)addr, size))
+    return;
+
   DBG_TRACE(MEMORY, "%s wrote (%p, %ld)\n", __FUNCTION__, addr, size);
 
   if (is_running_under_rr)
@@ -792,6 +848,7 @@ void __csi_after_alloca(const csi_id_t alloca_id, const void *addr,
   if (!CILKSAN_INITIALIZED)
     return;
 
+  CILKSAN_STAT(hooks[STAT_HOOK_ALLOCA]++);
   if (stack_low_addr > (uintptr_t)addr)
     stack_low_addr = (uintptr_t)addr;
 
@@ -817,6 +874,7 @@ void __csan_after_allocfn(const csi_id_t allocfn_id,
   if (!CILKSAN_INITIALIZED)
     return;
 
+  CILKSAN_STAT(hooks[STAT_HOOK_ALLOCFN]++);
   DBG_TRACE(
       CALLBACK,
       "__csan_after_allocfn(%ld, %s, addr = %p, size = %ld, oldaddr = %p)\n",
@@ -1066,6 +1124,7 @@ void __csan_after_free(const csi_id_t free_id,
   if (!CILKSAN_INITIALIZED)
     return;
 
+  CILKSAN_STAT(hooks[STAT_HOOK_FREE]++);
   if (!should_check()) {
     CilkSanImpl.mark_free(ptr);
     return;
@@ -1103,6 +1162,22 @@ CILKSAN_API void __cilksan_record_free(void *ptr) {
   CilkSanImpl.mark_free(ptr);
 }
 
+CILKSAN_API void __cilksan_mark_private(const void *ptr, size_t len) {
+  DBG_TRACE(CALLBACK, "__cilksan_mark_private(%p, %ld)\n", ptr, len);
+  if (CILKSAN_INITIALIZED) {
+    CheckingRAII nocheck;
+    CilkSanImpl.mark_private((uintptr_t)ptr, len);
+  }
+}
+
+CILKSAN_API void __cilksan_unmark_private(const void *ptr, size_t len) {
+  DBG_TRACE(CALLBACK, "__cilksan_unmark_private(%p, %ld)\n", ptr, len);
+  if (CILKSAN_INITIALIZED) {
+    CheckingRAII nocheck;
+    CilkSanImpl.unmark_private((uintptr_t)ptr, len);
+  }
+}
+
 // FIXME: Currently these dynamic interposers are never used, because common
 // third-party libraries, such as jemalloc, do not work properly when these
 // methods are dynamically interposed.  We therefore rely on Cilksan hooks to
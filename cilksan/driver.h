@@ -10,6 +10,7 @@
 #include "cilksan_internal.h"
 #include "locksets.h"
 #include "stack.h"
+#include "suppressions.h"
 
 #ifndef CILKSAN_VIS
 #define CILKSAN_VIS __attribute__((visibility("default")))
@@ -128,6 +129,8 @@ static inline bool is_on_stack(uintptr_t addr) {
 // Helper function for checking a function that reads len bytes starting at ptr.
 static inline void check_read_bytes(csi_id_t call_id, MAAP_t MAAPVal,
                                     const void *ptr, size_t len) {
+  if (is_suppressed(call_suppressed, call_id))
+    return;
   if (checkMAAP(MAAPVal, MAAP_t::Mod)) {
     if (__builtin_expect(CilkSanImpl.locks_held(), false)) {
       CilkSanImpl.do_locked_read<MAType_t::FNRW>(call_id, (uintptr_t)ptr, len,
@@ -140,6 +143,8 @@ static inline void check_read_bytes(csi_id_t call_id, MAAP_t MAAPVal,
 
 static inline void check_read_bytes(csi_id_t call_id, MAAP_t MAAPVal,
                                     uintptr_t ptr, size_t len) {
+  if (is_suppressed(call_suppressed, call_id))
+    return;
   if (checkMAAP(MAAPVal, MAAP_t::Mod)) {
     if (__builtin_expect(CilkSanImpl.locks_held(), false)) {
       CilkSanImpl.do_locked_read<MAType_t::FNRW>(call_id, ptr, len, 0);
@@ -153,6 +158,8 @@ static inline void check_read_bytes(csi_id_t call_id, MAAP_t MAAPVal,
 // ptr.
 static inline void check_write_bytes(csi_id_t call_id, MAAP_t MAAPVal,
                                      const void *ptr, size_t len) {
+  if (is_suppressed(call_suppressed, call_id))
+    return;
   if (checkMAAP(MAAPVal, MAAP_t::Ref)) {
     if (__builtin_expect(CilkSanImpl.locks_held(), false)) {
       CilkSanImpl.do_locked_write<MAType_t::FNRW>(call_id, (uintptr_t)ptr, len,
@@ -165,6 +172,8 @@ static inline void check_write_bytes(csi_id_t call_id, MAAP_t MAAPVal,
 
 static inline void check_write_bytes(csi_id_t call_id, MAAP_t MAAPVal,
                                      uintptr_t ptr, size_t len) {
+  if (is_suppressed(call_suppressed, call_id))
+    return;
   if (checkMAAP(MAAPVal, MAAP_t::Ref)) {
     if (__builtin_expect(CilkSanImpl.locks_held(), false)) {
       CilkSanImpl.do_locked_write<MAType_t::FNRW>(call_id, ptr, len, 0);
@@ -177,6 +186,8 @@ static inline void check_write_bytes(csi_id_t call_id, MAAP_t MAAPVal,
 CILKSAN_API bool __cilksan_should_check(void);
 CILKSAN_API void __cilksan_record_alloc(void *addr, size_t size);
 CILKSAN_API void __cilksan_record_free(void *ptr);
+CILKSAN_API void __cilksan_mark_private(const void *ptr, size_t len);
+CILKSAN_API void __cilksan_unmark_private(const void *ptr, size_t len);
 
 CILKSAN_API void __cilksan_begin_atomic();
 CILKSAN_API void __cilksan_end_atomic();
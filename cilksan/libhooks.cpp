@@ -3088,6 +3088,151 @@ CILKSAN_API void __csan_pwrite(const csi_id_t call_id, const csi_id_t func_id,
   check_read_bytes(call_id, buffer_MAAPVal, buffer, result);
 }
 
+///////////////////////////////////////////////////////////////////////////
+// Interposers for library routines that call back into the program
+//
+// Cilksan provides its own implementations of qsort and bsearch.  The C
+// library's implementations call the comparator from uninstrumented code, and
+// qsort may move elements through temporary buffers that Cilksan never sees
+// allocated, which leads Cilksan to attribute the comparator's reads to stale
+// shadow memory.  These implementations work in place, so every comparator call
+// reads elements of the program's own array under instrumentation.  The
+// element moves performed by the sort itself are not instrumented; instead, the
+// __csan_qsort hook checks them as a write to the whole array.
+
+using compar_t = int (*)(const void *, const void *);
+
+// Helper function to swap two elements of size bytes.
+static inline void swap_elements(char *a, char *b, size_t size) {
+  char tmp[64];
+  while (size > 0) {
+    size_t n = size < sizeof(tmp) ? size : sizeof(tmp);
+    memcpy(tmp, a, n);
+    memcpy(a, b, n);
+    memcpy(b, tmp, n);
+    a += n;
+    b += n;
+    size -= n;
+  }
+}
+
+static void insertion_sort(char *base, size_t count, size_t size,
+                           compar_t comp) {
+  for (size_t i = 1; i < count; ++i) {
+    char *elem = base + i * size;
+    while (elem > base && comp(elem - size, elem) > 0) {
+      swap_elements(elem - size, elem, size);
+      elem -= size;
+    }
+  }
+}
+
+static void sift_down(char *base, size_t root, size_t count, size_t size,
+                      compar_t comp) {
+  while (true) {
+    size_t child = 2 * root + 1;
+    if (child >= count)
+      return;
+    if (child + 1 < count &&
+        comp(base + child * size, base + (child + 1) * size) < 0)
+      ++child;
+    if (comp(base + root * size, base + child * size) >= 0)
+      return;
+    swap_elements(base + root * size, base + child * size, size);
+    root = child;
+  }
+}
+
+static void heap_sort(char *base, size_t count, size_t size, compar_t comp) {
+  for (size_t i = count / 2; i-- > 0;)
+    sift_down(base, i, count, size, comp);
+  for (size_t end = count; end-- > 1;) {
+    swap_elements(base, base + end * size, size);
+    sift_down(base, 0, end, size, comp);
+  }
+}
+
+// Introspective sort: quicksort with a median-of-three pivot, which falls back
+// to heapsort if the recursion gets too deep and to insertion sort for small
+// ranges.
+static void intro_sort(char *base, size_t count, size_t size, compar_t comp,
+                       unsigned depth) {
+  static constexpr size_t INSERTION_SORT_THRESHOLD = 16;
+  while (count > INSERTION_SORT_THRESHOLD) {
+    if (0 == depth) {
+      heap_sort(base, count, size, comp);
+      return;
+    }
+    --depth;
+
+    // Move the median of the first, middle, and last elements to the front, to
+    // serve as the pivot.
+    char *lo = base, *mid = base + (count / 2) * size,
+         *hi = base + (count - 1) * size;
+    if (comp(mid, lo) < 0)
+      swap_elements(mid, lo, size);
+    if (comp(hi, mid) < 0) {
+      swap_elements(hi, mid, size);
+      if (comp(mid, lo) < 0)
+        swap_elements(mid, lo, size);
+    }
+    swap_elements(base, mid, size);
+
+    // Partition the remaining elements around the pivot.
+    size_t i = 0, j = count;
+    while (true) {
+      do
+        ++i;
+      while (i < count && comp(base + i * size, base) < 0);
+      do
+        --j;
+      while (comp(base + j * size, base) > 0);
+      if (i >= j)
+        break;
+      swap_elements(base + i * size, base + j * size, size);
+    }
+    swap_elements(base, base + j * size, size);
+
+    // Recur on the smaller partition and iterate on the larger one.
+    size_t left = j, right = count - j - 1;
+    if (left < right) {
+      intro_sort(base, left, size, comp, depth);
+      base += (j + 1) * size;
+      count = right;
+    } else {
+      intro_sort(base + (j + 1) * size, right, size, comp, depth);
+      count = left;
+    }
+  }
+  insertion_sort(base, count, size, comp);
+}
+
+CILKSAN_API CILKSAN_WEAK void qsort(void *base, size_t count, size_t size,
+                                    compar_t comp) {
+  if (count < 2 || 0 == size)
+    return;
+  unsigned depth = 2 * (63 - __builtin_clzl(count));
+  intro_sort((char *)base, count, size, comp, depth);
+}
+
+CILKSAN_API CILKSAN_WEAK void *bsearch(const void *key, const void *base,
+                                       size_t count, size_t size,
+                                       compar_t comp) {
+  size_t lo = 0, hi = count;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    const void *elem = (const char *)base + mid * size;
+    int cmp = comp(key, elem);
+    if (cmp < 0)
+      hi = mid;
+    else if (cmp > 0)
+      lo = mid + 1;
+    else
+      return const_cast<void *>(elem);
+  }
+  return nullptr;
+}
+
 CILKSAN_API void __csan_qsort(const csi_id_t call_id, const csi_id_t func_id,
                               unsigned MAAP_count, const call_prop_t prop,
                               void *ptr, size_t count, size_t size,
@@ -3105,12 +3250,39 @@ CILKSAN_API void __csan_qsort(const csi_id_t call_id, const csi_id_t func_id,
   if (!is_execution_parallel())
     return;
 
-  // FIXME: Model the memory references performed by qsort and comp more
-  // precisely.
+  // The comparator calls made by Cilksan's qsort were checked as they ran.
+  // Check the element moves performed by the sort itself as one write to the
+  // whole array.  The shadow memory records a write that covers an entire
+  // 2^LG_LINE_SIZE-byte line as a single entry for that line, discarding any
+  // finer-grained entries, so this update costs one entry per line rather than
+  // one per element.
   check_read_bytes(call_id, comp_MAAPVal, (const void *)comp, sizeof(comp));
   check_write_bytes(call_id, ptr_MAAPVal, ptr, count * size);
 }
 
+CILKSAN_API void __csan_bsearch(const csi_id_t call_id, const csi_id_t func_id,
+                                unsigned MAAP_count, const call_prop_t prop,
+                                void *result, const void *key, const void *ptr,
+                                size_t count, size_t size,
+                                int (*comp)(const void *, const void *)) {
+  START_HOOK(call_id);
+
+  MAAP_t comp_MAAPVal = MAAP_t::ModRef;
+  if (MAAP_count > 0) {
+    // Pop the MAAPs for key and ptr.  Cilksan's bsearch only reads these
+    // through the comparator, whose accesses were checked as they ran.
+    MAAPs.pop();
+    MAAPs.pop();
+    comp_MAAPVal = MAAPs.back().second;
+    MAAPs.pop();
+  }
+
+  if (!is_execution_parallel())
+    return;
+
+  check_read_bytes(call_id, comp_MAAPVal, (const void *)comp, sizeof(comp));
+}
+
 CILKSAN_API void __csan_read(const csi_id_t call_id, const csi_id_t func_id,
                              unsigned MAAP_count, const call_prop_t prop,
                              ssize_t result, int fd, void *buf, size_t count) {
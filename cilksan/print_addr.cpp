@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cstring>
 #include <fstream>
 #include <iostream>
@@ -5,6 +6,7 @@
 #include <sstream>
 #include <unordered_map>
 #include <memory>
+#include <vector>
 
 #include <inttypes.h>
 #include <unistd.h>
@@ -13,6 +15,7 @@
 #include "csan.h"
 #include "cilksan_internal.h"
 #include "debug_util.h"
+#include "suppressions.h"
 
 extern bool is_running_under_rr;
 
@@ -350,6 +353,56 @@ get_call_stack(const AccessLoc_t &instrAddr) {
   return call_stack;
 }
 
+// Print two logically parallel accesses with their call stacks, followed by
+// their common calling context.
+static void print_access_pair(const std::string &first_acc_info,
+                              const AccessLoc_t &first_inst,
+                              const std::string &second_acc_info,
+                              const AccessLoc_t &second_inst,
+                              const Decorator &d) {
+  // Extract the two call stacks
+  int first_call_stack_size = first_inst.getCallStackSize();
+  int second_call_stack_size = second_inst.getCallStackSize();
+  auto first_call_stack = get_call_stack(first_inst);
+  auto second_call_stack = get_call_stack(second_inst);
+
+  // Determine where the two call stacks diverge
+  int divergence = get_call_stack_divergence_pt(
+      first_call_stack,
+      first_call_stack_size,
+      second_call_stack,
+      second_call_stack_size);
+
+  // Print the two accesses
+  outs << d.Bold() << "*  " << d.Default() << first_acc_info << "\n";
+  for (int i = first_call_stack_size - 1; i >= divergence; --i)
+    outs << "+   " << get_info_on_call(first_call_stack[i].first, d) << "\n";
+  outs << "|" << d.Bold() << "* " << d.Default() << second_acc_info << "\n";
+  for (int i = second_call_stack_size - 1; i >= divergence; --i)
+    outs << "|+  " << get_info_on_call(second_call_stack[i].first, d) << "\n";
+
+  // Print the common calling context
+  if (divergence > 0) {
+    outs << "\\| Common calling context\n";
+    for (int i = divergence - 1; i >= 0; --i)
+      outs << " +  " << get_info_on_call(first_call_stack[i].first, d) << "\n";
+  }
+}
+
+// Print the allocation context of alloc_inst, if it is valid.
+static void print_alloc_context(const AccessLoc_t &alloc_inst,
+                                const Decorator &d) {
+  if (!alloc_inst.isValid())
+    return;
+  outs << "   Allocation context\n";
+  const csi_id_t alloca_id = alloc_inst.getID();
+  outs << "    " << get_info_on_alloca(alloca_id, d) << "\n";
+
+  auto alloc_call_stack = get_call_stack(alloc_inst);
+  for (int i = alloc_inst.getCallStackSize() - 1; i >= 0; --i)
+    outs << "    " << get_info_on_call(alloc_call_stack[i].first, d) << "\n";
+}
+
 bool CilkSanImpl_t::ColorizeReports() {
   char *e = getenv("CILKSAN_COLOR_REPORT");
   if (e) {
@@ -502,44 +555,9 @@ void RaceInfo_t::print(const AccessLoc_t &first_inst,
   second_acc_info =
       get_info_on_mem_access(second_inst.getID(), second_acc_type, 1, d);
 
-  // Extract the two call stacks
-  int first_call_stack_size = first_inst.getCallStackSize();
-  int second_call_stack_size = second_inst.getCallStackSize();
-  auto first_call_stack = get_call_stack(first_inst);
-  auto second_call_stack = get_call_stack(second_inst);
-
-  // Determine where the two call stacks diverge
-  int divergence = get_call_stack_divergence_pt(
-      first_call_stack,
-      first_call_stack_size,
-      second_call_stack,
-      second_call_stack_size);
-
-  // Print the two accesses involved in the race
-  outs << d.Bold() << "*  " << d.Default() << first_acc_info << "\n";
-  for (int i = first_call_stack_size - 1; i >= divergence; --i)
-    outs << "+   " << get_info_on_call(first_call_stack[i].first, d) << "\n";
-  outs << "|" << d.Bold() << "* " << d.Default() << second_acc_info << "\n";
-  for (int i = second_call_stack_size - 1; i >= divergence; --i)
-    outs << "|+  " << get_info_on_call(second_call_stack[i].first, d) << "\n";
-
-  // Print the common calling context
-  if (divergence > 0) {
-    outs << "\\| Common calling context\n";
-    for (int i = divergence - 1; i >= 0; --i)
-      outs << " +  " << get_info_on_call(first_call_stack[i].first, d) << "\n";
-  }
-
-  // Print the allocation
-  if (alloc_inst.isValid()) {
-    outs << "   Allocation context\n";
-    const csi_id_t alloca_id = alloc_inst.getID();
-    outs << "    " << get_info_on_alloca(alloca_id, d) << "\n";
-
-    auto alloc_call_stack = get_call_stack(alloc_inst);
-    for (int i = alloc_inst.getCallStackSize() - 1; i >= 0; --i)
-      outs << "    " << get_info_on_call(alloc_call_stack[i].first, d) << "\n";
-  }
+  print_access_pair(first_acc_info, first_inst, second_acc_info, second_inst,
+                    d);
+  print_alloc_context(alloc_inst, d);
 
   outs << "\n";
 }
@@ -552,11 +570,53 @@ static void open_outf(void) {
     outf.open("cilksan_races.out");
 }
 
+// Helper function to check if the given access in a race is at a suppressed
+// program location.
+static bool is_suppressed_access(const AccessLoc_t &acc, bool is_write) {
+  if (!acc.isValid())
+    return false;
+  // Under RR, the IDs of loads and stores are replaced by RR ticks.
+  if (is_running_under_rr && acc.getType() == MAType_t::RW)
+    return false;
+  switch (acc.getType()) {
+  case MAType_t::RW:
+    return is_write ? is_suppressed(store_suppressed, acc.getID())
+                    : is_suppressed(load_suppressed, acc.getID());
+  case MAType_t::FNRW:
+  case MAType_t::STACK_FREE:
+    return is_suppressed(call_suppressed, acc.getID());
+  case MAType_t::ALLOC:
+  case MAType_t::REALLOC:
+    return is_suppressed(allocfn_suppressed, acc.getID());
+  default:
+    return false;
+  }
+}
+
+// Helper function to check if the allocation involved in a race is at a
+// suppressed allocation site.
+static bool is_suppressed_alloc(const AccessLoc_t &alloc_inst) {
+  if (!alloc_inst.isValid())
+    return false;
+  // Odd alloca_id's are heap allocations
+  const csi_id_t alloca_id = alloc_inst.getID();
+  if (alloca_id % 2)
+    return is_suppressed(allocfn_suppressed, alloca_id / 2);
+  return is_suppressed(alloca_suppressed, alloca_id / 2);
+}
+
 // Log the race detected
 void CilkSanImpl_t::report_race(
     const AccessLoc_t &first_inst, const AccessLoc_t &second_inst,
     const AccessLoc_t &alloc_inst, uintptr_t addr,
     enum RaceType_t race_type) {
+  // Drop races involving suppressed program locations.
+  if (__builtin_expect(suppressions_active, false) &&
+      (is_suppressed_access(first_inst, race_type != RW_RACE) ||
+       is_suppressed_access(second_inst, race_type != WR_RACE) ||
+       is_suppressed_alloc(alloc_inst)))
+    return;
+
   static int last_race_count = 0;
   bool found = false;
   // TODO: Make the key computation consistent with is_equivalent_race().
@@ -623,3 +683,90 @@ void CilkSanImpl_t::print_race_report() {
     outs << "\n";
   }
 }
+
+// Get the type of access, for printing, of an access involved in false
+// sharing.
+static ACC_TYPE get_false_sharing_acc_type(const AccessLoc_t &acc,
+                                           bool is_write) {
+  switch (acc.getType()) {
+  case MAType_t::FNRW:
+    return is_write ? CALL_STORE_ACC : CALL_LOAD_ACC;
+  case MAType_t::ALLOC:
+    return is_write ? ALLOC_STORE_ACC : ALLOC_LOAD_ACC;
+  default:
+    return is_write ? STORE_ACC : LOAD_ACC;
+  }
+}
+
+void FalseSharingInfo_t::print(const Decorator &d) const {
+  outs << d.Bold() << d.Error() << "False sharing on cache line " << std::hex
+       << line << d.Default() << std::dec << ": " << conflicts
+       << " conflicting accesses\n";
+
+  std::string first_acc_info = get_info_on_mem_access(
+      first.getID(), get_false_sharing_acc_type(first, type != RW_RACE), 0, d);
+  std::string second_acc_info = get_info_on_mem_access(
+      second.getID(), get_false_sharing_acc_type(second, type != WR_RACE), 1,
+      d);
+  print_access_pair(first_acc_info, first, second_acc_info, second, d);
+
+  // Print the allocations of the two accesses, which differ if distinct
+  // objects share the line.
+  print_alloc_context(first_alloc, d);
+  if (second_alloc.getID() != first_alloc.getID())
+    print_alloc_context(second_alloc, d);
+
+  outs << "\n";
+}
+
+// Record an example of false sharing on the cache line at line.
+void CilkSanImpl_t::report_false_sharing(
+    uintptr_t line, const AccessLoc_t &first_inst,
+    const AccessLoc_t &second_inst, const AccessLoc_t &first_alloc,
+    const AccessLoc_t &second_alloc, enum RaceType_t type) {
+  // Do not use conflicts involving suppressed program locations as examples.
+  // The line keeps its conflict count, and a later conflict may provide an
+  // example, but a line with no example is not reported.
+  if (__builtin_expect(suppressions_active, false) &&
+      (is_suppressed_access(first_inst, type != RW_RACE) ||
+       is_suppressed_access(second_inst, type != WR_RACE) ||
+       is_suppressed_alloc(first_alloc) || is_suppressed_alloc(second_alloc)))
+    return;
+
+  FalseSharingInfo_t &info = false_sharing_found[line];
+  info.line = line;
+  info.first = first_inst;
+  info.second = second_inst;
+  info.first_alloc = first_alloc;
+  info.second_alloc = second_alloc;
+  info.type = type;
+}
+
+// Print the false sharing found, ranking cache lines by the number of
+// conflicting accesses.
+void CilkSanImpl_t::print_false_sharing_report() {
+  std::vector<const FalseSharingInfo_t *> lines;
+  for (const auto &entry : false_sharing_found)
+    if (entry.second.first.isValid())
+      lines.push_back(&entry.second);
+  std::sort(lines.begin(), lines.end(),
+            [](const FalseSharingInfo_t *a, const FalseSharingInfo_t *b) {
+              if (a->conflicts != b->conflicts)
+                return a->conflicts > b->conflicts;
+              return a->line < b->line;
+            });
+
+  Decorator d(color_report);
+  for (const FalseSharingInfo_t *info : lines)
+    info->print(d);
+
+  outs << "Cilksan detected false sharing on " << lines.size()
+       << " cache lines.\n";
+  outs << "\n";
+}
+
+void CilkSanImpl_t::print_reducer_profile() {
+  outs << "Cilksan reducer profile:\n";
+  reducer_profile.print_csv(outs);
+  outs << "\n";
+}
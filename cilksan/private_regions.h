@@ -0,0 +1,104 @@
+// -*- C++ -*-
+#ifndef __PRIVATE_REGIONS_H__
+#define __PRIVATE_REGIONS_H__
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "dictionary.h"
+
+// A range of memory that the program-under-test has annotated as private to a
+// strand.  Accesses to a private region bypass the shadow memory.  Instead, the
+// region records only its last access, so that Cilksan can detect when two
+// logically parallel strands access the region.
+struct PrivateRegion_t {
+  uintptr_t start;
+  uintptr_t end;
+  MemoryAccess_t last_access;
+
+  PrivateRegion_t(uintptr_t start, uintptr_t end) : start(start), end(end) {}
+};
+
+// Set of disjoint private regions, sorted by start address.  Lookups are
+// expected to be far more frequent than insertions and removals, so the
+// regions are kept in a sorted array and searched with binary search.  A
+// bounding interval around all regions allows most accesses to be filtered
+// with two comparisons.
+class PrivateRegions_t {
+  std::vector<PrivateRegion_t *> regions;
+  uintptr_t lo = UINTPTR_MAX;
+  uintptr_t hi = 0;
+
+  void update_bounds() {
+    if (regions.empty()) {
+      lo = UINTPTR_MAX;
+      hi = 0;
+      return;
+    }
+    lo = regions.front()->start;
+    hi = regions.back()->end;
+  }
+
+  // Get the index of the first region that ends after addr.
+  size_t first_ending_after(uintptr_t addr) const {
+    auto it = std::upper_bound(
+        regions.begin(), regions.end(), addr,
+        [](uintptr_t a, const PrivateRegion_t *r) { return a < r->end; });
+    return it - regions.begin();
+  }
+
+public:
+  PrivateRegions_t() {}
+  ~PrivateRegions_t() { clear(); }
+
+  bool empty() const { return regions.empty(); }
+
+  // Get the private region containing all of [addr, addr+size), or nullptr if
+  // no such region exists.
+  __attribute__((always_inline)) PrivateRegion_t *find(uintptr_t addr,
+                                                       size_t size) const {
+    if (addr < lo || addr + size > hi)
+      return nullptr;
+    size_t idx = first_ending_after(addr);
+    if (idx == regions.size())
+      return nullptr;
+    PrivateRegion_t *region = regions[idx];
+    if (region->start <= addr && addr + size <= region->end)
+      return region;
+    return nullptr;
+  }
+
+  // Add the region [start, end), replacing any regions it overlaps.
+  PrivateRegion_t *insert(uintptr_t start, uintptr_t end) {
+    remove(start, end);
+    PrivateRegion_t *region = new PrivateRegion_t(start, end);
+    size_t idx = first_ending_after(start);
+    regions.insert(regions.begin() + idx, region);
+    update_bounds();
+    return region;
+  }
+
+  // Remove all regions that overlap [start, end).
+  void remove(uintptr_t start, uintptr_t end) {
+    if (end <= lo || start >= hi)
+      return;
+    size_t first = first_ending_after(start);
+    size_t last = first;
+    while (last < regions.size() && regions[last]->start < end)
+      delete regions[last++];
+    if (first == last)
+      return;
+    regions.erase(regions.begin() + first, regions.begin() + last);
+    update_bounds();
+  }
+
+  void clear() {
+    for (PrivateRegion_t *region : regions)
+      delete region;
+    regions.clear();
+    update_bounds();
+  }
+};
+
+#endif // __PRIVATE_REGIONS_H__
@@ -532,4 +532,19 @@ public:
                     const AccessLoc_t &alloc, const Decorator &d) const;
 };
 
+// Class summarizing the false sharing on a single cache line, i.e., the
+// logically parallel accesses to disjoint bytes of the line.  The first
+// conflict found on the line is kept as an example.
+struct FalseSharingInfo_t {
+  uintptr_t line = 0;   // address of the cache line
+  uint64_t conflicts = 0; // number of accesses that conflicted on the line
+  AccessLoc_t first;    // earlier access of the example conflict
+  AccessLoc_t second;   // later access of the example conflict
+  AccessLoc_t first_alloc;  // allocation accessed by first
+  AccessLoc_t second_alloc; // allocation accessed by second
+  enum RaceType_t type = WW_RACE; // types of the two accesses
+
+  void print(const Decorator &d) const;
+};
+
 #endif  // __RACE_INFO_H__
@@ -0,0 +1,123 @@
+// -*- C++ -*-
+#ifndef __REDUCER_PROFILE_H__
+#define __REDUCER_PROFILE_H__
+
+#include <cstdint>
+#include <ctime>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+#include <cilk/cilk_api.h>
+#include <csi/csi.h>
+
+class hyper_table;
+
+// Profile of reducer overheads, collected when the CILKSAN_REDUCER_PROFILE
+// environment variable is set.
+//
+// Cilksan simulates a steal of every continuation, creating a new view of a
+// reducer on the first lookup of that reducer in each stolen continuation and
+// reducing the views when the continuation is synced.  The profile counts, per
+// reducer, the lookups, the views created -- i.e., calls to the identity
+// function -- and the calls to the reduce function, and it times the identity
+// and reduce calls.  Reducers are reported by registration site.  The profile
+// also reports the number of simulated steals that created views and the
+// number of views, each reduced once, per such steal.  Because every
+// continuation is treated as stolen, these counts bound the overheads of any
+// parallel execution.
+struct ReducerProfile_t {
+  // ID of the call that registered the reducer, or UNKNOWN_CSI_ID.
+  csi_id_t register_id = UNKNOWN_CSI_ID;
+  uint64_t lookups = 0;
+  uint64_t views_created = 0;
+  uint64_t identity_ns = 0;
+  uint64_t reductions = 0;
+  uint64_t reduce_ns = 0;
+};
+
+class ReducerProfiler_t {
+  // Profiles of all reducers, in order of registration.
+  std::vector<ReducerProfile_t> reducers;
+  // Index in reducers of the profile of each registered reducer, by key.
+  std::unordered_map<uintptr_t, size_t> registered;
+  // Number of views created in each table of views of a simulated steal.
+  std::unordered_map<const hyper_table *, uint64_t> steal_views;
+
+  uint64_t steals = 0;
+  uint64_t max_steal_views = 0;
+
+  static uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+  }
+
+  ReducerProfile_t &get(uintptr_t key) {
+    auto it = registered.find(key);
+    if (it != registered.end())
+      return reducers[it->second];
+    // Profile a reducer registered without a hook, e.g., by uninstrumented
+    // code, from its first use.
+    registered[key] = reducers.size();
+    reducers.emplace_back();
+    return reducers.back();
+  }
+
+public:
+  void register_reducer(csi_id_t call_id, uintptr_t key) {
+    registered[key] = reducers.size();
+    reducers.emplace_back();
+    reducers.back().register_id = call_id;
+  }
+  void unregister_reducer(uintptr_t key) { registered.erase(key); }
+
+  void lookup(uintptr_t key) { ++get(key).lookups; }
+
+  // Record the start of a simulated steal, which created the table of views
+  // table.
+  void begin_steal(const hyper_table *table) {
+    ++steals;
+    steal_views[table] = 0;
+  }
+  // Record the destruction of the table of views table.
+  void end_steal(const hyper_table *table) {
+    auto it = steal_views.find(table);
+    if (it == steal_views.end())
+      return;
+    if (it->second > max_steal_views)
+      max_steal_views = it->second;
+    steal_views.erase(it);
+  }
+
+  // Call identity to create a view for the reducer key in table.
+  void identity(const hyper_table *table, uintptr_t key,
+                __cilk_identity_fn identity_fn, void *view) {
+    ReducerProfile_t &profile = get(key);
+    uint64_t start = now_ns();
+    identity_fn(view);
+    profile.identity_ns += now_ns() - start;
+    ++profile.views_created;
+    auto it = steal_views.find(table);
+    if (it != steal_views.end())
+      ++it->second;
+  }
+
+  // Call reduce_fn to reduce the views left and right of the reducer key.
+  void reduce(uintptr_t key, __cilk_reduce_fn reduce_fn, void *left,
+              void *right) {
+    ReducerProfile_t &profile = get(key);
+    uint64_t start = now_ns();
+    reduce_fn(left, right);
+    profile.reduce_ns += now_ns() - start;
+    ++profile.reductions;
+  }
+
+  void print_csv(std::ostream &OS);
+};
+
+// Flag set if reducer overheads are being profiled.
+extern bool reducer_profile_active;
+extern ReducerProfiler_t reducer_profile;
+
+#endif // __REDUCER_PROFILE_H__
@@ -1,11 +1,32 @@
+#include <algorithm>
 #include <cstdarg>
 #include <cstdio>
 #include <cstdlib>
+#include <map>
 
 #include "cilksan_internal.h"
 #include "debug_util.h"
 #include "driver.h"
 
+bool reducer_profile_active = false;
+ReducerProfiler_t reducer_profile;
+
+// Helper function to reduce the views left and right of the reducer key.
+static inline void call_reduce(uintptr_t key, __cilk_reduce_fn reduce_fn,
+                               void *left, void *right) {
+  if (__builtin_expect(reducer_profile_active, false))
+    reducer_profile.reduce(key, reduce_fn, left, right);
+  else
+    reduce_fn(left, right);
+}
+
+// Helper function to delete a table of reducer views.
+static inline void delete_reducer_views(hyper_table *reducer_views) {
+  if (__builtin_expect(reducer_profile_active, false))
+    reducer_profile.end_steal(reducer_views);
+  delete reducer_views;
+}
+
 // Hooks for handling reducer hyperobjects.
 
 static void reducer_register(const csi_id_t call_id, unsigned MAAP_count,
@@ -13,6 +34,9 @@ static void reducer_register(const csi_id_t call_id, unsigned MAAP_count,
   for (unsigned i = 0; i < MAAP_count; ++i)
     MAAPs.pop();
 
+  if (__builtin_expect(reducer_profile_active, false))
+    reducer_profile.register_reducer(call_id, (uintptr_t)key);
+
   if (CilkSanImpl.stealable()) {
     hyper_table *reducer_views = CilkSanImpl.get_or_create_reducer_views();
     reducer_views->insert((hyper_table::bucket){
@@ -57,6 +81,9 @@ CILKSAN_API void __csan_llvm_reducer_unregister(const csi_id_t call_id,
   for (unsigned i = 0; i < MAAP_count; ++i)
     MAAPs.pop();
 
+  if (__builtin_expect(reducer_profile_active, false))
+    reducer_profile.unregister_reducer((uintptr_t)key);
+
   // Remove this reducer from the table.
   if (hyper_table *reducer_views = CilkSanImpl.get_reducer_views()) {
     reducer_views->remove((uintptr_t)key);
@@ -83,6 +110,9 @@ CILKSAN_API void *__csan_llvm_hyper_lookup(const csi_id_t call_id,
   for (unsigned i = 0; i < MAAP_count; ++i)
     MAAPs.pop();
 
+  if (__builtin_expect(reducer_profile_active, false))
+    reducer_profile.lookup((uintptr_t)key);
+
   if (!is_execution_parallel())
     return view;
 
@@ -151,7 +181,7 @@ void CilkSanImpl_t::reduce_local_views() {
     // The key is the pointer to the leftmost view.
     void *left_view = (void *)b.key;
     reducer_base rb = b.value;
-    rb.reduce_fn(left_view, rb.view);
+    call_reduce(b.key, rb.reduce_fn, left_view, rb.view);
     // Delete the right view.
     free(rb.view);
     mark_free(rb.view);
@@ -161,7 +191,7 @@ void CilkSanImpl_t::reduce_local_views() {
   // Delete the table of local reducer views
   DBG_TRACE(REDUCER, "reduce_local_views: delete reducer_views %p\n",
             reducer_views);
-  delete reducer_views;
+  delete_reducer_views(reducer_views);
   f->reducer_views = nullptr;
 }
 
@@ -176,11 +206,11 @@ hyper_table::merge_two_hyper_tables(CilkSanImpl_t *__restrict__ tool,
   if (!right)
     return left;
   if (left->occupancy == 0) {
-    delete left;
+    delete_reducer_views(left);
     return right;
   }
   if (right->occupancy == 0) {
-    delete right;
+    delete_reducer_views(right);
     return left;
   }
 
@@ -219,11 +249,11 @@ hyper_table::merge_two_hyper_tables(CilkSanImpl_t *__restrict__ tool,
       // to preserve left-to-right ordering.  Free the right view when done.
       reducer_base dst_rb = dst_bucket->value;
       if (left_dst) {
-        dst_rb.reduce_fn(dst_rb.view, b.value.view);
+        call_reduce(b.key, dst_rb.reduce_fn, dst_rb.view, b.value.view);
         free(b.value.view);
         tool->mark_free(b.value.view);
       } else {
-        dst_rb.reduce_fn(b.value.view, dst_rb.view);
+        call_reduce(b.key, dst_rb.reduce_fn, b.value.view, dst_rb.view);
         free(dst_rb.view);
         tool->mark_free(dst_rb.view);
         dst_bucket->value.view = b.value.view;
@@ -232,6 +262,57 @@ hyper_table::merge_two_hyper_tables(CilkSanImpl_t *__restrict__ tool,
   }
 
   // Destroy the source hyper_table, and return the destination.
-  delete src;
+  delete_reducer_views(src);
   return dst;
 }
+
+void ReducerProfiler_t::print_csv(std::ostream &OS) {
+  // Aggregate the profiles of reducers by registration site.
+  std::map<csi_id_t, std::pair<uint64_t, ReducerProfile_t>> sites;
+  for (const ReducerProfile_t &profile : reducers) {
+    auto &site = sites[profile.register_id];
+    ++site.first;
+    site.second.lookups += profile.lookups;
+    site.second.views_created += profile.views_created;
+    site.second.identity_ns += profile.identity_ns;
+    site.second.reductions += profile.reductions;
+    site.second.reduce_ns += profile.reduce_ns;
+  }
+  std::vector<std::pair<csi_id_t, std::pair<uint64_t, ReducerProfile_t>>> rows(
+      sites.begin(), sites.end());
+  // List the most expensive sites first.
+  std::stable_sort(rows.begin(), rows.end(), [](const auto &a, const auto &b) {
+    return (a.second.second.identity_ns + a.second.second.reduce_ns) >
+           (b.second.second.identity_ns + b.second.second.reduce_ns);
+  });
+
+  // Steals whose tables of views are still live have not been reduced yet.
+  uint64_t max_views = max_steal_views;
+  for (const auto &entry : steal_views)
+    max_views = std::max(max_views, entry.second);
+  uint64_t total_views = 0;
+  for (const ReducerProfile_t &profile : reducers)
+    total_views += profile.views_created;
+
+  OS << "register site,file,line,column,reducers,lookups,views created"
+     << ",identity time (ns),reductions,reduce time (ns)\n";
+  for (const auto &row : rows) {
+    const ReducerProfile_t &site = row.second.second;
+    const csan_source_loc_t *loc = (UNKNOWN_CSI_ID == row.first)
+                                       ? nullptr
+                                       : __csan_get_call_source_loc(row.first);
+    if (loc)
+      OS << (loc->name ? loc->name : "") << ","
+         << (loc->filename ? loc->filename : "") << "," << loc->line_number
+         << "," << loc->column_number;
+    else
+      OS << "<unknown>,,,";
+    OS << "," << row.second.first << "," << site.lookups << ","
+       << site.views_created << "," << site.identity_ns << ","
+       << site.reductions << "," << site.reduce_ns << "\n";
+  }
+  OS << "\nsimulated steals with views," << steals << "\n";
+  OS << "views per steal,"
+     << (steals ? static_cast<double>(total_views) / steals : 0.0) << "\n";
+  OS << "max views per steal," << max_views << "\n";
+}
@@ -2,6 +2,7 @@
 #ifndef __SIMPLE_SHADOW_MEM__
 #define __SIMPLE_SHADOW_MEM__
 
+#include <algorithm>
 #include <cstdlib>
 #include <iostream>
 #include <inttypes.h>
@@ -13,6 +14,7 @@
 #include "dictionary.h"
 #include "locksets.h"
 #include "shadow_mem_allocator.h"
+#include "stats.h"
 #include "vector.h"
 
 class SimpleShadowMem;
@@ -173,10 +175,12 @@ private:
   struct MALineMethods {
     __attribute__((always_inline)) static MemoryAccess_t *
     allocate(size_t size) __attribute__((malloc)) {
+      CILKSAN_STAT(line_allocated());
       return MAAlloc.allocate(size);
     }
     __attribute__((always_inline)) static bool
     deallocate(__attribute__((noescape)) MemoryAccess_t *Ptr) {
+      CILKSAN_STAT(lines_freed++);
       return MAAlloc.deallocate(Ptr);
     }
     __attribute__((always_inline)) static bool
@@ -1355,7 +1359,9 @@ public:
   // High-level method to clear any occupancy information recorded.
   void clearOccupied() {
     for (uintptr_t wordAddr : TouchedWords)
-      Table[page(wordAddr)]->clear(wordAddr);
+      // The page might have been dropped since this word was touched.
+      if (Page_t *Page = Table[page(wordAddr)])
+        Page->clear(wordAddr);
     TouchedWords.clear();
   }
 
@@ -1405,8 +1411,8 @@ public:
     return Update_iterator<LockerPage_t>(*this, Chunk_t(addr, size));
   }
 
-  // Clear all entries for the specified chunk of memory.
-  __attribute__((always_inline)) void clear(uintptr_t addr, size_t size) {
+  // Clear all entries for the specified chunk of memory, one line at a time.
+  __attribute__((always_inline)) void clearLines(uintptr_t addr, size_t size) {
     Update_iterator<Page_t> UI(*this, Chunk_t(addr, size));
     UI.clear();
 
@@ -1416,6 +1422,48 @@ public:
       DRUI.clear();
     }
   }
+
+  // Drop the page at index idx, and its corresponding locker page, from the
+  // tables.  Deleting a page returns all of its materialized lines to the line
+  // allocator in one pass over the page, without the per-line bookkeeping of
+  // an Update_iterator.  The page's occupancy bits go with it, which is safe,
+  // because a later access to the page will simply allocate a fresh page.
+  void dropPage(uintptr_t idx) {
+    if (Page_t *Page = Table[idx]) {
+      Table[idx] = nullptr;
+      delete Page;
+    }
+    if (LockerTableUsed)
+      if (LockerPage_t *Page = LockerTable[idx]) {
+        LockerTable[idx] = nullptr;
+        delete Page;
+      }
+  }
+
+  // Clear all entries for the specified chunk of memory.
+  __attribute__((always_inline)) void clear(uintptr_t addr, size_t size) {
+    // Find the pages that the chunk covers entirely.
+    uintptr_t end = addr + size;
+    uintptr_t firstFullPage = (addr + PAGE_OFF - 1) & PAGE_MASK;
+    uintptr_t endFullPage = end & PAGE_MASK;
+    if (__builtin_expect(firstFullPage >= endFullPage, true)) {
+      // The chunk covers no page entirely, so clear it line by line.
+      clearLines(addr, size);
+      return;
+    }
+
+    // Clear the partial pages at either end of the chunk line by line, and
+    // drop all pages in between wholesale.  This makes clearing large chunks,
+    // such as unmapped or freed multi-GB buffers, linear in the number of
+    // pages rather than the number of lines.
+    if (firstFullPage != addr)
+      clearLines(addr, firstFullPage - addr);
+    for (uintptr_t pageAddr = firstFullPage; pageAddr != endFullPage;
+         pageAddr += PAGE_OFF)
+      dropPage(page(pageAddr));
+    if (endFullPage != end)
+      clearLines(endFullPage, end - endFullPage);
+  }
 };
 
 class SimpleShadowMem {
@@ -1579,6 +1627,77 @@ public:
     check_race<QITy, false, is_read>(QI, acc_id, type, f);
   }
 
+  // log_2 of the size of a cache line, for detecting false sharing.
+  static constexpr unsigned LG_CACHE_LINE_SIZE = 6;
+
+  // Find a previous access, using the given Query_iterator QI, that is
+  // logically in parallel with the current strand.  Returns the access, or
+  // nullptr if there is none, and sets AccAddr to its address.
+  template <typename QITy>
+  __attribute__((always_inline)) const MemoryAccess_t *
+  find_parallel_access(QITy &QI, const FrameData_t *f,
+                       uintptr_t &AccAddr) const {
+    while (!QI.isEnd()) {
+      const MemoryAccess_t *PrevAccess = QI.get();
+      if (PrevAccess && PrevAccess->isValid() &&
+          previousAccessInParallel(PrevAccess, f)) {
+        AccAddr = QI.getAddress();
+        return PrevAccess;
+      }
+      QI.next();
+    }
+    return nullptr;
+  }
+
+  // Check for false sharing between this access to [addr, addr+mem_size) and
+  // previous accesses, i.e., previous accesses in parallel to other bytes of
+  // the same cache lines, where at least one of the two accesses is a write.
+  // At most one conflict is counted per cache line.
+  template <bool is_read>
+  void check_false_sharing(const csi_id_t acc_id, MAType_t type,
+                           uintptr_t addr, size_t mem_size,
+                           const FrameData_t *f) const {
+    using RDict = SimpleDictionary<ReadMAAllocator>;
+    using WDict = SimpleDictionary<WriteMAAllocator>;
+    constexpr uintptr_t CACHE_LINE_SIZE = 1UL << LG_CACHE_LINE_SIZE;
+    uintptr_t end = addr + mem_size;
+    for (uintptr_t line = addr & ~(CACHE_LINE_SIZE - 1); line < end;
+         line += CACHE_LINE_SIZE) {
+      // The bytes of the line before and after this access.
+      uintptr_t line_end = line + CACHE_LINE_SIZE;
+      uintptr_t others[2][2] = {{line, std::max(line, addr)},
+                                {std::min(line_end, end), line_end}};
+      const MemoryAccess_t *PrevAccess = nullptr;
+      uintptr_t AccAddr = 0;
+      enum RaceType_t race_type = is_read ? WR_RACE : WW_RACE;
+      for (unsigned i = 0; i < 2; ++i) {
+        if (others[i][0] >= others[i][1])
+          continue;
+        size_t size = others[i][1] - others[i][0];
+        WDict::Query_iterator<WDict::Page_t> WQI =
+            Writes.getQueryIterator(others[i][0], size);
+        if ((PrevAccess = find_parallel_access(WQI, f, AccAddr)))
+          break;
+        if (!is_read) {
+          RDict::Query_iterator<RDict::Page_t> RQI =
+              Reads.getQueryIterator(others[i][0], size);
+          if ((PrevAccess = find_parallel_access(RQI, f, AccAddr))) {
+            race_type = RW_RACE;
+            break;
+          }
+        }
+      }
+      if (__builtin_expect(!PrevAccess, true))
+        continue;
+      if (CilkSanImpl.record_false_sharing(line))
+        CilkSanImpl.report_false_sharing(
+            line, PrevAccess->getLoc(),
+            AccessLoc_t(acc_id, type, CilkSanImpl.get_current_call_stack()),
+            findAllocLoc(AccAddr), findAllocLoc(std::max(line, addr)),
+            race_type);
+    }
+  }
+
   // Core routine for updating the entries of a dictionary, using the given
   // Update_iterator UI.
   template <typename UITy, class MASetFn>
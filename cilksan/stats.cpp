@@ -0,0 +1,131 @@
+#include <cinttypes>
+#include <cstdio>
+
+#include "stats.h"
+
+bool stats_active = false;
+bool stats_json = false;
+CilksanStats_t cilksan_stats;
+
+static const char *const hook_names[NUM_STAT_HOOKS] = {
+    "func_entry",
+    "func_exit",
+    "detach",
+    "task",
+    "task_exit",
+    "detach_continue",
+    "sync",
+    "load",
+    "large_load",
+    "store",
+    "large_store",
+    "alloca",
+    "allocfn",
+    "free",
+};
+
+// Helper to compute the ratio of two counters, guarding against division by
+// zero.
+static double ratio(uint64_t num, uint64_t denom) {
+  return denom ? static_cast<double>(num) / denom : 0.0;
+}
+
+static void print_buckets_csv(FILE *out, const char *name,
+                              const uint64_t *counts) {
+  for (unsigned i = 0; i < CilksanStats_t::NUM_SIZE_BUCKETS; ++i)
+    if (counts[i])
+      fprintf(out, "%s,%lu,%" PRIu64 "\n", name, 1UL << i, counts[i]);
+}
+
+static uint64_t sum_buckets(const uint64_t *counts) {
+  uint64_t sum = 0;
+  for (unsigned i = 0; i < CilksanStats_t::NUM_SIZE_BUCKETS; ++i)
+    sum += counts[i];
+  return sum;
+}
+
+void CilksanStats_t::print_csv(FILE *out) const {
+  fprintf(out, ",size (bytes),count\n");
+
+  print_buckets_csv(out, "reads", reads_checked);
+  fprintf(out, "total reads,,%" PRIu64 "\n", sum_buckets(reads_checked));
+  print_buckets_csv(out, "writes", writes_checked);
+  fprintf(out, "total writes,,%" PRIu64 "\n", sum_buckets(writes_checked));
+
+  fprintf(out, "total strands,,%" PRIu64 "\n", strands);
+  print_buckets_csv(out, "max reads", max_strand_reads_checked);
+  print_buckets_csv(out, "max writes", max_strand_writes_checked);
+
+  for (unsigned i = 0; i < NUM_STAT_HOOKS; ++i)
+    fprintf(out, "hook %s,,%" PRIu64 "\n", hook_names[i], hooks[i]);
+
+  fprintf(out, "occupancy filter hits,,%" PRIu64 "\n", occupancy_hits);
+  fprintf(out, "occupancy filter misses,,%" PRIu64 "\n", occupancy_misses);
+  fprintf(out, "occupancy filter hit rate,,%f\n",
+          ratio(occupancy_hits, occupancy_hits + occupancy_misses));
+  fprintf(out, "fast path checks,,%" PRIu64 "\n", fast_path_checks);
+  fprintf(out, "slow path checks,,%" PRIu64 "\n", slow_path_checks);
+  fprintf(out, "fast path ratio,,%f\n",
+          ratio(fast_path_checks, fast_path_checks + slow_path_checks));
+  fprintf(out, "shadow lines allocated,,%" PRIu64 "\n", lines_allocated);
+  fprintf(out, "shadow lines live,,%" PRIu64 "\n",
+          lines_allocated - lines_freed);
+  fprintf(out, "max shadow lines live,,%" PRIu64 "\n", max_lines_live);
+  fprintf(out, "DS nodes allocated,,%" PRIu64 "\n", ds_allocated);
+  fprintf(out, "DS nodes live,,%" PRIu64 "\n", ds_allocated - ds_freed);
+  fprintf(out, "max DS nodes live,,%" PRIu64 "\n", max_ds_live);
+}
+
+static void print_buckets_json(FILE *out, const char *name,
+                               const uint64_t *counts) {
+  fprintf(out, "  \"%s\": {", name);
+  bool first = true;
+  for (unsigned i = 0; i < CilksanStats_t::NUM_SIZE_BUCKETS; ++i) {
+    if (!counts[i])
+      continue;
+    fprintf(out, "%s\"%lu\": %" PRIu64, first ? "" : ", ", 1UL << i,
+            counts[i]);
+    first = false;
+  }
+  fprintf(out, "},\n");
+}
+
+void CilksanStats_t::print_json(FILE *out) const {
+  fprintf(out, "{\n");
+
+  print_buckets_json(out, "reads", reads_checked);
+  print_buckets_json(out, "writes", writes_checked);
+  print_buckets_json(out, "max_strand_reads", max_strand_reads_checked);
+  print_buckets_json(out, "max_strand_writes", max_strand_writes_checked);
+  fprintf(out, "  \"total_reads\": %" PRIu64 ",\n",
+          sum_buckets(reads_checked));
+  fprintf(out, "  \"total_writes\": %" PRIu64 ",\n",
+          sum_buckets(writes_checked));
+  fprintf(out, "  \"strands\": %" PRIu64 ",\n", strands);
+
+  fprintf(out, "  \"hooks\": {");
+  for (unsigned i = 0; i < NUM_STAT_HOOKS; ++i)
+    fprintf(out, "%s\"%s\": %" PRIu64, i ? ", " : "", hook_names[i],
+            hooks[i]);
+  fprintf(out, "},\n");
+
+  fprintf(out, "  \"occupancy_filter_hits\": %" PRIu64 ",\n", occupancy_hits);
+  fprintf(out, "  \"occupancy_filter_misses\": %" PRIu64 ",\n",
+          occupancy_misses);
+  fprintf(out, "  \"occupancy_filter_hit_rate\": %f,\n",
+          ratio(occupancy_hits, occupancy_hits + occupancy_misses));
+  fprintf(out, "  \"fast_path_checks\": %" PRIu64 ",\n", fast_path_checks);
+  fprintf(out, "  \"slow_path_checks\": %" PRIu64 ",\n", slow_path_checks);
+  fprintf(out, "  \"fast_path_ratio\": %f,\n",
+          ratio(fast_path_checks, fast_path_checks + slow_path_checks));
+  fprintf(out, "  \"shadow_lines_allocated\": %" PRIu64 ",\n",
+          lines_allocated);
+  fprintf(out, "  \"shadow_lines_live\": %" PRIu64 ",\n",
+          lines_allocated - lines_freed);
+  fprintf(out, "  \"max_shadow_lines_live\": %" PRIu64 ",\n", max_lines_live);
+  fprintf(out, "  \"ds_nodes_allocated\": %" PRIu64 ",\n", ds_allocated);
+  fprintf(out, "  \"ds_nodes_live\": %" PRIu64 ",\n", ds_allocated - ds_freed);
+  fprintf(out, "  \"max_ds_nodes_live\": %" PRIu64 "\n", max_ds_live);
+
+  fprintf(out, "}\n");
+}
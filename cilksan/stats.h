@@ -0,0 +1,142 @@
+// -*- C++ -*-
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include <cstdint>
+#include <cstdio>
+
+// Low-overhead statistics collected when the CILKSAN_STATS environment
+// variable is set.  All counters live in fixed-size arrays, so that updating a
+// statistic costs a few increments and never allocates.  Memory-access counts
+// are bucketed by the base-2 logarithm of the access size.
+//
+// Setting CILKSAN_STATS=json dumps the statistics as JSON at exit.  Any other
+// nonzero value dumps them as CSV.
+
+// Hooks whose invocations are counted.
+enum StatHook_t : unsigned {
+  STAT_HOOK_FUNC_ENTRY = 0,
+  STAT_HOOK_FUNC_EXIT,
+  STAT_HOOK_DETACH,
+  STAT_HOOK_TASK,
+  STAT_HOOK_TASK_EXIT,
+  STAT_HOOK_DETACH_CONTINUE,
+  STAT_HOOK_SYNC,
+  STAT_HOOK_LOAD,
+  STAT_HOOK_LARGE_LOAD,
+  STAT_HOOK_STORE,
+  STAT_HOOK_LARGE_STORE,
+  STAT_HOOK_ALLOCA,
+  STAT_HOOK_ALLOCFN,
+  STAT_HOOK_FREE,
+  NUM_STAT_HOOKS
+};
+
+struct CilksanStats_t {
+  static constexpr unsigned NUM_SIZE_BUCKETS = 64;
+
+  // Memory accesses checked, by size bucket, in total and in the current
+  // strand, and the maximum number checked by any one strand.
+  uint64_t reads_checked[NUM_SIZE_BUCKETS] = {0};
+  uint64_t writes_checked[NUM_SIZE_BUCKETS] = {0};
+  uint64_t strand_reads_checked[NUM_SIZE_BUCKETS] = {0};
+  uint64_t strand_writes_checked[NUM_SIZE_BUCKETS] = {0};
+  uint64_t max_strand_reads_checked[NUM_SIZE_BUCKETS] = {0};
+  uint64_t max_strand_writes_checked[NUM_SIZE_BUCKETS] = {0};
+  // Bitmasks of the buckets updated in the current strand.
+  uint64_t strand_read_buckets = 0;
+  uint64_t strand_write_buckets = 0;
+  uint64_t strands = 0;
+
+  uint64_t hooks[NUM_STAT_HOOKS] = {0};
+
+  // Accesses filtered out by the occupancy bits, because the current strand
+  // already accessed the same memory, versus accesses that passed the filter.
+  uint64_t occupancy_hits = 0;
+  uint64_t occupancy_misses = 0;
+
+  // Accesses handled by the fast-path and slow-path checks.
+  uint64_t fast_path_checks = 0;
+  uint64_t slow_path_checks = 0;
+
+  // Shadow-memory lines allocated and freed, and the peak number live.
+  uint64_t lines_allocated = 0;
+  uint64_t lines_freed = 0;
+  uint64_t max_lines_live = 0;
+
+  // Disjoint-set nodes allocated and freed, and the peak number live.
+  uint64_t ds_allocated = 0;
+  uint64_t ds_freed = 0;
+  uint64_t max_ds_live = 0;
+
+  __attribute__((always_inline)) static unsigned size_bucket(size_t size) {
+    return 63 - __builtin_clzl(size);
+  }
+
+  __attribute__((always_inline)) void collect_read(size_t size) {
+    if (!size)
+      return;
+    unsigned bucket = size_bucket(size);
+    ++reads_checked[bucket];
+    ++strand_reads_checked[bucket];
+    strand_read_buckets |= (1UL << bucket);
+  }
+  __attribute__((always_inline)) void collect_write(size_t size) {
+    if (!size)
+      return;
+    unsigned bucket = size_bucket(size);
+    ++writes_checked[bucket];
+    ++strand_writes_checked[bucket];
+    strand_write_buckets |= (1UL << bucket);
+  }
+
+  // Fold the counts for the current strand into the per-strand maximums.
+  void end_strand() {
+    ++strands;
+    while (strand_read_buckets) {
+      unsigned bucket = __builtin_ctzl(strand_read_buckets);
+      strand_read_buckets &= strand_read_buckets - 1;
+      if (max_strand_reads_checked[bucket] < strand_reads_checked[bucket])
+        max_strand_reads_checked[bucket] = strand_reads_checked[bucket];
+      strand_reads_checked[bucket] = 0;
+    }
+    while (strand_write_buckets) {
+      unsigned bucket = __builtin_ctzl(strand_write_buckets);
+      strand_write_buckets &= strand_write_buckets - 1;
+      if (max_strand_writes_checked[bucket] < strand_writes_checked[bucket])
+        max_strand_writes_checked[bucket] = strand_writes_checked[bucket];
+      strand_writes_checked[bucket] = 0;
+    }
+  }
+
+  __attribute__((always_inline)) void line_allocated() {
+    uint64_t live = ++lines_allocated - lines_freed;
+    if (live > max_lines_live)
+      max_lines_live = live;
+  }
+  __attribute__((always_inline)) void ds_node_allocated() {
+    uint64_t live = ++ds_allocated - ds_freed;
+    if (live > max_ds_live)
+      max_ds_live = live;
+  }
+
+  void print_csv(FILE *out) const;
+  void print_json(FILE *out) const;
+};
+
+// Flag set if statistics are being collected.
+extern bool stats_active;
+// Flag set if statistics should be dumped as JSON rather than CSV.
+extern bool stats_json;
+extern CilksanStats_t cilksan_stats;
+
+// Helper macro to update a statistic only when statistics are being
+// collected.
+#define CILKSAN_STAT(stmt)                                                     \
+  do {                                                                         \
+    if (__builtin_expect(stats_active, false)) {                               \
+      cilksan_stats.stmt;                                                      \
+    }                                                                          \
+  } while (0)
+
+#endif // __STATS_H__
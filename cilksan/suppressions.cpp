@@ -0,0 +1,192 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fnmatch.h>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "suppressions.h"
+
+// FILE io used to print error messages
+extern FILE *err_io;
+
+extern csi_id_t total_call;
+extern csi_id_t total_load;
+extern csi_id_t total_store;
+extern csi_id_t total_alloca;
+extern csi_id_t total_allocfn;
+
+bool suppressions_active = false;
+
+uint64_t *load_suppressed = nullptr;
+uint64_t *store_suppressed = nullptr;
+uint64_t *call_suppressed = nullptr;
+uint64_t *alloca_suppressed = nullptr;
+uint64_t *allocfn_suppressed = nullptr;
+
+namespace {
+
+enum SuppressionType_t { FUN_SUPP, SRC_SUPP, ALLOC_SUPP };
+
+struct suppression_t {
+  SuppressionType_t type;
+  std::string pattern;
+  // Line number to match, or 0 to match any line.
+  int32_t line;
+};
+
+std::vector<suppression_t> suppressions;
+bool suppressions_loaded = false;
+
+} // end anonymous namespace
+
+// Parse a single line of the suppression file.  Returns false if the line is
+// malformed.
+static bool parse_suppression(const std::string &line) {
+  size_t colon = line.find(':');
+  if (colon == std::string::npos || colon + 1 == line.size())
+    return false;
+
+  std::string kind = line.substr(0, colon);
+  suppression_t supp;
+  supp.pattern = line.substr(colon + 1);
+  supp.line = 0;
+  if (kind == "fun") {
+    supp.type = FUN_SUPP;
+  } else if (kind == "src" || kind == "alloc") {
+    supp.type = (kind == "src") ? SRC_SUPP : ALLOC_SUPP;
+    // Split off a trailing line number, if there is one.
+    size_t line_colon = supp.pattern.rfind(':');
+    if (line_colon != std::string::npos &&
+        line_colon + 1 < supp.pattern.size()) {
+      const char *line_str = supp.pattern.c_str() + line_colon + 1;
+      char *end;
+      long line_no = strtol(line_str, &end, 10);
+      if (*end == '\0' && line_no > 0) {
+        supp.line = static_cast<int32_t>(line_no);
+        supp.pattern.resize(line_colon);
+      }
+    }
+  } else {
+    return false;
+  }
+
+  suppressions.push_back(supp);
+  return true;
+}
+
+static void load_suppressions() {
+  suppressions_loaded = true;
+  const char *path = getenv("CILKSAN_SUPPRESSIONS");
+  if (!path || '\0' == *path)
+    return;
+
+  std::ifstream in(path);
+  if (!in.is_open()) {
+    fprintf(err_io, "Cilksan Warning: Could not open suppression file %s\n",
+            path);
+    return;
+  }
+
+  std::string line;
+  unsigned line_no = 0;
+  while (std::getline(in, line)) {
+    ++line_no;
+    // Trim surrounding whitespace.
+    size_t first = line.find_first_not_of(" \t\r");
+    if (first == std::string::npos || line[first] == '#')
+      continue;
+    size_t last = line.find_last_not_of(" \t\r");
+    line = line.substr(first, last - first + 1);
+
+    if (!parse_suppression(line))
+      fprintf(err_io,
+              "Cilksan Warning: Ignoring malformed suppression at %s:%u: %s\n",
+              path, line_no, line.c_str());
+  }
+
+  suppressions_active = !suppressions.empty();
+}
+
+static bool filename_matches(const char *pattern, const char *filename) {
+  if (!filename)
+    return false;
+  if (0 == fnmatch(pattern, filename, 0))
+    return true;
+  const char *base = strrchr(filename, '/');
+  return base && 0 == fnmatch(pattern, base + 1, 0);
+}
+
+// Check if the source location matches any suppression of the given type.
+// Function suppressions apply to code locations, not allocation sites.
+static bool matches_suppression(const csan_source_loc_t *loc,
+                                SuppressionType_t type) {
+  if (!loc)
+    return false;
+  for (const suppression_t &supp : suppressions) {
+    if (supp.type == FUN_SUPP) {
+      if (type == SRC_SUPP && loc->name &&
+          0 == fnmatch(supp.pattern.c_str(), loc->name, 0))
+        return true;
+      continue;
+    }
+    if (supp.type != type)
+      continue;
+    if (supp.line && supp.line != loc->line_number)
+      continue;
+    if (filename_matches(supp.pattern.c_str(), loc->filename))
+      return true;
+  }
+  return false;
+}
+
+// Helper function to grow a suppression bitmap and fill in the bits for the
+// new CSI IDs.
+static void grow_suppression_bitmap(
+    uint64_t *&bitmap, csi_id_t table_cap, csi_id_t extra_cap,
+    const csan_source_loc_t *(*get_loc)(const csi_id_t),
+    SuppressionType_t type) {
+  csi_id_t old_words = (table_cap + 63) / 64;
+  csi_id_t new_words = (table_cap + extra_cap + 63) / 64;
+  bitmap = (uint64_t *)realloc(bitmap, new_words * sizeof(uint64_t));
+  for (csi_id_t i = old_words; i < new_words; ++i)
+    bitmap[i] = 0;
+  for (csi_id_t id = table_cap; id < table_cap + extra_cap; ++id)
+    if (matches_suppression(get_loc(id), type))
+      bitmap[id / 64] |= (1UL << (id % 64));
+}
+
+void init_unit_suppressions(const csan_instrumentation_counts_t &counts) {
+  if (!suppressions_loaded)
+    load_suppressions();
+  if (!suppressions_active)
+    return;
+
+  grow_suppression_bitmap(call_suppressed, total_call, counts.num_call,
+                          __csan_get_call_source_loc, SRC_SUPP);
+  grow_suppression_bitmap(load_suppressed, total_load, counts.num_load,
+                          __csan_get_load_source_loc, SRC_SUPP);
+  grow_suppression_bitmap(store_suppressed, total_store, counts.num_store,
+                          __csan_get_store_source_loc, SRC_SUPP);
+  grow_suppression_bitmap(alloca_suppressed, total_alloca, counts.num_alloca,
+                          __csan_get_alloca_source_loc, ALLOC_SUPP);
+  grow_suppression_bitmap(allocfn_suppressed, total_allocfn,
+                          counts.num_allocfn, __csan_get_allocfn_source_loc,
+                          ALLOC_SUPP);
+}
+
+void free_suppressions() {
+  suppressions_active = false;
+  free(call_suppressed);
+  call_suppressed = nullptr;
+  free(load_suppressed);
+  load_suppressed = nullptr;
+  free(store_suppressed);
+  store_suppressed = nullptr;
+  free(alloca_suppressed);
+  alloca_suppressed = nullptr;
+  free(allocfn_suppressed);
+  allocfn_suppressed = nullptr;
+  suppressions.clear();
+}
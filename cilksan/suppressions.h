@@ -0,0 +1,50 @@
+// -*- C++ -*-
+#ifndef __SUPPRESSIONS_H__
+#define __SUPPRESSIONS_H__
+
+#include <csi/csi.h>
+#include <cstdint>
+
+#include "csan.h"
+
+// Support for suppressing checking and race reports at specific program
+// locations.  The suppression file, named by the CILKSAN_SUPPRESSIONS
+// environment variable, contains one suppression per line:
+//
+//   fun:<function>         Skip accesses and calls in matching functions.
+//   src:<file>[:<line>]    Skip accesses and calls at matching locations.
+//   alloc:<file>[:<line>]  Skip races on objects allocated at matching
+//                          locations.
+//
+// Function and file names are glob patterns, as accepted by fnmatch(3).  A
+// file pattern matches either the full path or the base name of a source file.
+// Blank lines and lines starting with '#' are ignored.
+//
+// Suppressions are compiled into bitmaps indexed by CSI ID as each unit is
+// initialized, so that the instrumentation hooks can test for a suppressed ID
+// with a single bit test.
+
+// Flag set if any suppressions have been loaded.
+extern bool suppressions_active;
+
+// Bitmaps of suppressed CSI IDs.  Defined in suppressions.cpp.
+extern uint64_t *load_suppressed;
+extern uint64_t *store_suppressed;
+extern uint64_t *call_suppressed;
+extern uint64_t *alloca_suppressed;
+extern uint64_t *allocfn_suppressed;
+
+__attribute__((always_inline)) static inline bool
+is_suppressed(const uint64_t *bitmap, csi_id_t id) {
+  return __builtin_expect(suppressions_active, false) &&
+         ((bitmap[id / 64] >> (id % 64)) & 1);
+}
+
+// Extend the suppression bitmaps to cover the CSI IDs of a newly initialized
+// unit.  Must be called before the totals for that unit are updated.
+void init_unit_suppressions(const csan_instrumentation_counts_t &counts);
+
+// Free the suppression bitmaps.
+void free_suppressions();
+
+#endif // __SUPPRESSIONS_H__
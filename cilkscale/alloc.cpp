@@ -0,0 +1,431 @@
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "serial_tool.h"
+#include <cilk/cilk_api.h>
+#include <csi/csi.h>
+
+#define CILKTOOL_API extern "C" __attribute__((visibility("default")))
+
+#ifndef TRACE_CALLS
+#define TRACE_CALLS 0
+#endif
+
+// Parallel memory-allocation profiler.
+//
+// The cilkscale-alloc tool records, for each allocation site, the number of
+// allocations and bytes allocated, how many of those allocations execute in a
+// parallel region -- i.e., inside a spawned task or in the continuation of a
+// spawn that has not yet been synced -- and how many of the allocated objects
+// are freed by a strand that is logically parallel to the strand that
+// allocated them.  Sites with many parallel allocations or parallel frees
+// contend on the shared allocator and are good candidates for per-worker
+// arenas.  At exit, the tool writes a report of the allocation sites as CSV to
+// the file named by CILKSCALE_ALLOC_OUT, or to stderr by default, with the best
+// candidates first.
+//
+// The tool runs the program serially and determines the logical parallelism
+// of strands from the spawns and syncs of the serial execution.
+
+///////////////////////////////////////////////////////////////////////////
+// Data structures for tracking the logical parallelism of strands.
+
+// A spawn on the path from the root of the computation to a task.  The spawns
+// enclosing a strand form a persistent list, deepest first, that allocations
+// share with the strand.
+struct spawn_edge_t {
+  // Depth on the frame stack of the frame that spawned the task.
+  int32_t depth;
+  // Sync region of the spawn in the spawning frame.
+  unsigned sync_reg;
+  // Instance IDs of the spawning frame and of the spawned task.
+  uint64_t parent_id;
+  uint64_t child_id;
+  // Time of the spawn, in serial events.
+  uint64_t spawn_time;
+  std::shared_ptr<const spawn_edge_t> next;
+};
+
+using spawn_edges_t = std::shared_ptr<const spawn_edge_t>;
+
+// Spawns and syncs of one sync region of a frame, in serial events.
+struct sync_region_t {
+  uint64_t last_spawn = 0;
+  uint64_t last_sync = 0;
+
+  bool pending() const { return last_spawn > last_sync; }
+};
+
+// A function or task frame that has started but not yet exited.
+struct alloc_frame_t {
+  // Unique ID of this instance of the frame.
+  uint64_t instance_id;
+  // Function ID of a function frame, or detach ID of a task frame.
+  csi_id_t id;
+  bool is_task;
+  // Sync regions of the frame, allocated on the first spawn.
+  std::vector<sync_region_t> sync_regions;
+  // Number of sync regions with spawned children that have not been synced.
+  unsigned num_pending = 0;
+};
+
+// Measurements of an allocation site.
+struct alloc_site_t {
+  // Name of the allocation function.
+  const char *allocfn = nullptr;
+  uint64_t count = 0;
+  uint64_t bytes = 0;
+  // Allocations executed in a parallel region.
+  uint64_t parallel_count = 0;
+  uint64_t parallel_bytes = 0;
+  // Frees of objects allocated at this site, and those frees that are
+  // logically parallel to the allocation.
+  uint64_t frees = 0;
+  uint64_t parallel_frees = 0;
+};
+
+// An object that has been allocated but not yet freed.
+struct live_alloc_t {
+  csi_id_t allocfn_id;
+  // Spawns enclosing the allocation.
+  spawn_edges_t edges;
+};
+
+// Top-level class to manage the state of the global tool.
+class AllocImpl_t {
+public:
+  std::vector<alloc_frame_t> frames;
+
+  // Spawns enclosing the current strand.
+  spawn_edges_t edges;
+
+  // Number of frames with spawned children that have not been synced.
+  uint64_t outstanding_frames = 0;
+
+  // Counter of serial events, used to order spawns and syncs.
+  uint64_t time = 0;
+  uint64_t next_instance_id = 0;
+
+  std::vector<alloc_site_t> sites;
+  std::unordered_map<uintptr_t, live_alloc_t> live;
+
+  alloc_site_t &site(csi_id_t allocfn_id) {
+    if (static_cast<size_t>(allocfn_id) >= sites.size())
+      sites.resize(allocfn_id + 1);
+    return sites[allocfn_id];
+  }
+
+  void push_frame(csi_id_t id, bool is_task) {
+    frames.push_back({next_instance_id++, id, is_task, {}, 0});
+  }
+
+  void pop_frame() {
+    alloc_frame_t &frame = frames.back();
+    // Returning from a frame syncs its outstanding children.
+    if (frame.num_pending)
+      --outstanding_frames;
+    if (frame.is_task)
+      edges = edges->next;
+    frames.pop_back();
+  }
+
+  sync_region_t &sync_region(alloc_frame_t &frame, unsigned sync_reg) {
+    if (sync_reg >= frame.sync_regions.size())
+      frame.sync_regions.resize(sync_reg + 1);
+    return frame.sync_regions[sync_reg];
+  }
+
+  // Returns true if the current strand is logically parallel to some other
+  // strand.
+  bool in_parallel_region() const { return edges || outstanding_frames; }
+
+  bool logically_parallel(const spawn_edges_t &alloc_edges) const;
+
+  void record_alloc(csi_id_t allocfn_id, const void *addr, size_t bytes,
+                    const allocfn_prop_t prop);
+  void record_free(const void *ptr);
+
+  void write_report(std::ostream &OS);
+
+  AllocImpl_t() {}
+  ~AllocImpl_t();
+};
+
+static AllocImpl_t *tool = create_serial_tool<AllocImpl_t>();
+
+bool ALLOC_INITIALIZED = false;
+
+// Returns true if the current strand is logically parallel to the strand
+// enclosed by the spawns alloc_edges, which executed earlier.
+//
+// The two strands are logically parallel if, for the deepest spawn enclosing
+// the earlier strand whose task has returned, the current strand executes in
+// the spawning frame before that frame syncs the spawn.  If the spawned task
+// is still on the stack, then the current strand is in the same task and
+// follows the earlier strand serially.  If the spawning frame has returned,
+// then it has synced the spawn, and the next enclosing spawn decides.
+bool AllocImpl_t::logically_parallel(const spawn_edges_t &alloc_edges) const {
+  int32_t num_frames = static_cast<int32_t>(frames.size());
+  for (const spawn_edge_t *edge = alloc_edges.get(); edge;
+       edge = edge->next.get()) {
+    if (edge->depth + 1 < num_frames &&
+        frames[edge->depth + 1].instance_id == edge->child_id)
+      return false;
+    if (edge->depth < num_frames &&
+        frames[edge->depth].instance_id == edge->parent_id) {
+      const alloc_frame_t &parent = frames[edge->depth];
+      assert(edge->sync_reg < parent.sync_regions.size());
+      return parent.sync_regions[edge->sync_reg].last_sync < edge->spawn_time;
+    }
+  }
+  return false;
+}
+
+void AllocImpl_t::record_alloc(csi_id_t allocfn_id, const void *addr,
+                               size_t bytes, const allocfn_prop_t prop) {
+  alloc_site_t &s = site(allocfn_id);
+  if (!s.allocfn)
+    s.allocfn = __csan_get_allocfn_str(prop);
+  ++s.count;
+  s.bytes += bytes;
+  if (in_parallel_region()) {
+    ++s.parallel_count;
+    s.parallel_bytes += bytes;
+  }
+  live[reinterpret_cast<uintptr_t>(addr)] = {allocfn_id, edges};
+}
+
+void AllocImpl_t::record_free(const void *ptr) {
+  auto it = live.find(reinterpret_cast<uintptr_t>(ptr));
+  // Ignore objects allocated by uninstrumented code.
+  if (it == live.end())
+    return;
+  alloc_site_t &s = site(it->second.allocfn_id);
+  ++s.frees;
+  if (logically_parallel(it->second.edges))
+    ++s.parallel_frees;
+  live.erase(it);
+}
+
+///////////////////////////////////////////////////////////////////////////
+// Report
+
+void AllocImpl_t::write_report(std::ostream &OS) {
+  std::vector<csi_id_t> ids;
+  for (size_t i = 0; i < sites.size(); ++i)
+    if (sites[i].count)
+      ids.push_back(static_cast<csi_id_t>(i));
+  // Rank sites by the number of allocator operations that may contend with
+  // other workers, breaking ties by the bytes allocated in parallel.
+  std::stable_sort(ids.begin(), ids.end(), [&](csi_id_t a, csi_id_t b) {
+    const alloc_site_t &sa = sites[a], &sb = sites[b];
+    uint64_t ca = sa.parallel_count + sa.parallel_frees;
+    uint64_t cb = sb.parallel_count + sb.parallel_frees;
+    if (ca != cb)
+      return ca > cb;
+    return sa.parallel_bytes > sb.parallel_bytes;
+  });
+
+  OS << "id,allocfn,name,file,line,column,count,bytes,parallel_count"
+     << ",parallel_bytes,frees,parallel_frees,arena_candidate\n";
+  for (csi_id_t id : ids) {
+    const alloc_site_t &s = sites[id];
+    const source_loc_t *loc = __csi_get_allocfn_source_loc(id);
+    OS << id << ",\"" << (s.allocfn ? s.allocfn : "") << "\",";
+    if (loc)
+      OS << (loc->name ? loc->name : "") << ","
+         << (loc->filename ? loc->filename : "") << "," << loc->line_number
+         << "," << loc->column_number;
+    else
+      OS << ",,,";
+    OS << "," << s.count << "," << s.bytes << "," << s.parallel_count << ","
+       << s.parallel_bytes << "," << s.frees << "," << s.parallel_frees << ","
+       << ((s.parallel_count || s.parallel_frees) ? "yes" : "no") << "\n";
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////
+// Tool startup and shutdown
+
+AllocImpl_t::~AllocImpl_t() {
+  // Write the report to the file named by CILKSCALE_ALLOC_OUT, or to stderr by
+  // default.
+  const char *out_file = getenv("CILKSCALE_ALLOC_OUT");
+  std::ofstream outf;
+  if (out_file) {
+    outf.open(out_file);
+    if (!outf.is_open())
+      fprintf(stderr, "Cilkscale: could not open allocation report file %s\n",
+              out_file);
+  }
+  if (outf.is_open())
+    write_report(outf);
+  else
+    write_report(std::cerr);
+}
+
+///////////////////////////////////////////////////////////////////////////
+// Hooks for operating the tool.
+
+CILKTOOL_API void __csi_init() {
+#if TRACE_CALLS
+  fprintf(stderr, "__csi_init()\n");
+#endif
+
+  start_serial_tool<AllocImpl_t, tool, ALLOC_INITIALIZED>();
+}
+
+CILKTOOL_API void __csi_unit_init(const char *const file_name,
+                                  const instrumentation_counts_t counts) {
+  return;
+}
+
+CILKTOOL_API
+void __csi_func_entry(const csi_id_t func_id, const func_prop_t prop) {
+  if (!ALLOC_INITIALIZED || !tool)
+    return;
+
+#if TRACE_CALLS
+  fprintf(stderr, "func_entry(%ld)\n", func_id);
+#endif
+
+  tool->push_frame(func_id, false);
+}
+
+CILKTOOL_API
+void __csi_func_exit(const csi_id_t func_exit_id, const csi_id_t func_id,
+                     const func_exit_prop_t prop) {
+  if (!ALLOC_INITIALIZED || !tool)
+    return;
+
+#if TRACE_CALLS
+  fprintf(stderr, "func_exit(%ld, %ld)\n", func_exit_id, func_id);
+#endif
+
+  // Pop any frames exited without their exit hooks, e.g., by an exception.
+  std::vector<alloc_frame_t> &frames = tool->frames;
+  while (!frames.empty() &&
+         (frames.back().is_task || frames.back().id != func_id))
+    tool->pop_frame();
+  if (!frames.empty())
+    tool->pop_frame();
+}
+
+CILKTOOL_API
+void __csi_detach(const csi_id_t detach_id, const unsigned sync_reg,
+                  const detach_prop_t prop) {
+  if (!ALLOC_INITIALIZED || !tool || tool->frames.empty())
+    return;
+
+#if TRACE_CALLS
+  fprintf(stderr, "detach(%ld, %u)\n", detach_id, sync_reg);
+#endif
+
+  alloc_frame_t &parent = tool->frames.back();
+  sync_region_t &region = tool->sync_region(parent, sync_reg);
+  if (!region.pending() && 0 == parent.num_pending++)
+    ++tool->outstanding_frames;
+  region.last_spawn = ++tool->time;
+
+  tool->edges = std::make_shared<const spawn_edge_t>(spawn_edge_t{
+      static_cast<int32_t>(tool->frames.size() - 1), sync_reg,
+      parent.instance_id, tool->next_instance_id, region.last_spawn,
+      std::move(tool->edges)});
+}
+
+CILKTOOL_API
+void __csi_task(const csi_id_t task_id, const csi_id_t detach_id,
+                const task_prop_t prop) {
+  if (!ALLOC_INITIALIZED || !tool || tool->frames.empty())
+    return;
+
+#if TRACE_CALLS
+  fprintf(stderr, "task(%ld, %ld)\n", task_id, detach_id);
+#endif
+
+  // The spawn edge pushed by the detach expects the task to get the next
+  // instance ID.
+  assert(tool->edges && tool->edges->child_id == tool->next_instance_id);
+  tool->push_frame(detach_id, true);
+}
+
+CILKTOOL_API
+void __csi_task_exit(const csi_id_t task_exit_id, const csi_id_t task_id,
+                     const csi_id_t detach_id, const unsigned sync_reg,
+                     const task_exit_prop_t prop) {
+  if (!ALLOC_INITIALIZED || !tool)
+    return;
+
+#if TRACE_CALLS
+  fprintf(stderr, "task_exit(%ld, %ld, %ld)\n", task_exit_id, task_id,
+          detach_id);
+#endif
+
+  // Pop any frames exited without their exit hooks, e.g., by an exception.
+  std::vector<alloc_frame_t> &frames = tool->frames;
+  while (!frames.empty() &&
+         (!frames.back().is_task || frames.back().id != detach_id))
+    tool->pop_frame();
+  if (!frames.empty())
+    tool->pop_frame();
+}
+
+CILKTOOL_API
+void __csi_after_sync(const csi_id_t sync_id, const unsigned sync_reg) {
+  if (!ALLOC_INITIALIZED || !tool || tool->frames.empty())
+    return;
+
+#if TRACE_CALLS
+  fprintf(stderr, "after_sync(%ld, %u)\n", sync_id, sync_reg);
+#endif
+
+  alloc_frame_t &frame = tool->frames.back();
+  if (sync_reg >= frame.sync_regions.size())
+    return;
+  sync_region_t &region = frame.sync_regions[sync_reg];
+  if (region.pending() && 0 == --frame.num_pending)
+    --tool->outstanding_frames;
+  region.last_sync = ++tool->time;
+}
+
+CILKTOOL_API
+void __csi_after_allocfn(const csi_id_t allocfn_id, const void *addr,
+                         size_t size, size_t num, size_t alignment,
+                         const void *oldaddr, const allocfn_prop_t prop) {
+  if (!ALLOC_INITIALIZED || !tool)
+    return;
+
+#if TRACE_CALLS
+  fprintf(stderr, "after_allocfn(%ld, %s, %p, %ld, %ld, %p)\n", allocfn_id,
+          __csan_get_allocfn_str(prop), addr, size, num, oldaddr);
+#endif
+
+  // A reallocation frees the old object.
+  if (oldaddr)
+    tool->record_free(oldaddr);
+  if (addr)
+    tool->record_alloc(allocfn_id, addr, size * (num ? num : 1), prop);
+}
+
+CILKTOOL_API
+void __csi_after_free(const csi_id_t free_id, const void *ptr,
+                      const free_prop_t prop) {
+  if (!ALLOC_INITIALIZED || !tool || !ptr)
+    return;
+
+#if TRACE_CALLS
+  fprintf(stderr, "after_free(%ld, %s, %p)\n", free_id,
+          __csan_get_free_str(prop), ptr);
+#endif
+
+  tool->record_free(ptr);
+}
@@ -0,0 +1,37 @@
+// Workload for measuring the overhead of Cilkscale instrumentation.  It
+// combines fine-grained spawning, which exercises the function, detach, and
+// sync hooks, with serial loops over many small basic blocks, which exercise
+// the basic-block hooks.  See hook_overhead.sh.
+
+#include <cilk/cilk.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Serial leaf computation with data-dependent branches.
+__attribute__((noinline)) static unsigned long collatz_steps(unsigned long n) {
+  unsigned long steps = 0;
+  while (n > 1) {
+    if (n & 1)
+      n = 3 * n + 1;
+    else
+      n /= 2;
+    ++steps;
+  }
+  return steps;
+}
+
+static unsigned long fib(int n) {
+  if (n < 2)
+    return collatz_steps(n + 27);
+  unsigned long x, y;
+  x = cilk_spawn fib(n - 1);
+  y = fib(n - 2);
+  cilk_sync;
+  return x + y;
+}
+
+int main(int argc, char *argv[]) {
+  int n = (argc > 1) ? atoi(argv[1]) : 27;
+  printf("%lu\n", fib(n));
+  return 0;
+}
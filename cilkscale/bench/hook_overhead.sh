@@ -0,0 +1,57 @@
+#!/bin/sh
+# Measure the overhead of Cilkscale instrumentation on a small workload, by
+# comparing the running time of the uninstrumented workload against the same
+# workload compiled with each Cilkscale tool.
+#
+# Usage: hook_overhead.sh [tool ...]
+#
+# Each tool is passed to -fcilktool.  By default, the shipped Cilkscale tools
+# are compared: cilkscale, which uses the default timer, and
+# cilkscale-instructions.  To measure other timers, such as CLOCK or RDTSC,
+# build a Cilkscale runtime with -DCSCALETIMER=<timer> and pass its tool name.
+#
+# Environment variables:
+#   CC      OpenCilk compiler to use (default: clang)
+#   CFLAGS  additional compiler flags (default: -O3)
+#   N       argument to the workload (default: 27)
+#   TRIALS  number of runs per configuration; the minimum is reported
+#           (default: 5)
+
+set -e
+
+CC=${CC:-clang}
+CFLAGS=${CFLAGS:--O3}
+N=${N:-27}
+TRIALS=${TRIALS:-5}
+SRC=$(dirname "$0")/hook_overhead.c
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+if [ $# -eq 0 ]; then
+  set -- cilkscale cilkscale-instructions
+fi
+
+# Print the minimum wall-clock time, in seconds, of TRIALS runs of a binary.
+min_time() {
+  best=
+  i=0
+  while [ $i -lt "$TRIALS" ]; do
+    start=$(date +%s.%N)
+    CILKSCALE_OUT=/dev/null "$1" "$N" > /dev/null
+    end=$(date +%s.%N)
+    best=$(echo "$start $end $best" | awk '{ t = $2 - $1; if ($3 == "" || t < $3) print t; else print $3 }')
+    i=$((i + 1))
+  done
+  echo "$best"
+}
+
+$CC $CFLAGS -fopencilk "$SRC" -o "$TMP/base"
+base=$(min_time "$TMP/base")
+
+echo "tool,time (seconds),slowdown"
+echo "none,$base,1.00"
+for tool in "$@"; do
+  $CC $CFLAGS -fopencilk -fcilktool="$tool" "$SRC" -o "$TMP/$tool"
+  t=$(min_time "$TMP/$tool")
+  echo "$tool,$t,$(echo "$t $base" | awk '{ printf "%.2f", $1 / $2 }')"
+done
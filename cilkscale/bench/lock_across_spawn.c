@@ -0,0 +1,37 @@
+// Workload for checking that cilkscale-locks accounts for a lock that is held
+// across a spawn.  Each round acquires a lock, spawns a child, and releases the
+// lock in the continuation, which runs on a different worker if the
+// continuation is stolen.  Every round must be counted as one acquisition of
+// the lock.  See lock_across_spawn.sh.
+//
+// The lock is a default pthread mutex, which glibc lets a thread other than
+// its owner unlock.
+
+#include <cilk/cilk.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static volatile unsigned long sink;
+
+// Serial work that keeps the child busy long enough for the continuation to be
+// stolen.
+__attribute__((noinline)) static void busy(unsigned long n) {
+  unsigned long x = 0;
+  for (unsigned long i = 0; i < n; ++i)
+    x += i * i;
+  sink = x;
+}
+
+int main(int argc, char *argv[]) {
+  int rounds = (argc > 1) ? atoi(argv[1]) : 1000;
+  for (int i = 0; i < rounds; ++i) {
+    pthread_mutex_lock(&lock);
+    cilk_spawn busy(100000);
+    pthread_mutex_unlock(&lock);
+    cilk_sync;
+  }
+  printf("%d\n", rounds);
+  return 0;
+}
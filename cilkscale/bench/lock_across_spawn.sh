@@ -0,0 +1,35 @@
+#!/bin/sh
+# Check that cilkscale-locks counts every acquisition of a lock that is held
+# across a spawn and released in a stolen continuation, on a different worker
+# than the one that acquired it.
+#
+# Usage: lock_across_spawn.sh
+#
+# Environment variables:
+#   CC             OpenCilk compiler to use (default: clang)
+#   CFLAGS         additional compiler flags (default: -O1)
+#   ROUNDS         number of times the lock is acquired (default: 1000)
+#   CILK_NWORKERS  number of Cilk workers (default: 4)
+
+set -e
+
+CC=${CC:-clang}
+CFLAGS=${CFLAGS:--O1}
+ROUNDS=${ROUNDS:-1000}
+CILK_NWORKERS=${CILK_NWORKERS:-4}
+export CILK_NWORKERS
+SRC=$(dirname "$0")/lock_across_spawn.c
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+$CC $CFLAGS -fopencilk -fcilktool=cilkscale-locks "$SRC" -o "$TMP/locks"
+CILKSCALE_OUT=/dev/null CILKSCALE_LOCKS_OUT="$TMP/locks.csv" \
+  "$TMP/locks" "$ROUNDS" > /dev/null
+
+# The first row after the header of the lock report describes the only lock.
+acquisitions=$(awk -F, '/^lock,/ { getline; print $2; exit }' "$TMP/locks.csv")
+if [ "$acquisitions" != "$ROUNDS" ]; then
+  echo "FAIL: $acquisitions acquisitions of the lock counted, expected $ROUNDS"
+  exit 1
+fi
+echo "PASS: $ROUNDS acquisitions counted"
@@ -0,0 +1,96 @@
+// Microbenchmark of the per-hook cost of the Cilkscale timers.
+//
+// Every Cilkscale hook that ends a strand reads the timer, computes the
+// elapsed time of the strand, and adds it to the work, span, and burdened span
+// of the current frame.  This benchmark runs that sequence in a tight loop for
+// the timer selected by CSCALETIMER and reports the average cost per hook.
+// Build and run it once per timer mode, e.g., for each timer mode t in CLOCK,
+// RDTSC, TSC, and PERF:
+//
+//   c++ -O2 -std=c++17 -DCSCALETIMER=$t -I<cilktools>/include
+//       -I<cilktools>/cilkscale timer_overhead.cpp -o timer_overhead-$t
+//   ./timer_overhead-$t
+
+#include <cstdio>
+#include <cstdlib>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "cilkscale_timer.h"
+
+#define STRINGIFY_(x) #x
+#define STRINGIFY(x) STRINGIFY_(x)
+
+static const char *timer_name() {
+#if CSCALETIMER == RDTSC
+  return "RDTSC";
+#elif CSCALETIMER == CLOCK
+  return "CLOCK";
+#elif CSCALETIMER == INST
+  return "INST";
+#elif CSCALETIMER == TSC
+  return tsc_clock_t::use_tsc ? "TSC" : "TSC (CLOCK_MONOTONIC fallback)";
+#elif CSCALETIMER == PERF
+  return perf_counter_t::event->name;
+#else
+  return STRINGIFY(CSCALETIMER);
+#endif
+}
+
+// Simulate a hook that ends a strand, using the same sequence of operations as
+// the Cilkscale hooks.
+__attribute__((noinline)) static void
+hook(cilkscale_timer_t &start, cilkscale_timer_t &stop, cilk_time_t &work,
+     cilk_time_t &span, cilk_time_t &bspan) {
+  stop.gettime();
+  duration_t strand_time = elapsed_time(&stop, &start);
+  work += strand_time;
+  span += strand_time;
+  bspan += strand_time;
+  start = stop;
+}
+
+// Simulate a hook that performs no timing.
+__attribute__((noinline)) static void
+empty_hook(cilkscale_timer_t &start, cilkscale_timer_t &stop, cilk_time_t &work,
+           cilk_time_t &span, cilk_time_t &bspan) {
+  asm volatile("" : : "r"(&start), "r"(&stop), "r"(&work), "r"(&span),
+               "r"(&bspan) : "memory");
+}
+
+template <typename HookT>
+static double ns_per_call(HookT hook_fn, long iters) {
+  cilkscale_timer_t start, stop;
+  cilk_time_t work = cilk_time_t::zero();
+  cilk_time_t span = cilk_time_t::zero();
+  cilk_time_t bspan = cilk_time_t::zero();
+  start.gettime();
+
+  struct timespec t0, t1;
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  for (long i = 0; i < iters; ++i)
+    hook_fn(start, stop, work, span, bspan);
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+
+  return ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / iters;
+}
+
+int main(int argc, char *argv[]) {
+  long iters = (argc > 1) ? atol(argv[1]) : 10000000;
+  if (iters <= 0) {
+    fprintf(stderr, "Usage: %s [iterations]\n", argv[0]);
+    return 1;
+  }
+
+  cilkscale_timer_t::init();
+
+  // Warm up.
+  ns_per_call(hook, iters / 10 + 1);
+
+  double baseline = ns_per_call(empty_hook, iters);
+  double total = ns_per_call(hook, iters);
+  printf("timer,iterations,ns per hook,ns per hook (excluding call)\n");
+  printf("%s,%ld,%.2f,%.2f\n", timer_name(), iters, total, total - baseline);
+  return 0;
+}
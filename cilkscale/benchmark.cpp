@@ -1,8 +1,11 @@
+#include <algorithm>
 #include <cassert>
 #include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <string>
+#include <vector>
 
 // Ensure that __cilkscale__ is defined, so we can provide a nontrivial
 // definition of getworkspan().
@@ -10,6 +13,7 @@
 #define __cilkscale__
 #endif
 
+#include "binary_sink.h"
 #include "cilkscale_timer.h"
 #include <csi/csi.h>
 #include <iostream>
@@ -26,6 +30,7 @@
 #endif
 
 #include <cilk/cilk_api.h>
+extern "C" void __cilkrts_internal_set_nworkers(unsigned int nworkers);
 #if !SERIAL_TOOL
 #include <cilk/ostream_reducer.h>
 using out_reducer = cilk::ostream_reducer<char>;
@@ -79,6 +84,14 @@ public:
 #if !SERIAL_TOOL
   out_reducer *outf_red = nullptr;
 #endif
+  // Binary sink for results, used instead of the output stream if enabled.
+  binary_sink_t *binary_out = nullptr;
+
+  // Worker counts at which wsp_sweep re-executes its body, and the number of
+  // untimed and timed executions at each worker count.
+  std::vector<unsigned> sweep_workers;
+  unsigned sweep_warmup = 1;
+  unsigned sweep_reps = 3;
 
   std::basic_ostream<char> *out_view() {
 #if !SERIAL_TOOL
@@ -141,22 +154,77 @@ static void print_results(Out &OS, const char *tag, cilk_time_t time) {
 static void print_analysis(void) {
   assert(TOOL_INITIALIZED);
 
+  cilk_time_t time = elapsed_time(&tool->stop, &tool->start);
+  if (tool->binary_out) {
+    tool->binary_out->write("", time.get_raw_duration());
+    return;
+  }
+
   std::basic_ostream<char> &output = *tool->out_view();
   ensure_header(output);
-  print_results(output, "", elapsed_time(&tool->stop, &tool->start));
+  print_results(output, "", time);
 }
 
 ///////////////////////////////////////////////////////////////////////////
 // Startup and shutdown the tool
 
+// Parse a comma-separated list of positive worker counts.
+static std::vector<unsigned> parse_worker_counts(const char *str) {
+  std::vector<unsigned> counts;
+  while (*str) {
+    char *end;
+    unsigned long count = strtoul(str, &end, 10);
+    if (end == str || count == 0 || (*end && *end != ',')) {
+      fprintf(stderr, "Cilkscale: invalid CILKSCALE_SWEEP %s\n", str);
+      return {};
+    }
+    counts.push_back(static_cast<unsigned>(count));
+    str = *end ? end + 1 : end;
+  }
+  return counts;
+}
+
+static unsigned parse_count(const char *envname, unsigned dflt) {
+  const char *envstr = getenv(envname);
+  if (!envstr)
+    return dflt;
+  char *end;
+  unsigned long count = strtoul(envstr, &end, 10);
+  if (end == envstr || *end) {
+    fprintf(stderr, "Cilkscale: invalid %s %s\n", envname, envstr);
+    return dflt;
+  }
+  return static_cast<unsigned>(count);
+}
+
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wdeprecated-declarations"
 
 BenchmarkImpl_t::BenchmarkImpl_t() {
+  cilkscale_timer_t::init();
+
   const char *envstr = getenv("CILKSCALE_OUT");
   if (envstr)
     outf.open(envstr);
 
+  // Record results in binary form if a binary output file is specified.
+  if (const char *binstr = getenv("CILKSCALE_OUT_BINARY")) {
+    binary_out = new binary_sink_t();
+    if (!binary_out->open(
+            binstr, 1, cilk_time_t::units,
+            cilk_time_t(static_cast<raw_duration_t>(1)).get_scaled_val())) {
+      fprintf(stderr, "Cilkscale: could not open binary output file %s\n",
+              binstr);
+      delete binary_out;
+      binary_out = nullptr;
+    }
+  }
+
+  if (const char *sweepstr = getenv("CILKSCALE_SWEEP"))
+    sweep_workers = parse_worker_counts(sweepstr);
+  sweep_warmup = parse_count("CILKSCALE_SWEEP_WARMUP", sweep_warmup);
+  sweep_reps = std::max(1U, parse_count("CILKSCALE_SWEEP_REPS", sweep_reps));
+
 #if !SERIAL_TOOL
   __cilkrts_reducer_register
     (&timer, sizeof timer, timer_identity, timer_reduce);
@@ -178,6 +246,12 @@ BenchmarkImpl_t::~BenchmarkImpl_t() {
   if (outf.is_open())
     outf.close();
 
+  if (binary_out) {
+    binary_out->close();
+    delete binary_out;
+    binary_out = nullptr;
+  }
+
 #if !SERIAL_TOOL
   __cilkrts_reducer_unregister(outf_red);
   delete outf_red;
@@ -273,7 +347,53 @@ CILKTOOL_API wsp_t wsp_sub(wsp_t lhs, wsp_t rhs) CILKSCALE_NOTHROW {
 }
 
 CILKTOOL_API void wsp_dump(wsp_t wsp, const char *tag) {
+  if (tool->binary_out) {
+    tool->binary_out->write(tag, wsp.work);
+    return;
+  }
   std::basic_ostream<char> &output = *tool->out_view();
   ensure_header(output);
   print_results(output, tag, cilk_time_t(wsp.work));
 }
+
+// Time one execution of body(arg).
+static duration_t time_body(void (*body)(void *), void *arg) {
+  cilkscale_timer_t start, stop;
+  start.gettime();
+  body(arg);
+  stop.gettime();
+  return elapsed_time(&stop, &start);
+}
+
+CILKTOOL_API void wsp_sweep(const char *tag, void (*body)(void *), void *arg) {
+  if (tool->sweep_workers.empty()) {
+    wsp_t time = {cilk_time_t(time_body(body, arg)).get_raw_duration(), 0, 0};
+    wsp_dump(time, tag);
+    return;
+  }
+
+  unsigned original_nworkers = __cilkrts_get_nworkers();
+  std::vector<duration_t> times;
+  for (unsigned nworkers : tool->sweep_workers) {
+    __cilkrts_internal_set_nworkers(nworkers);
+    for (unsigned i = 0; i < tool->sweep_warmup; ++i)
+      body(arg);
+
+    times.clear();
+    for (unsigned i = 0; i < tool->sweep_reps; ++i)
+      times.push_back(time_body(body, arg));
+    std::nth_element(times.begin(), times.begin() + times.size() / 2,
+                     times.end());
+
+    wsp_t time = {cilk_time_t(times[times.size() / 2]).get_raw_duration(), 0,
+                  0};
+    std::string sweep_tag = std::string(tag) + "@" + std::to_string(nworkers);
+    wsp_dump(time, sweep_tag.c_str());
+  }
+  __cilkrts_internal_set_nworkers(original_nworkers);
+}
+
+// cilkscale-benchmark does not measure regions.
+CILKTOOL_API void wsp_region_begin(const char *name) CILKSCALE_NOTHROW {}
+
+CILKTOOL_API void wsp_region_end(void) CILKSCALE_NOTHROW {}
@@ -0,0 +1,184 @@
+// -*- C++ -*-
+#ifndef INCLUDED_BINARY_SINK_H
+#define INCLUDED_BINARY_SINK_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Binary sink for results, used instead of formatted output when the
+// CILKSCALE_OUT_BINARY environment variable names a file.  Each thread appends
+// fixed-size records to its own pre-allocated buffer, and buffers are written
+// to the file only when they fill up or at exit, so recording a result costs
+// no formatting and no I/O.  Cilkscale_vis/decode.py converts the file into
+// the usual CSV output.
+//
+// File format, in native byte order:
+//
+//   header: char magic[8] = "CSCLBIN1"
+//           uint32_t num_values     number of values per record
+//           uint32_t units_len
+//           char units[units_len]
+//           double scale            value printed for a raw value of 1
+//   chunks: uint32_t num_tags
+//           { uint32_t len; char tag[len]; } tags[num_tags]
+//           uint64_t num_records
+//           record_t records[num_records]
+//
+// The tag of each record indexes the tags of its chunk.  Records carry a
+// sequence number that orders them by the time they were recorded.
+class binary_sink_t {
+public:
+  static constexpr unsigned MAX_VALUES = 3;
+
+  struct record_t {
+    uint64_t seq;
+    uint32_t tag;
+    uint32_t padding;
+    int64_t values[MAX_VALUES];
+  };
+
+private:
+  // Number of records in each thread's buffer.
+  static constexpr size_t BUFFER_RECORDS = 1 << 14;
+
+  struct buffer_t {
+    record_t *records;
+    size_t num_records = 0;
+    // Tags of the records in the buffer.  A deque keeps the tags at stable
+    // addresses, so that the index can refer to them.
+    std::deque<std::string> tags;
+    std::unordered_map<std::string_view, uint32_t> tag_index;
+
+    buffer_t() : records(new record_t[BUFFER_RECORDS]) {}
+    ~buffer_t() { delete[] records; }
+
+    uint32_t get_tag(const char *tag) {
+      auto found = tag_index.find(tag);
+      if (__builtin_expect(found != tag_index.end(), true))
+        return found->second;
+      uint32_t index = static_cast<uint32_t>(tags.size());
+      tags.emplace_back(tag);
+      tag_index.emplace(tags.back(), index);
+      return index;
+    }
+  };
+
+  FILE *out = nullptr;
+  unsigned num_values = 0;
+  std::atomic<uint64_t> next_seq{0};
+
+  // Per-thread buffers, registered in buffers when first used.  The lock
+  // protects buffers and serializes writes to the file.
+  std::mutex lock;
+  std::vector<buffer_t *> buffers;
+
+  // Each thread caches the buffer it last used, tagged with the ID of the sink
+  // that owns it.  Every sink gets a fresh ID when it is created and again when
+  // it is closed, so a thread never reuses a buffer of another sink or one that
+  // close() deleted.
+  static inline std::atomic<uint64_t> next_id{1};
+  uint64_t id = next_id.fetch_add(1, std::memory_order_relaxed);
+
+  buffer_t &buffer() {
+    struct cached_buffer_t {
+      uint64_t id = 0;
+      buffer_t *buf = nullptr;
+    };
+    static thread_local cached_buffer_t cached;
+    if (__builtin_expect(cached.id != id, false)) {
+      buffer_t *buf = new buffer_t();
+      {
+        std::lock_guard<std::mutex> guard(lock);
+        buffers.push_back(buf);
+      }
+      cached.id = id;
+      cached.buf = buf;
+    }
+    return *cached.buf;
+  }
+
+  // Write the contents of buf to the file as a chunk, and empty buf.  Must be
+  // called with lock held.
+  void write_chunk(buffer_t &buf) {
+    if (!buf.num_records)
+      return;
+    uint32_t num_tags = static_cast<uint32_t>(buf.tags.size());
+    fwrite(&num_tags, sizeof(num_tags), 1, out);
+    for (const std::string &tag : buf.tags) {
+      uint32_t len = static_cast<uint32_t>(tag.size());
+      fwrite(&len, sizeof(len), 1, out);
+      fwrite(tag.data(), 1, len, out);
+    }
+    uint64_t num_records = buf.num_records;
+    fwrite(&num_records, sizeof(num_records), 1, out);
+    fwrite(buf.records, sizeof(record_t), buf.num_records, out);
+
+    buf.num_records = 0;
+    buf.tag_index.clear();
+    buf.tags.clear();
+  }
+
+public:
+  ~binary_sink_t() { close(); }
+
+  // Open the file at path for records of num_values values each.  Returns
+  // false if the file cannot be opened.
+  bool open(const char *path, unsigned num_values, const char *units,
+            double scale) {
+    out = fopen(path, "wb");
+    if (!out)
+      return false;
+    this->num_values = num_values;
+    uint32_t units_len = static_cast<uint32_t>(strlen(units));
+    fwrite("CSCLBIN1", 1, 8, out);
+    fwrite(&num_values, sizeof(uint32_t), 1, out);
+    fwrite(&units_len, sizeof(units_len), 1, out);
+    fwrite(units, 1, units_len, out);
+    fwrite(&scale, sizeof(scale), 1, out);
+    return true;
+  }
+
+  bool is_open() const { return out != nullptr; }
+
+  void write(const char *tag, int64_t v0, int64_t v1 = 0, int64_t v2 = 0) {
+    if (!out)
+      return;
+    buffer_t &buf = buffer();
+    record_t &rec = buf.records[buf.num_records++];
+    rec.seq = next_seq.fetch_add(1, std::memory_order_relaxed);
+    rec.tag = buf.get_tag(tag);
+    rec.padding = 0;
+    rec.values[0] = v0;
+    rec.values[1] = v1;
+    rec.values[2] = v2;
+    if (__builtin_expect(BUFFER_RECORDS == buf.num_records, false)) {
+      std::lock_guard<std::mutex> guard(lock);
+      write_chunk(buf);
+    }
+  }
+
+  // Flush all buffers and close the file.
+  void close() {
+    if (!out)
+      return;
+    std::lock_guard<std::mutex> guard(lock);
+    for (buffer_t *buf : buffers) {
+      write_chunk(*buf);
+      delete buf;
+    }
+    buffers.clear();
+    id = next_id.fetch_add(1, std::memory_order_relaxed);
+    fclose(out);
+    out = nullptr;
+  }
+};
+
+#endif // INCLUDED_BINARY_SINK_H
@@ -0,0 +1,260 @@
+// -*- C++ -*-
+#ifndef INCLUDED_BURDEN_CALIBRATION_H
+#define INCLUDED_BURDEN_CALIBRATION_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "cilkscale_timer.h"
+
+#ifndef SERIAL_TOOL
+#define SERIAL_TOOL 1
+#endif
+
+#if !SERIAL_TOOL
+#include <cilk/cilk.h>
+#include <cilk/cilk_api.h>
+#endif
+
+// Host-specific calibration of cilkscale_timer_t::burden, the cost charged to
+// the burdened span for each continuation that might be stolen.
+//
+// When CILKSCALE_CALIBRATE is set, Cilkscale looks up the burden for this host
+// in a cache file, which is named by CILKSCALE_BURDEN_CACHE and defaults to
+// ~/.cilkscale_burden.  If no cached value exists, or if CILKSCALE_CALIBRATE is
+// "force", Cilkscale measures the burden with a steal microbenchmark before
+// the first spawning function runs, and saves the result in the cache file.
+//
+// Each line of the cache file has the form "<host> <units> <burden>".  The
+// burden is stored in nanoseconds for timers that measure time, and in raw
+// timer units otherwise.
+
+#if CSCALETIMER == CLOCK || CSCALETIMER == TSC
+static const char *const burden_units = "ns";
+#elif CSCALETIMER == RDTSC
+static const char *const burden_units = "cycles";
+#elif CSCALETIMER == PERF
+static const char *const burden_units = "events";
+#else // CSCALETIMER == INST
+static const char *const burden_units = "instructions";
+#endif // CSCALETIMER
+
+static double burden_to_cache_units(duration_t burden) {
+#if CSCALETIMER == CLOCK
+  return static_cast<double>(burden.count());
+#elif CSCALETIMER == TSC
+  return burden * tsc_clock_t::ns_per_tick;
+#else // CSCALETIMER == RDTSC || CSCALETIMER == INST || CSCALETIMER == PERF
+  return static_cast<double>(burden);
+#endif // CSCALETIMER
+}
+
+static duration_t burden_from_cache_units(double value) {
+#if CSCALETIMER == CLOCK
+  return duration_t(static_cast<int64_t>(value));
+#elif CSCALETIMER == TSC
+  return static_cast<duration_t>(value / tsc_clock_t::ns_per_tick);
+#else // CSCALETIMER == RDTSC || CSCALETIMER == INST || CSCALETIMER == PERF
+  return static_cast<duration_t>(value);
+#endif // CSCALETIMER
+}
+
+static std::string burden_cache_path() {
+  if (const char *path = getenv("CILKSCALE_BURDEN_CACHE"))
+    return path;
+  if (const char *home = getenv("HOME"))
+    return std::string(home) + "/.cilkscale_burden";
+  return "";
+}
+
+static std::string burden_cache_host() {
+  char host[256] = "unknown";
+  gethostname(host, sizeof(host) - 1);
+  host[sizeof(host) - 1] = '\0';
+  return host;
+}
+
+// Look up the cached burden for this host.  Returns true if a cached value was
+// found.
+static bool read_cached_burden(duration_t &burden) {
+  std::string path = burden_cache_path();
+  if (path.empty())
+    return false;
+  std::ifstream cache(path);
+  if (!cache.is_open())
+    return false;
+
+  std::string host = burden_cache_host();
+  std::string line;
+  while (std::getline(cache, line)) {
+    std::istringstream fields(line);
+    std::string line_host, line_units;
+    double value;
+    if (!(fields >> line_host >> line_units >> value))
+      continue;
+    if (line_host == host && line_units == burden_units && value > 0) {
+      burden = burden_from_cache_units(value);
+      return true;
+    }
+  }
+  return false;
+}
+
+// Save the burden for this host in the cache, replacing any previous value.
+static void write_cached_burden(duration_t burden) {
+  std::string path = burden_cache_path();
+  if (path.empty())
+    return;
+
+  std::string host = burden_cache_host();
+  std::vector<std::string> lines;
+  {
+    std::ifstream cache(path);
+    std::string line;
+    while (std::getline(cache, line)) {
+      std::istringstream fields(line);
+      std::string line_host, line_units;
+      if ((fields >> line_host >> line_units) && line_host == host &&
+          line_units == burden_units)
+        continue;
+      lines.push_back(line);
+    }
+  }
+
+  std::ofstream cache(path, std::ios::trunc);
+  if (!cache.is_open()) {
+    fprintf(stderr, "Cilkscale: could not write burden cache %s\n",
+            path.c_str());
+    return;
+  }
+  for (const std::string &line : lines)
+    cache << line << "\n";
+  cache << host << " " << burden_units << " " << burden_to_cache_units(burden)
+        << "\n";
+}
+
+#if !SERIAL_TOOL
+// Number of steal trials to run, and the minimum number of those trials that
+// must result in a steal for the calibration to succeed.
+static constexpr int BURDEN_TRIALS = 201;
+static constexpr int BURDEN_MIN_STEALS = 21;
+// Size of the data the continuation of each trial reads after it is stolen,
+// to account for migrating the working set of the continuation to the thief.
+static constexpr size_t BURDEN_WORKING_SET = 32 * 1024;
+// Maximum time to wait for the continuation of a trial to be stolen.
+static constexpr std::chrono::milliseconds BURDEN_STEAL_TIMEOUT(10);
+
+// Spawned child of a calibration trial.  It keeps its worker busy until the
+// continuation of its spawn is resumed, or until the timeout expires.
+__attribute__((noinline)) static void
+wait_for_thief(const std::atomic<bool> &resumed) {
+  auto deadline = std::chrono::steady_clock::now() + BURDEN_STEAL_TIMEOUT;
+  while (!resumed.load(std::memory_order_acquire))
+    if (std::chrono::steady_clock::now() > deadline)
+      break;
+}
+
+__attribute__((noinline)) static long touch_working_set(const char *data,
+                                                        size_t size) {
+  long sum = 0;
+  for (size_t i = 0; i < size; i += 64)
+    sum += data[i];
+  return sum;
+}
+
+// Run one calibration trial.  Returns true if the continuation of the spawn
+// was stolen, in which case latency is the time from the spawn until the thief
+// resumed the continuation and read its working set.
+__attribute__((noinline)) static bool steal_trial(char *data,
+                                                  duration_t &latency) {
+  std::atomic<bool> resumed(false);
+  unsigned victim = __cilkrts_get_worker_number();
+  cilkscale_timer_t spawn_time, resume_time;
+
+  // Write the working set, so that it is in the cache of the victim.
+  for (size_t i = 0; i < BURDEN_WORKING_SET; i += 64)
+    ++data[i];
+
+  spawn_time.gettime();
+  cilk_spawn wait_for_thief(resumed);
+  volatile long sum = touch_working_set(data, BURDEN_WORKING_SET);
+  (void)sum;
+  resume_time.gettime();
+  bool stolen = (__cilkrts_get_worker_number() != victim);
+  resumed.store(true, std::memory_order_release);
+  cilk_sync;
+
+  latency = elapsed_time(&resume_time, &spawn_time);
+  return stolen;
+}
+
+// Measure the burden as the median latency of a steal, including the cost of
+// migrating a small working set.  Returns true if the measurement succeeded.
+static bool measure_burden(duration_t &burden) {
+  if (__cilkrts_get_nworkers() < 2)
+    return false;
+
+  std::vector<char> data(BURDEN_WORKING_SET);
+  // Time to read the working set without a steal, which is subtracted from
+  // each measured latency.
+  cilkscale_timer_t start, stop;
+  touch_working_set(data.data(), BURDEN_WORKING_SET);
+  start.gettime();
+  touch_working_set(data.data(), BURDEN_WORKING_SET);
+  stop.gettime();
+  duration_t local_time = elapsed_time(&stop, &start);
+
+  std::vector<duration_t> samples;
+  for (int i = 0; i < BURDEN_TRIALS; ++i) {
+    duration_t latency;
+    if (steal_trial(data.data(), latency) && latency > local_time)
+      samples.push_back(latency - local_time);
+  }
+  if (samples.size() < static_cast<size_t>(BURDEN_MIN_STEALS))
+    return false;
+
+  std::nth_element(samples.begin(), samples.begin() + samples.size() / 2,
+                   samples.end());
+  burden = samples[samples.size() / 2];
+  return true;
+}
+#endif // !SERIAL_TOOL
+
+// Parse CILKSCALE_CALIBRATE.  Returns true if calibration is requested, and
+// sets force if cached values should be ignored.
+static bool burden_calibration_requested(bool &force) {
+  const char *envstr = getenv("CILKSCALE_CALIBRATE");
+  force = false;
+  if (!envstr || !*envstr || 0 == strcmp(envstr, "0"))
+    return false;
+  force = (0 == strcmp(envstr, "force"));
+  return true;
+}
+
+// Run the steal microbenchmark and update cilkscale_timer_t::burden with the
+// result, saving it in the cache.
+static void run_burden_calibration() {
+#if !SERIAL_TOOL && CSCALETIMER != INST && CSCALETIMER != PERF
+  duration_t burden;
+  if (measure_burden(burden)) {
+    cilkscale_timer_t::burden = burden;
+    write_cached_burden(burden);
+    return;
+  }
+#endif
+  fprintf(stderr,
+          "Cilkscale: burden calibration failed; using the default burden.\n"
+          "Calibration requires at least 2 workers and a timer that measures "
+          "time.\n");
+}
+
+#endif // INCLUDED_BURDEN_CALIBRATION_H
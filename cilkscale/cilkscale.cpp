@@ -1,3 +1,4 @@
+#include <atomic>
 #include <cassert>
 #include <cstdint>
 #include <cstdio>
@@ -12,6 +13,9 @@
 #define __cilkscale__
 #endif
 
+#include "binary_sink.h"
+#include "burden_calibration.h"
+#include "profile.h"
 #include "shadow_stack.h"
 #include <cilk/cilk_api.h>
 #include <csi/csi.h>
@@ -28,6 +32,20 @@
 #define TRACE_CALLS 0
 #endif
 
+// The cilkscale-locks tool interposes the mutex functions to analyze lock
+// contention.
+#ifndef LOCK_HOOKS
+#define LOCK_HOOKS 0
+#endif
+
+#if LOCK_HOOKS
+#include <dlfcn.h>
+#include <pthread.h>
+#ifndef __STDC_NO_THREADS__
+#include <threads.h>
+#endif // __STDC_NO_THREADS__
+#endif // LOCK_HOOKS
+
 #if SERIAL_TOOL
 FILE *err_io = stderr;
 #else
@@ -64,6 +82,22 @@ public:
 #if !SERIAL_TOOL
   out_reducer *outf_red = nullptr;
 #endif
+  // Binary sink for results, used instead of the output stream if enabled.
+  binary_sink_t *binary_out = nullptr;
+
+  // Per-ID work-span profile, if profiling is enabled.
+  profile_t *profile = nullptr;
+
+  // Aggregated measurements of named regions.
+  region_table_t *regions = nullptr;
+
+  // Lock-contention statistics, if lock contention is analyzed.
+  lock_table_t *locks = nullptr;
+
+  // Set if the burden must be calibrated before the first spawning function
+  // runs.  Workers may enter spawning functions concurrently, so the first
+  // worker to clear this flag runs the calibration.
+  std::atomic<bool> calibrate_burden = false;
 
   std::basic_ostream<char> *out_view() {
 #if !SERIAL_TOOL
@@ -138,6 +172,12 @@ static void print_analysis(void) {
   cilk_time_t span = bottom.contin_span;
   cilk_time_t bspan = bottom.contin_bspan;
 
+  if (tool->binary_out) {
+    tool->binary_out->write("", work.get_raw_duration(),
+                            span.get_raw_duration(), bspan.get_raw_duration());
+    return;
+  }
+
   std::basic_ostream<char> &output = *tool->out_view();
   ensure_header(output);
   print_results(output, "", work, span, bspan);
@@ -169,6 +209,20 @@ static inline void ensure_serial_tool(void) {
 #pragma clang diagnostic ignored "-Wdeprecated-declarations"
 
 CilkscaleImpl_t::CilkscaleImpl_t() {
+  cilkscale_timer_t::init();
+
+  // Use the calibrated burden for this host, if requested.  If no calibrated
+  // burden is cached, calibrate it when the first spawning function is
+  // entered.
+  bool force_calibration;
+  if (burden_calibration_requested(force_calibration)) {
+    duration_t burden;
+    if (!force_calibration && read_cached_burden(burden))
+      cilkscale_timer_t::burden = burden;
+    else
+      calibrate_burden = true;
+  }
+
 #if SERIAL_TOOL
   shadow_stack = new shadow_stack_t(frame_type::MAIN);
 #else
@@ -182,6 +236,45 @@ CilkscaleImpl_t::CilkscaleImpl_t() {
   if (envstr)
     outf.open(envstr);
 
+  // Record results in binary form if a binary output file is specified.
+  if (const char *binstr = getenv("CILKSCALE_OUT_BINARY")) {
+    binary_out = new binary_sink_t();
+    if (!binary_out->open(
+            binstr, 3, cilk_time_t::units,
+            cilk_time_t(static_cast<raw_duration_t>(1)).get_scaled_val())) {
+      fprintf(stderr, "Cilkscale: could not open binary output file %s\n",
+              binstr);
+      delete binary_out;
+      binary_out = nullptr;
+    }
+  }
+
+  // Enable the per-ID profile if a profile output file is specified.
+  if (getenv("CILKSCALE_PROFILE"))
+    profile = new profile_t();
+
+  regions = new region_table_t();
+  shadow_stack_t::region_table = regions;
+
+#if LOCK_HOOKS
+  lock_spans_t::enabled = true;
+  locks = new lock_table_t(__cilkrts_get_nworkers());
+#endif
+
+  // Track the critical path if a critical-path output file is specified.
+  if (getenv("CILKSCALE_CRITICAL_PATH"))
+    path_t::enabled = true;
+
+  // Profile parallelism over time if a profile output file is specified.
+  if (getenv("CILKSCALE_PARALLELISM"))
+    parallelism_log_t::enabled = true;
+
+  // Record the computation dag if a dag output file is specified.
+  if (getenv("CILKSCALE_DAG")) {
+    dag_log_t::enabled = true;
+    dag_log_t::region = getenv("CILKSCALE_DAG_REGION");
+  }
+
 #if !SERIAL_TOOL
   outf_red = new out_reducer((outf.is_open() ? outf : outs));
   __cilkrts_reducer_register(
@@ -195,19 +288,93 @@ CilkscaleImpl_t::CilkscaleImpl_t() {
 }
 
 CilkscaleImpl_t::~CilkscaleImpl_t() {
-  tool->shadow_stack->stop.gettime();
+  tool->shadow_stack->end_strand(path_event::EXIT, UNKNOWN_CSI_ID,
+                                 dag_event::STRAND);
   shadow_stack_frame_t &bottom = tool->shadow_stack->peek_bot();
 
-  duration_t strand_time = tool->shadow_stack->elapsed_time();
-  bottom.contin_work += strand_time;
-  bottom.contin_span += strand_time;
-  bottom.contin_bspan += strand_time;
-
   print_analysis();
 
   if (outf.is_open())
     outf.close();
 
+  if (binary_out) {
+    binary_out->close();
+    delete binary_out;
+    binary_out = nullptr;
+  }
+
+  if (profile) {
+    std::ofstream proff(getenv("CILKSCALE_PROFILE"));
+    if (proff.is_open())
+      profile->write(proff);
+    else
+      fprintf(stderr, "Cilkscale: could not open profile file %s\n",
+              getenv("CILKSCALE_PROFILE"));
+    delete profile;
+    profile = nullptr;
+  }
+
+  // Any region end that remains unmatched after all reductions had no
+  // corresponding wsp_region_begin.
+  if (!shadow_stack->region_ends.empty())
+    fprintf(stderr, "Cilkscale: wsp_region_end without wsp_region_begin\n");
+  shadow_stack_t::region_table = nullptr;
+
+  // Write the region report to the file named by CILKSCALE_REGIONS, or to
+  // stderr by default.
+  if (!regions->empty()) {
+    const char *regions_file = getenv("CILKSCALE_REGIONS");
+    std::ofstream regionsf;
+    if (regions_file)
+      regionsf.open(regions_file);
+    if (regionsf.is_open())
+      regions->write(regionsf);
+    else
+      regions->write(std::cerr);
+  }
+  delete regions;
+  regions = nullptr;
+
+  // Write the lock-contention report to the file named by CILKSCALE_LOCKS_OUT,
+  // or to stderr by default.
+  if (locks) {
+    const char *locks_file = getenv("CILKSCALE_LOCKS_OUT");
+    std::ofstream locksf;
+    if (locks_file)
+      locksf.open(locks_file);
+    std::ostream &OS = locksf.is_open() ? locksf : std::cerr;
+    locks->write(OS, bottom.contin_work, bottom.contin_span,
+                 bottom.locks.get_spans());
+    delete locks;
+    locks = nullptr;
+  }
+
+  if (path_t::enabled) {
+    std::ofstream pathf(getenv("CILKSCALE_CRITICAL_PATH"));
+    if (pathf.is_open()) {
+      pathf << "tag,event,name,file,line,column,time (" << cilk_time_t::units
+            << ")\n";
+      print_critical_path(pathf, "", bottom.contin_path);
+    } else
+      fprintf(stderr, "Cilkscale: could not open critical-path file %s\n",
+              getenv("CILKSCALE_CRITICAL_PATH"));
+  }
+
+  if (parallelism_log_t::enabled) {
+    const char *envstr = getenv("CILKSCALE_PARALLELISM_BUCKETS");
+    unsigned num_buckets = envstr ? atoi(envstr) : 100;
+    std::ofstream parf(getenv("CILKSCALE_PARALLELISM"));
+    if (parf.is_open())
+      shadow_stack->parallelism.write(parf, num_buckets ? num_buckets : 100);
+    else
+      fprintf(stderr, "Cilkscale: could not open parallelism file %s\n",
+              getenv("CILKSCALE_PARALLELISM"));
+  }
+
+  if (dag_log_t::enabled && !shadow_stack->dag.write(getenv("CILKSCALE_DAG")))
+    fprintf(stderr, "Cilkscale: could not open dag file %s\n",
+            getenv("CILKSCALE_DAG"));
+
 #if !SERIAL_TOOL
   __cilkrts_reducer_unregister(shadow_stack);
 #endif
@@ -260,55 +427,81 @@ CILKTOOL_API void __csi_init() {
 
 CILKTOOL_API void __csi_unit_init(const char *const file_name,
                                   const instrumentation_counts_t counts) {
+#if CSCALETIMER == INST
+  inst_counter_t::add_unit(counts.num_bb);
+#endif
   return;
 }
 
+#if CSCALETIMER == INST
+// Only the instruction-count tool measures basic blocks.  The other tools do
+// not define the basic-block hooks, so that instrumented programs use the
+// default no-op hooks instead of calling into the tool for every basic block.
 CILKTOOL_API
 void __csi_bb_entry(const csi_id_t bb_id, const bb_prop_t prop) {
-  if (!CILKSCALE_INITIALIZED)
-    return;
-
-  shadow_stack_frame_t &bottom = tool->shadow_stack->peek_bot();
-  get_bb_time(&bottom.contin_work, &bottom.contin_span, &bottom.contin_bspan,
-              bb_id);
-  return;
+  inst_counter_t::add_bb(bb_id);
 }
 
 CILKTOOL_API
 void __csi_bb_exit(const csi_id_t bb_id, const bb_prop_t prop) { return; }
+#endif // CSCALETIMER == INST
+
+#if LOCK_HOOKS
+// ID of the call from instrumented code to an uninstrumented function that is
+// running, or UNKNOWN_CSI_ID.  Only locks acquired and released by calls from
+// instrumented code are analyzed, which excludes the locks of the OpenCilk
+// runtime and of the tool itself.
+static thread_local csi_id_t lock_call_id = UNKNOWN_CSI_ID;
+
+CILKTOOL_API
+void __csi_before_call(const csi_id_t call_id, const csi_id_t func_id,
+                       const call_prop_t prop) {
+  lock_call_id = call_id;
+}
+
+CILKTOOL_API
+void __csi_after_call(const csi_id_t call_id, const csi_id_t func_id,
+                      const call_prop_t prop) {
+  lock_call_id = UNKNOWN_CSI_ID;
+}
+#endif // LOCK_HOOKS
 
 CILKTOOL_API
 void __csi_func_entry(const csi_id_t func_id, const func_prop_t prop) {
+#if LOCK_HOOKS
+  // Only direct calls from instrumented code to the lock functions are
+  // analyzed.
+  lock_call_id = UNKNOWN_CSI_ID;
+#endif
   if (!CILKSCALE_INITIALIZED)
     return;
   if (!prop.may_spawn)
     return;
 
-  tool->shadow_stack->stop.gettime();
+  if (__builtin_expect(
+          tool->calibrate_burden.load(std::memory_order_relaxed), false) &&
+      tool->calibrate_burden.exchange(false)) {
+    // Account for the strand so far, and then run the calibration outside of
+    // any measured strand.
+    tool->shadow_stack->end_strand(path_event::FUNC_ENTRY, func_id,
+                                   dag_event::STRAND);
+    run_burden_calibration();
+    tool->shadow_stack->start.gettime();
+  }
 
 #if TRACE_CALLS
   fprintf(stderr, "[W%d] func_entry(%ld)\n", __cilkrts_get_worker_number(),
           func_id);
 #endif
 
-  shadow_stack_frame_t &bottom = tool->shadow_stack->peek_bot();
-
-  duration_t strand_time = tool->shadow_stack->elapsed_time();
-  bottom.contin_work += strand_time;
-  bottom.contin_span += strand_time;
-  bottom.contin_bspan += strand_time;
-
-  shadow_stack_frame_t &p_bottom = tool->shadow_stack->peek_bot();
-  cilk_time_t p_contin_work = p_bottom.contin_work;
-  cilk_time_t p_contin_span = p_bottom.contin_span;
-  cilk_time_t p_contin_bspan = p_bottom.contin_bspan;
+  tool->shadow_stack->end_strand(path_event::FUNC_ENTRY, func_id,
+                                 dag_event::CALL);
 
-  // Push new frame onto the stack
+  // Push new frame onto the stack.  Pushing might reallocate the stack, so
+  // the parent frame is retrieved again afterwards.
   shadow_stack_frame_t &c_bottom =
     tool->shadow_stack->push(frame_type::SPAWNER);
-  c_bottom.contin_work = p_contin_work;
-  c_bottom.contin_span = p_contin_span;
-  c_bottom.contin_bspan = p_contin_bspan;
+  c_bottom.inherit_contin(tool->shadow_stack->peek_parent());
 
   // stack.start.gettime();
   // Because of the high overhead of calling gettime(), especially compared to
@@ -326,14 +519,13 @@ void __csi_func_exit(const csi_id_t func_exit_id, const csi_id_t func_id,
   if (!prop.may_spawn)
     return;
 
-  tool->shadow_stack->stop.gettime();
-
 #if TRACE_CALLS
   fprintf(stderr, "[W%d] func_exit(%ld)\n", __cilkrts_get_worker_number(),
           func_id);
 #endif
 
-  duration_t strand_time = tool->shadow_stack->elapsed_time();
+  tool->shadow_stack->end_strand(path_event::FUNC_EXIT, func_exit_id,
+                                 dag_event::RETURN);
 
   assert(cilk_time_t::zero() == tool->shadow_stack->peek_bot().lchild_span);
 
@@ -341,9 +533,24 @@ void __csi_func_exit(const csi_id_t func_exit_id, const csi_id_t func_id,
   shadow_stack_frame_t &c_bottom = tool->shadow_stack->pop();
   shadow_stack_frame_t &p_bottom = tool->shadow_stack->peek_bot();
 
-  p_bottom.contin_work = c_bottom.contin_work + strand_time;
-  p_bottom.contin_span = c_bottom.contin_span + strand_time;
-  p_bottom.contin_bspan = c_bottom.contin_bspan + strand_time;
+  // Attribute the work and span of this function invocation to func_id.  The
+  // child frame started from the parent's work and span, so the differences
+  // give the invocation's contribution.
+  if (tool->profile)
+    tool->profile->record_func(
+        func_id, c_bottom.contin_work - p_bottom.contin_work,
+        c_bottom.contin_span - p_bottom.contin_span,
+        c_bottom.contin_bspan - p_bottom.contin_bspan);
+
+  p_bottom.contin_work = c_bottom.contin_work;
+  p_bottom.contin_span = c_bottom.contin_span;
+  p_bottom.contin_bspan = c_bottom.contin_bspan;
+  if (path_t::enabled) {
+    p_bottom.contin_path = std::move(c_bottom.contin_path);
+    p_bottom.contin_path_span = c_bottom.contin_path_span;
+  }
+  if (lock_spans_t::enabled)
+    p_bottom.locks.add_callee(c_bottom.locks);
 
   // stack.start.gettime();
   // Because of the high overhead of calling gettime(), especially compared to
@@ -356,19 +563,13 @@ void __csi_func_exit(const csi_id_t func_exit_id, const csi_id_t func_id,
 CILKTOOL_API
 void __csi_detach(const csi_id_t detach_id, const unsigned sync_reg,
                   const detach_prop_t prop) {
-  tool->shadow_stack->stop.gettime();
-
 #if TRACE_CALLS
   fprintf(stderr, "[W%d] detach(%ld)\n", __cilkrts_get_worker_number(),
           detach_id);
 #endif
 
-  shadow_stack_frame_t &bottom = tool->shadow_stack->peek_bot();
-
-  duration_t strand_time = tool->shadow_stack->elapsed_time();
-  bottom.contin_work += strand_time;
-  bottom.contin_span += strand_time;
-  bottom.contin_bspan += strand_time;
+  tool->shadow_stack->end_strand(path_event::DETACH, detach_id,
+                                 dag_event::SPAWN);
 }
 
 CILKTOOL_API
@@ -379,16 +580,10 @@ void __csi_task(const csi_id_t task_id, const csi_id_t detach_id,
           task_id, detach_id);
 #endif
 
-  shadow_stack_frame_t &p_bottom = tool->shadow_stack->peek_bot();
-  cilk_time_t p_contin_work = p_bottom.contin_work;
-  cilk_time_t p_contin_span = p_bottom.contin_span;
-  cilk_time_t p_contin_bspan = p_bottom.contin_bspan;
-
-  // Push new frame onto the stack.
+  // Push new frame onto the stack.  Pushing might reallocate the stack, so
+  // the parent frame is retrieved afterwards.
   shadow_stack_frame_t &c_bottom = tool->shadow_stack->push(frame_type::HELPER);
-  c_bottom.contin_work = p_contin_work;
-  c_bottom.contin_span = p_contin_span;
-  c_bottom.contin_bspan = p_contin_bspan;
+  c_bottom.inherit_contin(tool->shadow_stack->peek_parent());
 
   tool->shadow_stack->start.gettime();
 }
@@ -397,32 +592,41 @@ CILKTOOL_API
 void __csi_task_exit(const csi_id_t task_exit_id, const csi_id_t task_id,
                      const csi_id_t detach_id, const unsigned sync_reg,
                      const task_exit_prop_t prop) {
-  tool->shadow_stack->stop.gettime();
-
 #if TRACE_CALLS
   fprintf(stderr, "[W%d] task_exit(%ld, %ld, %ld)\n",
           __cilkrts_get_worker_number(), task_exit_id, task_id, detach_id);
 #endif
 
-  shadow_stack_frame_t &bottom = tool->shadow_stack->peek_bot();
-
-  duration_t strand_time = tool->shadow_stack->elapsed_time();
-  bottom.contin_work += strand_time;
-  bottom.contin_span += strand_time;
-  bottom.contin_bspan += strand_time;
+  tool->shadow_stack->end_strand(path_event::TASK_EXIT, task_exit_id,
+                                 dag_event::TASK_EXIT);
 
-  assert(cilk_time_t::zero() == bottom.lchild_span);
+  assert(cilk_time_t::zero() == tool->shadow_stack->peek_bot().lchild_span);
 
   // Pop the stack
   shadow_stack_frame_t &c_bottom = tool->shadow_stack->pop();
   shadow_stack_frame_t &p_bottom = tool->shadow_stack->peek_bot();
+
+  // Attribute the work and span of this task to its spawn site.
+  if (tool->profile)
+    tool->profile->record_task(
+        detach_id, prop.is_tapir_loop_body,
+        c_bottom.contin_work - p_bottom.contin_work,
+        c_bottom.contin_span - p_bottom.contin_span,
+        c_bottom.contin_bspan + cilkscale_timer_t::burden -
+            p_bottom.contin_bspan);
+
   p_bottom.achild_work += c_bottom.contin_work - p_bottom.contin_work;
   // Check if the span of c_bottom exceeds that of the previous longest child.
-  if (c_bottom.contin_span > p_bottom.lchild_span)
+  if (c_bottom.contin_span > p_bottom.lchild_span) {
     p_bottom.lchild_span = c_bottom.contin_span;
+    if (path_t::enabled)
+      p_bottom.lchild_path = std::move(c_bottom.contin_path);
+  }
   if (c_bottom.contin_bspan + cilkscale_timer_t::burden
       > p_bottom.lchild_bspan)
     p_bottom.lchild_bspan = c_bottom.contin_bspan + cilkscale_timer_t::burden;
+  if (lock_spans_t::enabled)
+    p_bottom.locks.add_child(c_bottom.locks, c_bottom.contin_span);
 }
 
 CILKTOOL_API
@@ -441,20 +645,8 @@ void __csi_detach_continue(const csi_id_t detach_continue_id,
     // In opencilk, upon reaching the unwind destination of a detach, all
     // spawned child computations have been synced.  Hence we replicate the
     // logic from after_sync here to compute work and span.
-
-    // Add achild_work to contin_work, and reset contin_work.
-    bottom.contin_work += bottom.achild_work;
-    bottom.achild_work = cilk_time_t::zero();
-
-    // Select the largest of lchild_span and contin_span, and then reset
-    // lchild_span.
-    if (bottom.lchild_span > bottom.contin_span)
-      bottom.contin_span = bottom.lchild_span;
-    bottom.lchild_span = cilk_time_t::zero();
-
-    if (bottom.lchild_bspan > bottom.contin_bspan)
-      bottom.contin_bspan = bottom.lchild_bspan;
-    bottom.lchild_bspan = cilk_time_t::zero();
+    bottom.sync();
+    tool->shadow_stack->dag.add(dag_event::SYNC, duration_t(0));
   } else {
     bottom.contin_bspan += cilkscale_timer_t::burden;
   }
@@ -464,19 +656,12 @@ void __csi_detach_continue(const csi_id_t detach_continue_id,
 
 CILKTOOL_API
 void __csi_before_sync(const csi_id_t sync_id, const unsigned sync_reg) {
-  tool->shadow_stack->stop.gettime();
-
 #if TRACE_CALLS
   fprintf(stderr, "[W%d] before_sync(%ld)\n", __cilkrts_get_worker_number(),
           sync_id);
 #endif
 
-  shadow_stack_frame_t &bottom = tool->shadow_stack->peek_bot();
-
-  duration_t strand_time = tool->shadow_stack->elapsed_time();
-  bottom.contin_work += strand_time;
-  bottom.contin_span += strand_time;
-  bottom.contin_bspan += strand_time;
+  tool->shadow_stack->end_strand(path_event::SYNC, sync_id, dag_event::SYNC);
 }
 
 CILKTOOL_API
@@ -488,20 +673,7 @@ void __csi_after_sync(const csi_id_t sync_id, const unsigned sync_reg) {
 
   shadow_stack_frame_t &bottom = tool->shadow_stack->peek_bot();
   // Update the work and span recorded for the bottom-most frame on the stack.
-
-  // Add achild_work to contin_work, and reset contin_work.
-  bottom.contin_work += bottom.achild_work;
-  bottom.achild_work = cilk_time_t::zero();
-
-  // Select the largest of lchild_span and contin_span, and then reset
-  // lchild_span.
-  if (bottom.lchild_span > bottom.contin_span)
-    bottom.contin_span = bottom.lchild_span;
-  bottom.lchild_span = cilk_time_t::zero();
-
-  if (bottom.lchild_bspan > bottom.contin_bspan)
-    bottom.contin_bspan = bottom.lchild_bspan;
-  bottom.lchild_bspan = cilk_time_t::zero();
+  bottom.sync();
 
   tool->shadow_stack->start.gettime();
 }
@@ -510,17 +682,11 @@ void __csi_after_sync(const csi_id_t sync_id, const unsigned sync_reg) {
 // Probes and associated routines
 
 CILKTOOL_API wsp_t wsp_getworkspan() CILKSCALE_NOTHROW {
-  tool->shadow_stack->stop.gettime();
-
 #if TRACE_CALLS
   fprintf(stderr, "getworkspan()\n");
 #endif
-  shadow_stack_frame_t &bottom = tool->shadow_stack->peek_bot();
-
-  duration_t strand_time = tool->shadow_stack->elapsed_time();
-  bottom.contin_work += strand_time;
-  bottom.contin_span += strand_time;
-  bottom.contin_bspan += strand_time;
+  tool->shadow_stack->end_strand(path_event::PROBE, UNKNOWN_CSI_ID,
+                                 dag_event::STRAND);
 
   wsp_t result = {tool->shadow_stack->peek_bot().contin_work.get_raw_duration(),
                   tool->shadow_stack->peek_bot().contin_span.get_raw_duration(),
@@ -553,14 +719,8 @@ operator-=(wsp_t &lhs, const wsp_t &rhs) noexcept {
 
 __attribute__((visibility("default"))) std::ostream &
 operator<<(std::ostream &OS, const wsp_t &pt) {
-  tool->shadow_stack->stop.gettime();
-
-  shadow_stack_frame_t &bottom = tool->shadow_stack->peek_bot();
-
-  duration_t strand_time = tool->shadow_stack->elapsed_time();
-  bottom.contin_work += strand_time;
-  bottom.contin_span += strand_time;
-  bottom.contin_bspan += strand_time;
+  tool->shadow_stack->end_strand(path_event::PROBE, UNKNOWN_CSI_ID,
+                                 dag_event::STRAND);
 
   cilk_time_t work = cilk_time_t(pt.work);
   cilk_time_t span = cilk_time_t(pt.span);
@@ -574,14 +734,8 @@ operator<<(std::ostream &OS, const wsp_t &pt) {
 
 __attribute__((visibility("default"))) std::ofstream &
 operator<<(std::ofstream &OS, const wsp_t &pt) {
-  tool->shadow_stack->stop.gettime();
-
-  shadow_stack_frame_t &bottom = tool->shadow_stack->peek_bot();
-
-  duration_t strand_time = tool->shadow_stack->elapsed_time();
-  bottom.contin_work += strand_time;
-  bottom.contin_span += strand_time;
-  bottom.contin_bspan += strand_time;
+  tool->shadow_stack->end_strand(path_event::PROBE, UNKNOWN_CSI_ID,
+                                 dag_event::STRAND);
 
   cilk_time_t work = cilk_time_t(pt.work);
   cilk_time_t span = cilk_time_t(pt.span);
@@ -607,20 +761,239 @@ CILKTOOL_API wsp_t wsp_sub(wsp_t lhs, wsp_t rhs) CILKSCALE_NOTHROW {
   return lhs;
 }
 
-CILKTOOL_API void wsp_dump(wsp_t wsp, const char *tag) {
-  tool->shadow_stack->stop.gettime();
+CILKTOOL_API void wsp_sweep(const char *tag, void (*body)(void *), void *arg) {
+  // Cilkscale measures work and span, which do not depend on the number of
+  // workers, so body needs to run only once.
+  wsp_t start = wsp_getworkspan();
+  body(arg);
+  wsp_dump(wsp_sub(wsp_getworkspan(), start), tag);
+}
 
+CILKTOOL_API void wsp_region_begin(const char *name) CILKSCALE_NOTHROW {
+  duration_t strand_time =
+      tool->shadow_stack->end_strand(path_event::PROBE, UNKNOWN_CSI_ID);
   shadow_stack_frame_t &bottom = tool->shadow_stack->peek_bot();
+  bool record_dag = tool->shadow_stack->dag.begin_region(name, strand_time);
 
-  duration_t strand_time = tool->shadow_stack->elapsed_time();
-  bottom.contin_work += strand_time;
-  bottom.contin_span += strand_time;
-  bottom.contin_bspan += strand_time;
+  std::vector<open_region_t> &open = tool->shadow_stack->regions;
+  region_id_t parent = open.empty() ? NO_REGION : open.back().id;
+  open.push_back({tool->regions->lookup(parent, name), bottom.contin_work,
+                  bottom.contin_span, bottom.contin_bspan, record_dag});
 
-  std::basic_ostream<char> &output = *tool->out_view();
-  ensure_header(output);
-  print_results(output, tag, cilk_time_t(wsp.work), cilk_time_t(wsp.span),
-                cilk_time_t(wsp.bspan));
+  tool->shadow_stack->start.gettime();
+}
+
+CILKTOOL_API void wsp_region_end(void) CILKSCALE_NOTHROW {
+  duration_t strand_time =
+      tool->shadow_stack->end_strand(path_event::PROBE, UNKNOWN_CSI_ID);
+  shadow_stack_frame_t &bottom = tool->shadow_stack->peek_bot();
+
+  std::vector<open_region_t> &open = tool->shadow_stack->regions;
+  if (open.empty()) {
+    // The region began on another shadow stack, before a spawn whose
+    // continuation was stolen.  Record the end, to be matched with the
+    // beginning when the shadow stacks are reduced.
+    int64_t dag_index =
+        tool->shadow_stack->dag.end_region_elsewhere(strand_time);
+    tool->shadow_stack->region_ends.push_back(
+        {bottom.contin_work, bottom.contin_span, bottom.contin_bspan,
+         dag_index});
+  } else {
+    const open_region_t &region = open.back();
+    if (region.record_dag)
+      tool->shadow_stack->dag.end_region(strand_time);
+    else
+      tool->shadow_stack->dag.add(dag_event::STRAND, strand_time);
+    tool->regions->record(region.id, bottom.contin_work - region.work,
+                          bottom.contin_span - region.span,
+                          bottom.contin_bspan - region.bspan);
+    open.pop_back();
+  }
+
+  tool->shadow_stack->start.gettime();
+}
+
+CILKTOOL_API void wsp_dump(wsp_t wsp, const char *tag) {
+  tool->shadow_stack->end_strand(path_event::PROBE, UNKNOWN_CSI_ID,
+                                 dag_event::STRAND);
+
+  if (tool->binary_out) {
+    tool->binary_out->write(tag, wsp.work, wsp.span, wsp.bspan);
+  } else {
+    std::basic_ostream<char> &output = *tool->out_view();
+    ensure_header(output);
+    print_results(output, tag, cilk_time_t(wsp.work), cilk_time_t(wsp.span),
+                  cilk_time_t(wsp.bspan));
+  }
+
+  tool->shadow_stack->start.gettime();
+}
+
+#if LOCK_HOOKS
+///////////////////////////////////////////////////////////////////////////
+// Interposed lock functions, for analyzing lock contention
+
+// Get the ID of the call from instrumented code to the running lock function,
+// or UNKNOWN_CSI_ID if the lock operation is not analyzed.
+static inline bool lock_analysis_active() {
+  return CILKSCALE_INITIALIZED && tool && tool->locks;
+}
+
+static inline csi_id_t take_lock_call_id() {
+  csi_id_t call_id = lock_call_id;
+  lock_call_id = UNKNOWN_CSI_ID;
+  if (!lock_analysis_active())
+    return UNKNOWN_CSI_ID;
+  return call_id;
+}
+
+// Get the lock statistics of the current worker, or null if the calling thread
+// is not a Cilk worker.
+static inline lock_worker_t *current_lock_worker() {
+  return tool->locks->get_worker(__cilkrts_get_worker_number());
+}
+
+// Get the next definition of the interposed function called name, caching it
+// in fn.
+template <typename Fn>
+static inline Fn real_function(Fn &fn, const char *name) {
+  if (!fn)
+    fn = reinterpret_cast<Fn>(dlsym(RTLD_NEXT, name));
+  return fn;
+}
+
+#define REAL(name) real_function(real_##name, #name)
+
+// Acquire mutex for the call call_id, first with try_lock, which returns 0 if
+// it acquires the lock, and then, if the lock is held, with lock.
+template <typename TryLock, typename Lock>
+static int analyze_lock(const void *mutex, csi_id_t call_id, TryLock try_lock,
+                        Lock lock) {
+  lock_worker_t *worker = current_lock_worker();
+  if (!worker)
+    return lock();
+
+  // End the strand before acquiring the lock, so that the time spent waiting
+  // for the lock is excluded from the work and span.
+  tool->shadow_stack->end_strand(path_event::PROBE, UNKNOWN_CSI_ID,
+                                 dag_event::STRAND);
+
+  bool contended = false;
+  int result = try_lock();
+  if (0 != result) {
+    contended = true;
+    result = lock();
+  }
 
   tool->shadow_stack->start.gettime();
+  if (0 == result)
+    tool->locks->record_acquire(*worker, reinterpret_cast<uintptr_t>(mutex),
+                                call_id, tool->shadow_stack->start,
+                                tool->shadow_stack->peek_bot().contin_span,
+                                contended,
+                                elapsed_time(&tool->shadow_stack->start,
+                                             &tool->shadow_stack->stop));
+  return result;
+}
+
+// Record the acquisition of mutex by a successful trylock for the call
+// call_id.
+static void analyze_trylock(const void *mutex, csi_id_t call_id) {
+  lock_worker_t *worker = current_lock_worker();
+  if (!worker)
+    return;
+  cilkscale_timer_t acquired;
+  acquired.gettime();
+  tool->locks->record_acquire(*worker, reinterpret_cast<uintptr_t>(mutex),
+                              call_id, acquired,
+                              tool->shadow_stack->peek_bot().contin_span,
+                              false, duration_t(0));
+}
+
+// Record the release of mutex, if some worker holds it, and add the time it
+// was held to the lock-aware span.  The release is analyzed regardless of where
+// it is called from, so that a lock acquired by instrumented code is accounted
+// for even if uninstrumented code releases it.
+static void analyze_unlock(const void *mutex) {
+  lock_worker_t *worker = current_lock_worker();
+  if (!worker)
+    return;
+  cilkscale_timer_t released;
+  released.gettime();
+  duration_t hold;
+  cilk_time_t span = cilk_time_t::zero();
+  shadow_stack_frame_t &bottom = tool->shadow_stack->peek_bot();
+  if (tool->locks->record_release(*worker, reinterpret_cast<uintptr_t>(mutex),
+                                  released, bottom.contin_span, hold, span))
+    bottom.locks.add_hold(reinterpret_cast<uintptr_t>(mutex), hold, span);
+}
+
+static decltype(&pthread_mutex_lock) real_pthread_mutex_lock = nullptr;
+static decltype(&pthread_mutex_trylock) real_pthread_mutex_trylock = nullptr;
+static decltype(&pthread_mutex_unlock) real_pthread_mutex_unlock = nullptr;
+
+CILKTOOL_API int pthread_mutex_lock(pthread_mutex_t *mutex) noexcept {
+  csi_id_t call_id = take_lock_call_id();
+  if (UNKNOWN_CSI_ID == call_id)
+    return REAL(pthread_mutex_lock)(mutex);
+  return analyze_lock(
+      mutex, call_id, [=] { return REAL(pthread_mutex_trylock)(mutex); },
+      [=] { return REAL(pthread_mutex_lock)(mutex); });
+}
+
+CILKTOOL_API int pthread_mutex_trylock(pthread_mutex_t *mutex) noexcept {
+  csi_id_t call_id = take_lock_call_id();
+  int result = REAL(pthread_mutex_trylock)(mutex);
+  if (UNKNOWN_CSI_ID != call_id && 0 == result)
+    analyze_trylock(mutex, call_id);
+  return result;
+}
+
+CILKTOOL_API int pthread_mutex_unlock(pthread_mutex_t *mutex) noexcept {
+  lock_call_id = UNKNOWN_CSI_ID;
+  if (lock_analysis_active())
+    analyze_unlock(mutex);
+  return REAL(pthread_mutex_unlock)(mutex);
+}
+
+#ifndef __STDC_NO_THREADS__
+static decltype(&mtx_lock) real_mtx_lock = nullptr;
+static decltype(&mtx_trylock) real_mtx_trylock = nullptr;
+static decltype(&mtx_timedlock) real_mtx_timedlock = nullptr;
+static decltype(&mtx_unlock) real_mtx_unlock = nullptr;
+
+CILKTOOL_API int mtx_lock(mtx_t *mutex) {
+  csi_id_t call_id = take_lock_call_id();
+  if (UNKNOWN_CSI_ID == call_id)
+    return REAL(mtx_lock)(mutex);
+  return analyze_lock(
+      mutex, call_id, [=] { return REAL(mtx_trylock)(mutex); },
+      [=] { return REAL(mtx_lock)(mutex); });
+}
+
+CILKTOOL_API int mtx_trylock(mtx_t *mutex) {
+  csi_id_t call_id = take_lock_call_id();
+  int result = REAL(mtx_trylock)(mutex);
+  if (UNKNOWN_CSI_ID != call_id && thrd_success == result)
+    analyze_trylock(mutex, call_id);
+  return result;
+}
+
+CILKTOOL_API int mtx_timedlock(mtx_t *__restrict__ mutex,
+                               const struct timespec *__restrict__ time_point) {
+  csi_id_t call_id = take_lock_call_id();
+  if (UNKNOWN_CSI_ID == call_id)
+    return REAL(mtx_timedlock)(mutex, time_point);
+  return analyze_lock(
+      mutex, call_id, [=] { return REAL(mtx_trylock)(mutex); },
+      [=] { return REAL(mtx_timedlock)(mutex, time_point); });
+}
+
+CILKTOOL_API int mtx_unlock(mtx_t *mutex) {
+  lock_call_id = UNKNOWN_CSI_ID;
+  if (lock_analysis_active())
+    analyze_unlock(mutex);
+  return REAL(mtx_unlock)(mutex);
 }
+#endif // __STDC_NO_THREADS__
+#endif // LOCK_HOOKS
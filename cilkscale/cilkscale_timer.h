@@ -11,20 +11,162 @@
 #define CLOCK 2
 // This timer is used by the cilkscale-instructions tool.
 #define INST 3
+// Time-stamp counter calibrated against CLOCK_MONOTONIC.
+#define TSC 4
+// This timer is used by the cilkscale-perf tool.
+#define PERF 5
 
 #ifndef CSCALETIMER
-// Valid cilkscale timer values are RDTSC, CLOCK, and INST
+// Valid cilkscale timer values are RDTSC, CLOCK, INST, TSC, and PERF
+#if defined(__x86_64__) || defined(__i386__)
+#define CSCALETIMER TSC
+#else
 #define CSCALETIMER CLOCK
 #endif
+#endif
 
 #if CSCALETIMER == RDTSC
 #elif CSCALETIMER == CLOCK
 #include <chrono>
+#elif CSCALETIMER == TSC
+#include <cstdlib>
+#include <ctime>
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+#elif CSCALETIMER == PERF
+#include "perf_counter.h"
+#elif CSCALETIMER == INST
+#include <cstdlib>
+#endif
+
+#if CSCALETIMER == INST
+// Counter of the IR instructions executed by each thread, which serves as the
+// clock for the cilkscale-instructions tool.  The basic-block hook adds the IR
+// cost of each basic block to the counter of the executing thread, and the
+// tool measures strands by reading this counter, just as other tools read a
+// clock.
+struct inst_counter_t {
+  // IR cost of each basic block, indexed by CSI ID.  Costs are copied from
+  // the sizeinfo tables as each unit is initialized, so that the basic-block
+  // hook reads them from a single flat array.
+  static inline int32_t *bb_costs = nullptr;
+  static inline csi_id_t num_bbs = 0;
+
+  static inline thread_local int64_t count
+      __attribute__((tls_model("initial-exec"))) = 0;
+
+  // Add the costs of the num_new_bbs basic blocks of a newly initialized unit.
+  static void add_unit(csi_id_t num_new_bbs) {
+    if (num_new_bbs <= 0)
+      return;
+    csi_id_t new_num_bbs = num_bbs + num_new_bbs;
+    bb_costs = static_cast<int32_t *>(
+        realloc(bb_costs, sizeof(int32_t) * new_num_bbs));
+    for (csi_id_t bb_id = num_bbs; bb_id < new_num_bbs; ++bb_id) {
+      const sizeinfo_t *info = __csi_get_bb_sizeinfo(bb_id);
+      bb_costs[bb_id] = info ? info->ir_cost : 0;
+    }
+    num_bbs = new_num_bbs;
+  }
+
+  __attribute__((always_inline)) static void add_bb(const csi_id_t bb_id) {
+    if (__builtin_expect(bb_id < num_bbs, true))
+      count += bb_costs[bb_id];
+  }
+
+  static int64_t now() { return count; }
+};
+
+#endif // CSCALETIMER == INST
+
+#if CSCALETIMER == TSC
+// Clock based on the time-stamp counter (TSC), which can be read in a few
+// nanoseconds, much faster than std::chrono::steady_clock.  At startup,
+// calibrate() measures the TSC frequency against CLOCK_MONOTONIC, so that tick
+// counts can be converted to time.  If the processor does not have an
+// invariant TSC, whose frequency is constant across cores, frequency scaling,
+// and idle states, then this clock falls back to reading CLOCK_MONOTONIC
+// directly, and each tick is one nanosecond.
+struct tsc_clock_t {
+  // Set if ticks are read from the TSC.
+  static inline bool use_tsc = false;
+  // Nanoseconds per tick.
+  static inline double ns_per_tick = 1.0;
+
+  // Minimum duration of the calibration interval, in nanoseconds.
+  static constexpr int64_t CALIBRATION_NS = 10000000;
+
+  static int64_t monotonic_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+  }
+
+  static int64_t now() {
+#if defined(__x86_64__) || defined(__i386__)
+    if (__builtin_expect(use_tsc, true))
+      return __rdtsc();
+#endif
+    return monotonic_ns();
+  }
+
+  static bool has_invariant_tsc() {
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned eax, ebx, ecx, edx;
+    if (!__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) || eax < 0x80000007)
+      return false;
+    __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+    return edx & (1 << 8);
+#else
+    return false;
 #endif
+  }
+
+  // Get a simultaneous reading of the TSC and CLOCK_MONOTONIC.  The clock
+  // reading is bracketed by TSC readings, and the tightest of several brackets
+  // is used, to limit the error from the cost of reading the clock.
+  static void sample(int64_t &tsc, int64_t &ns) {
+#if defined(__x86_64__) || defined(__i386__)
+    int64_t best = INT64_MAX;
+    for (int i = 0; i < 8; ++i) {
+      int64_t before = __rdtsc();
+      int64_t clock = monotonic_ns();
+      int64_t after = __rdtsc();
+      if (after - before < best) {
+        best = after - before;
+        tsc = before + (after - before) / 2;
+        ns = clock;
+      }
+    }
+#endif
+  }
+
+  static void calibrate() {
+    if (!has_invariant_tsc() || getenv("CILKSCALE_NO_TSC")) {
+      use_tsc = false;
+      ns_per_tick = 1.0;
+      return;
+    }
+
+    int64_t tsc0, ns0, tsc1, ns1;
+    sample(tsc0, ns0);
+    do
+      sample(tsc1, ns1);
+    while (ns1 - ns0 < CALIBRATION_NS);
+
+    use_tsc = true;
+    ns_per_tick = static_cast<double>(ns1 - ns0) / (tsc1 - tsc0);
+  }
+};
+
+#endif // CSCALETIMER == TSC
 
 ///////////////////////////////////////////////////////////////////////////
 // Data structures and helper methods for time of user strands.
-#if CSCALETIMER == RDTSC || CSCALETIMER == INST
+#if CSCALETIMER == RDTSC || CSCALETIMER == INST || CSCALETIMER == TSC ||     \
+    CSCALETIMER == PERF
 using duration_t = raw_duration_t;
 #else // CSCALETIMER == CLOCK
 using duration_t = std::chrono::nanoseconds;
@@ -43,7 +185,8 @@ public:
   ~cilk_time_t() = default;
 
   static cilk_time_t zero() {
-#if CSCALETIMER == RDTSC || CSCALETIMER == INST
+#if CSCALETIMER == RDTSC || CSCALETIMER == INST || CSCALETIMER == TSC ||     \
+    CSCALETIMER == PERF
     return cilk_time_t(0);
 #else // CSCALETIMER == CLOCK
     return cilk_time_t(duration_t::zero());
@@ -100,7 +243,8 @@ public:
   raw_duration_t get_raw_duration() const {
 #if CSCALETIMER == CLOCK
     return val.count();
-#else // CSCALETIMER == RDTSC || CSCALETIMER == INST
+#else // CSCALETIMER == RDTSC || CSCALETIMER == INST || CSCALETIMER == TSC ||
+      // CSCALETIMER == PERF
     return val;
 #endif // CSCALETIMER
   }
@@ -111,7 +255,9 @@ public:
     return fraction_seconds(val).count();
 #elif CSCALETIMER == RDTSC
     return (double)val;
-#else // CSCALETIMER == INST
+#elif CSCALETIMER == TSC
+    return (double)val * tsc_clock_t::ns_per_tick * 1e-9;
+#else // CSCALETIMER == INST || CSCALETIMER == PERF
     return (double)val;
 #endif // CSCALETIMER
   }
@@ -120,8 +266,10 @@ public:
   static const char *units;
 
   double get_scaled_val() const {
-#if CSCALETIMER == CLOCK
+#if CSCALETIMER == CLOCK || CSCALETIMER == TSC
     return get_val_d();
+#elif CSCALETIMER == PERF
+    return get_val_d() / perf_counter_t::event->scale_factor;
 #else // CSCALETIMER == RDTSC || CSCALETIMER == INST
     return get_val_d() / scale_factor;
 #endif // CSCALETIMER
@@ -140,19 +288,19 @@ public:
 const char *cilk_time_t::units =
 #if CSCALETIMER == RDTSC
     "Gcycles"
-#elif CSCALETIMER == INST
+#elif CSCALETIMER == INST || CSCALETIMER == PERF
     "Minstructions"
-#else // CSCALETIMER == CLOCK
+#else // CSCALETIMER == CLOCK || CSCALETIMER == TSC
     "seconds"
 #endif // CSCALETIMER
     ;
 
 const double cilk_time_t::scale_factor =
-#if CSCALETIMER == CLOCK
+#if CSCALETIMER == CLOCK || CSCALETIMER == TSC
     1.0
 #elif CSCALETIMER == RDTSC
     1000000000.0
-#else // CSCALETIMER == INST
+#else // CSCALETIMER == INST || CSCALETIMER == PERF
     1000000.0
 #endif // CSCALETIMER
     ;
@@ -164,8 +312,14 @@ struct cilkscale_timer_t {
 #elif CSCALETIMER == CLOCK
   using timer_t = std::chrono::steady_clock;
   using time_point_t = timer_t::time_point;
+#elif CSCALETIMER == TSC
+  using timer_t = tsc_clock_t;
+  using time_point_t = int64_t;
+#elif CSCALETIMER == PERF
+  using timer_t = perf_counter_t;
+  using time_point_t = int64_t;
 #else // CSCALETIMER == INST
-  using timer_t = int64_t;
+  using timer_t = inst_counter_t;
   using time_point_t = int64_t;
 #endif // CSCALETIMER
 
@@ -182,24 +336,35 @@ struct cilkscale_timer_t {
   void gettime() {
 #if CSCALETIMER == RDTSC
     time = __rdtsc();
-#elif CSCALETIMER == CLOCK
+#else // CSCALETIMER == CLOCK || CSCALETIMER == TSC || CSCALETIMER == PERF ||
+      // CSCALETIMER == INST
     time = timer_t::now();
-#else // CSCALETIMER == INST
-    time = 0;
 #endif // CSCALETIMER
   }
 
   duration_t readtime() {
-#if CSCALETIMER == INST
-  return time;
-#elif CSCALETIMER == CLOCK
-  return std::chrono::duration_cast<duration_t>(time.time_since_epoch());
-#else
-  return time;
-#endif
+#if CSCALETIMER == CLOCK
+    return std::chrono::duration_cast<duration_t>(time.time_since_epoch());
+#else // CSCALETIMER == RDTSC || CSCALETIMER == TSC || CSCALETIMER == PERF ||
+      // CSCALETIMER == INST
+    return time;
+#endif // CSCALETIMER
   }
 
   static duration_t burden;
+
+  // Initialize the timer before its first use.
+  static void init() {
+#if CSCALETIMER == TSC
+    tsc_clock_t::calibrate();
+    // Convert the burden from nanoseconds to ticks.
+    burden = static_cast<duration_t>(6250 / tsc_clock_t::ns_per_tick);
+#elif CSCALETIMER == PERF
+    perf_counter_t::init();
+    cilk_time_t::units = perf_counter_t::event->units;
+    burden = perf_counter_t::event->burden;
+#endif // CSCALETIMER
+  }
 };
 
 duration_t cilkscale_timer_t::burden =
@@ -207,31 +372,18 @@ duration_t cilkscale_timer_t::burden =
       15000
 #elif CSCALETIMER == CLOCK
       std::chrono::nanoseconds(6250)
-#else // CSCALETIMER == INST
+#else // CSCALETIMER == INST || CSCALETIMER == TSC || CSCALETIMER == PERF
       6250
 #endif // CSCALETIMER
       ;
 
 static inline duration_t elapsed_time(const cilkscale_timer_t *stop,
                                       const cilkscale_timer_t *start) {
-#if CSCALETIMER == INST
-  return 0;
-#elif CSCALETIMER == CLOCK
+#if CSCALETIMER == CLOCK
   return std::chrono::duration_cast<duration_t>(stop->time - start->time);
 #else
   return stop->time - start->time;
 #endif
 }
 
-static inline void get_bb_time(cilk_time_t *work, cilk_time_t *span,
-                               cilk_time_t *bspan, const csi_id_t bb_id) {
-#if CSCALETIMER == INST
-  duration_t inst_count = static_cast<duration_t>(
-      __csi_get_bb_sizeinfo(bb_id)->ir_cost);
-  *work += inst_count;
-  *span += inst_count;
-  *bspan += inst_count;
-#endif
-}
-
 #endif // INCLUDED_CILKSCALE_TIMER_H
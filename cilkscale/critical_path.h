@@ -0,0 +1,173 @@
+// -*- C++ -*-
+#ifndef INCLUDED_CRITICAL_PATH_H
+#define INCLUDED_CRITICAL_PATH_H
+
+#include <atomic>
+#include <csi/csi.h>
+#include <ostream>
+#include <vector>
+
+#include "cilkscale_timer.h"
+
+// Events that end a strand.  A strand on the critical path is identified by
+// the event that ended it, since that event carries a CSI ID that maps to a
+// source location.
+enum class path_event : uint8_t {
+  FUNC_ENTRY,
+  FUNC_EXIT,
+  DETACH,
+  TASK_EXIT,
+  SYNC,
+  PROBE,
+  EXIT,
+};
+
+// A segment of a path through the computation dag: a maximal run of
+// consecutive strands ended by the same event.  Segments form persistent
+// linked lists that run from the end of a path back to its start, so that
+// different paths can share common prefixes.  Segments are reference counted,
+// because with the parallel tool, paths are shared between workers.
+struct path_segment_t {
+  path_segment_t *prev;
+  std::atomic<int32_t> refs;
+  path_event event;
+  csi_id_t id;
+  cilk_time_t time;
+
+  path_segment_t(path_segment_t *prev, path_event event, csi_id_t id,
+                 const cilk_time_t &time)
+      : prev(prev), refs(1), event(event), id(id), time(time) {}
+};
+
+// Handle to a path through the computation dag, represented by a pointer to
+// its last segment.
+class path_t {
+  path_segment_t *head = nullptr;
+
+  static void inc_ref(path_segment_t *seg) {
+    if (seg)
+      seg->refs.fetch_add(1, std::memory_order_relaxed);
+  }
+  static void dec_ref(path_segment_t *seg) {
+    while (seg && 1 == seg->refs.fetch_sub(1, std::memory_order_acq_rel)) {
+      path_segment_t *prev = seg->prev;
+      delete seg;
+      seg = prev;
+    }
+  }
+
+public:
+  // Set if critical-path tracking is enabled.
+  static inline bool enabled = false;
+
+  path_t() {}
+  path_t(const path_t &copy) : head(copy.head) { inc_ref(head); }
+  path_t(path_t &&move) : head(move.head) { move.head = nullptr; }
+  ~path_t() { dec_ref(head); }
+
+  path_t &operator=(const path_t &copy) {
+    inc_ref(copy.head);
+    dec_ref(head);
+    head = copy.head;
+    return *this;
+  }
+  path_t &operator=(path_t &&move) {
+    if (this != &move) {
+      dec_ref(head);
+      head = move.head;
+      move.head = nullptr;
+    }
+    return *this;
+  }
+
+  void reset() {
+    dec_ref(head);
+    head = nullptr;
+  }
+
+  // Extend this path with a strand of the given duration, ended by the given
+  // event.  Consecutive strands ended by the same event are coalesced, if this
+  // path is the only reference to its last segment.
+  void extend(path_event event, csi_id_t id, const cilk_time_t &time) {
+    if (head && head->event == event && head->id == id &&
+        1 == head->refs.load(std::memory_order_relaxed)) {
+      head->time += time;
+      return;
+    }
+    head = new path_segment_t(head, event, id, time);
+  }
+
+  // Append a copy of the segments of other to this path.
+  void append(const path_t &other) {
+    std::vector<const path_segment_t *> segs;
+    for (const path_segment_t *seg = other.head; seg; seg = seg->prev)
+      segs.push_back(seg);
+    for (auto it = segs.rbegin(); it != segs.rend(); ++it)
+      extend((*it)->event, (*it)->id, (*it)->time);
+  }
+
+  // Get the segments of this path, in order from the start of the path.
+  std::vector<const path_segment_t *> segments() const {
+    std::vector<const path_segment_t *> segs;
+    for (const path_segment_t *seg = head; seg; seg = seg->prev)
+      segs.push_back(seg);
+    return std::vector<const path_segment_t *>(segs.rbegin(), segs.rend());
+  }
+};
+
+static const char *path_event_name(path_event event) {
+  switch (event) {
+  case path_event::FUNC_ENTRY:
+    return "call";
+  case path_event::FUNC_EXIT:
+    return "return";
+  case path_event::DETACH:
+    return "spawn";
+  case path_event::TASK_EXIT:
+    return "task_exit";
+  case path_event::SYNC:
+    return "sync";
+  case path_event::PROBE:
+    return "probe";
+  case path_event::EXIT:
+    return "exit";
+  }
+  return "unknown";
+}
+
+static const source_loc_t *path_event_source_loc(path_event event,
+                                                 csi_id_t id) {
+  switch (event) {
+  case path_event::FUNC_ENTRY:
+    return __csi_get_func_source_loc(id);
+  case path_event::FUNC_EXIT:
+    return __csi_get_func_exit_source_loc(id);
+  case path_event::DETACH:
+    return __csi_get_detach_source_loc(id);
+  case path_event::TASK_EXIT:
+    return __csi_get_task_exit_source_loc(id);
+  case path_event::SYNC:
+    return __csi_get_sync_source_loc(id);
+  default:
+    return nullptr;
+  }
+}
+
+// Write the segments of path to OS as CSV, in order from the start of the
+// path.
+static void print_critical_path(std::ostream &OS, const char *tag,
+                                const path_t &path) {
+  for (const path_segment_t *seg : path.segments()) {
+    OS << tag << "," << path_event_name(seg->event) << ",";
+    const source_loc_t *loc = path_event_source_loc(seg->event, seg->id);
+    if (loc)
+      OS << (loc->name ? loc->name : "") << ","
+         << (loc->filename ? loc->filename : "") << "," << loc->line_number
+         << "," << loc->column_number;
+    else
+      OS << ",,,";
+    OS << "," << seg->time << "\n";
+  }
+}
+
+#endif // INCLUDED_CRITICAL_PATH_H
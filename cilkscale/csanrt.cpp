@@ -15,10 +15,14 @@ typedef struct {
   source_loc_t *entries;
 } fed_table_t;
 
-// Types of FED tables that we maintain across all units.
+// Types of FED tables that we maintain across all units.  The order of these
+// types must match the order of the FED tables emitted by the CSI pass, and the
+// order of the fields of instrumentation_counts_t.
 typedef enum {
   FED_TYPE_FUNCTIONS,
   FED_TYPE_FUNCTION_EXIT,
+  FED_TYPE_LOOP,
+  FED_TYPE_LOOP_EXIT,
   FED_TYPE_BASICBLOCK,
   FED_TYPE_CALLSITE,
   FED_TYPE_LOAD,
@@ -29,9 +33,16 @@ typedef enum {
   FED_TYPE_DETACH_CONTINUE,
   FED_TYPE_SYNC,
   FED_TYPE_ALLOCA,
+  FED_TYPE_ALLOCFN,
+  FED_TYPE_FREE,
   NUM_FED_TYPES // Must be last
 } fed_type_t;
 
+static_assert(sizeof(instrumentation_counts_t) ==
+                  sizeof(csi_id_t) * NUM_FED_TYPES,
+              "Mismatch between NUM_FED_TYPES and size of "
+              "instrumentation_counts_t");
+
 // A SizeInfo table is a flat list of SizeInfo entries, indexed by a CSI ID.
 typedef struct {
   int64_t num_entries;
@@ -68,6 +79,75 @@ static bool sizeinfo_tables_initialized = false;
 // which results in the __csi_init() function being called.
 static bool csi_init_called = false;
 
+// Names of the allocation and free functions, indexed by the allocfn_ty and
+// free_ty properties, respectively.  These tables are copies of those in
+// cilksan/csanrt.cpp; keep the two in sync.  csi/csirt.c has its own tables.
+const char *allocfn_str[] =
+  {
+   "void *malloc(size_t size)",
+   "void *valloc(size_t size)",
+   "void *calloc(size_t count, size_t size)",
+   "void *aligned_alloc(align_val_t, size)",
+   "void *realloc(void *ptr, size_t size)",
+   "void *reallocf(void *ptr, size_t size)",
+   "void *operator new(unsigned int)",
+   "void *operator new(unsigned int, nothrow)",
+   "void *operator new(unsigned long)",
+   "void *operator new(unsigned long, nothrow)",
+   "void *operator new[](unsigned int)",
+   "void *operator new[](unsigned int, nothrow)",
+   "void *operator new[](unsigned long)",
+   "void *operator new[](unsigned long, nothrow)",
+   "void *operator new(unsigned int)",
+   "void *operator new(unsigned int, nothrow)",
+   "void *operator new(unsigned long long)",
+   "void *operator new(unsigned long long, nothrow)",
+   "void *operator new[](unsigned int)",
+   "void *operator new[](unsigned int, nothrow)",
+   "void *operator new[](unsigned long long)",
+   "void *operator new[](unsigned long long, nothrow)",
+   "void *new(unsigned int, align_val_t)",
+   "void *new(unsigned long, align_val_t)",
+   "void *new[](unsigned int, align_val_t)",
+   "void *new[](unsigned long, align_val_t)",
+   "void *new(unsigned int, align_val_t, nothrow)",
+   "void *new(unsigned long, align_val_t, nothrow)",
+   "void *new[](unsigned int, align_val_t, nothrow)",
+   "void *new[](unsigned long, align_val_t, nothrow)",
+   "int posix_memalign(void **memptr, size_t alignment, size_t size)",
+   "char *strdup(const char *str)",
+   "char *strndup(const char *str, size_t size)"
+  };
+
+const char *free_str[] =
+  {
+   "void free(void *ptr)",
+   "void operator delete(void*)",
+   "void operator delete(void*, nothrow)",
+   "void operator delete(void*, unsigned int)",
+   "void operator delete(void*, unsigned long)",
+   "void operator delete[](void*)",
+   "void operator delete[](void*, nothrow)",
+   "void operator delete[](void*, unsigned int)",
+   "void operator delete[](void*, unsigned long)",
+   "void operator delete(void*)",
+   "void operator delete(void*, nothrow)",
+   "void operator delete(void*, unsigned int)",
+   "void operator delete(void*)",
+   "void operator delete(void*, nothrow)",
+   "void operator delete(void*, unsigned long long)",
+   "void operator delete[](void*)",
+   "void operator delete[](void*, nothrow)",
+   "void operator delete[](void*, unsigned int)",
+   "void operator delete[](void*)",
+   "void operator delete[](void*, nothrow)",
+   "void operator delete[](void*, unsigned long long)",
+   "void operator delete(void*, align_val_t)",
+   "void operator delete(void*, align_val_t, nothrow)",
+   "void operator delete[](void*, align_val_t)",
+   "void operator delete[](void*, align_val_t, nothrow)"
+  };
+
 // ------------------------------------------------------------------------
 // Private function definitions
 // ------------------------------------------------------------------------
@@ -342,6 +422,17 @@ __csi_get_func_exit_source_loc(const csi_id_t func_exit_id) {
   return get_fed_entry(FED_TYPE_FUNCTION_EXIT, func_exit_id);
 }
 
+CSIRT_API
+const source_loc_t *__csi_get_loop_source_loc(const csi_id_t loop_id) {
+  return get_fed_entry(FED_TYPE_LOOP, loop_id);
+}
+
+CSIRT_API
+const source_loc_t *
+__csi_get_loop_exit_source_loc(const csi_id_t loop_exit_id) {
+  return get_fed_entry(FED_TYPE_LOOP_EXIT, loop_exit_id);
+}
+
 CSIRT_API
 const source_loc_t *__csi_get_bb_source_loc(const csi_id_t bb_id) {
   return get_fed_entry(FED_TYPE_BASICBLOCK, bb_id);
@@ -352,6 +443,11 @@ const source_loc_t *__csi_get_call_source_loc(const csi_id_t call_id) {
   return get_fed_entry(FED_TYPE_CALLSITE, call_id);
 }
 
+CSIRT_API
+const source_loc_t *__csi_get_callsite_source_loc(const csi_id_t call_id) {
+  return get_fed_entry(FED_TYPE_CALLSITE, call_id);
+}
+
 CSIRT_API
 const source_loc_t *__csi_get_load_source_loc(const csi_id_t load_id) {
   return get_fed_entry(FED_TYPE_LOAD, load_id);
@@ -394,9 +490,31 @@ const source_loc_t *__csi_get_alloca_source_loc(const csi_id_t alloca_id) {
   return get_fed_entry(FED_TYPE_ALLOCA, alloca_id);
 }
 
+CSIRT_API
+const source_loc_t *__csi_get_allocfn_source_loc(const csi_id_t allocfn_id) {
+  return get_fed_entry(FED_TYPE_ALLOCFN, allocfn_id);
+}
+
+CSIRT_API
+const source_loc_t *__csi_get_free_source_loc(const csi_id_t free_id) {
+  return get_fed_entry(FED_TYPE_FREE, free_id);
+}
+
 CSIRT_API
 const sizeinfo_t *__csi_get_bb_sizeinfo(const csi_id_t bb_id) {
   return get_sizeinfo_entry(SIZEINFO_TYPE_BB, bb_id);
 }
 
+CSIRT_API
+__attribute__((pure))
+const char *__csan_get_allocfn_str(const allocfn_prop_t prop) {
+  return allocfn_str[prop.allocfn_ty];
+}
+
+CSIRT_API
+__attribute__((pure))
+const char *__csan_get_free_str(const free_prop_t prop) {
+  return free_str[prop.free_ty];
+}
+
 EXTERN_C_END
@@ -0,0 +1,175 @@
+// -*- C++ -*-
+#ifndef INCLUDED_DAG_H
+#define INCLUDED_DAG_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "cilkscale_timer.h"
+
+// Recording of the computation dag, for replay by the work-stealing scheduler
+// simulator in Cilkscale_vis/dag_sim.py.
+//
+// When CILKSCALE_DAG names a file, Cilkscale logs each strand of the
+// computation together with the event that ended it.  Spawns, task exits,
+// syncs, and calls and returns of spawning functions give the structure of the
+// dag; other events only end strands, and consecutive such strands are
+// coalesced.  If CILKSCALE_DAG_REGION names a region, only executions of
+// regions with that name, delimited by wsp_region_begin() and
+// wsp_region_end(), are recorded.
+//
+// Each shadow stack keeps its own log, and the logs are concatenated when
+// shadow stacks are reduced.  The final log therefore lists the events in the
+// serial order of the computation, regardless of how it was scheduled.
+//
+// File format, in native byte order:
+//
+//   char magic[8] = "CSCLDAG1"
+//   uint32_t units_len
+//   char units[units_len]
+//   double scale             value reported for a raw time of 1
+//   int64_t burden           raw burden of a steal
+//   uint64_t num_records
+//   dag_record_t records[num_records]
+
+enum class dag_event : uint8_t {
+  STRAND,       // Strand ended by an event that does not affect the dag.
+  SPAWN,        // Strand ended by a spawn; the spawned task follows.
+  TASK_EXIT,    // Strand ended by the end of a spawned task.
+  SYNC,         // Strand ended by a sync.
+  CALL,         // Strand ended by a call to a spawning function.
+  RETURN,       // Strand ended by a return from a spawning function.
+  REGION_BEGIN, // Beginning of a recorded region.
+  REGION_END,   // Strand ended by the end of a recorded region.
+};
+
+struct dag_record_t {
+  // Raw duration of the strand that ended with event.
+  int64_t time;
+  dag_event event;
+  uint8_t padding[7];
+};
+static_assert(sizeof(dag_record_t) == 16, "Unexpected size of dag_record_t");
+
+class dag_log_t {
+  std::vector<dag_record_t> records;
+
+public:
+  // Set if dag recording is enabled.
+  static inline bool enabled = false;
+  // Name of the region to record, or null to record the whole computation.
+  static inline const char *region = nullptr;
+  // Number of executions of the recorded region in progress.
+  static inline std::atomic<int32_t> active{0};
+
+  static bool recording() {
+    return enabled &&
+           (!region || active.load(std::memory_order_relaxed) > 0);
+  }
+
+  // Log a strand of the given duration, ended by event.
+  void add(dag_event event, duration_t strand_time) {
+    if (!recording())
+      return;
+    log(event, strand_time);
+  }
+
+  size_t size() const { return records.size(); }
+
+private:
+  void log(dag_event event, duration_t strand_time) {
+    int64_t time = cilk_time_t(strand_time).get_raw_duration();
+    if (!records.empty() && dag_event::STRAND == records.back().event) {
+      records.back().time += time;
+      records.back().event = event;
+      return;
+    }
+    dag_record_t record;
+    memset(&record, 0, sizeof(record));
+    record.time = time;
+    record.event = event;
+    records.push_back(record);
+  }
+
+public:
+  // Log the beginning and end of an execution of a region with the given
+  // name.  Returns true if the region is recorded.
+  bool begin_region(const char *name, duration_t strand_time) {
+    add(dag_event::STRAND, strand_time);
+    if (!enabled || !region || 0 != strcmp(name, region))
+      return false;
+    active.fetch_add(1, std::memory_order_relaxed);
+    add(dag_event::REGION_BEGIN, duration_t(0));
+    return true;
+  }
+  void end_region(duration_t strand_time) {
+    add(dag_event::REGION_END, strand_time);
+    active.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  // Log the end of an execution of a region that began in another log, whose
+  // region is not known to be recorded until the logs are reduced.  Returns the
+  // index of the record that ends the region, or -1 if no record was logged.
+  int64_t end_region_elsewhere(duration_t strand_time) {
+    if (!recording())
+      return -1;
+    log(dag_event::REGION_END, strand_time);
+    return static_cast<int64_t>(records.size()) - 1;
+  }
+  // Resolve the end of a region logged by end_region_elsewhere(), once it is
+  // known whether the region is recorded.
+  void resolve_region_end(int64_t index, bool recorded) {
+    if (recorded)
+      active.fetch_sub(1, std::memory_order_relaxed);
+    else if (index >= 0)
+      records[index].event = dag_event::STRAND;
+  }
+
+  void append(dag_log_t &other) {
+    records.insert(records.end(), other.records.begin(),
+                   other.records.end());
+    other.records.clear();
+  }
+
+  // Write the log to the file at path.  When a region is recorded, records
+  // logged outside of executions of that region, e.g., by computations that
+  // ran in parallel with it, are omitted.
+  bool write(const char *path) const {
+    FILE *out = fopen(path, "wb");
+    if (!out)
+      return false;
+
+    std::vector<dag_record_t> selected;
+    if (region) {
+      int32_t depth = 0;
+      for (const dag_record_t &record : records) {
+        if (dag_event::REGION_BEGIN == record.event)
+          ++depth;
+        if (depth > 0)
+          selected.push_back(record);
+        if (dag_event::REGION_END == record.event && depth > 0)
+          --depth;
+      }
+    }
+    const std::vector<dag_record_t> &output = region ? selected : records;
+
+    uint32_t units_len = static_cast<uint32_t>(strlen(cilk_time_t::units));
+    double scale = cilk_time_t(static_cast<raw_duration_t>(1)).get_scaled_val();
+    int64_t burden = cilk_time_t(cilkscale_timer_t::burden).get_raw_duration();
+    uint64_t num_records = output.size();
+    fwrite("CSCLDAG1", 1, 8, out);
+    fwrite(&units_len, sizeof(units_len), 1, out);
+    fwrite(cilk_time_t::units, 1, units_len, out);
+    fwrite(&scale, sizeof(scale), 1, out);
+    fwrite(&burden, sizeof(burden), 1, out);
+    fwrite(&num_records, sizeof(num_records), 1, out);
+    fwrite(output.data(), sizeof(dag_record_t), output.size(), out);
+    fclose(out);
+    return true;
+  }
+};
+
+#endif // INCLUDED_DAG_H
@@ -0,0 +1,396 @@
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include "burden_calibration.h"
+#include "cilkscale_timer.h"
+#include "serial_tool.h"
+#include <cilk/cilk_api.h>
+#include <csi/csi.h>
+
+#define CILKTOOL_API extern "C" __attribute__((visibility("default")))
+
+#ifndef TRACE_CALLS
+#define TRACE_CALLS 0
+#endif
+
+// Spawn-granularity advisor.
+//
+// The cilkscale-grain tool measures the work of every spawned task, attributed
+// to its detach ID, and the work per iteration of every execution of a
+// parallel loop, attributed to its loop ID.  At exit, it reports each spawn
+// site and parallel loop with the median of these measurements.  Sites whose
+// median work is less than CILKSCALE_GRAIN_THRESHOLD times the burden of a
+// steal (default 10) are flagged as too fine grained, and each parallel loop
+// gets a recommended grainsize that makes the work of a chunk of iterations
+// exceed that threshold.  The report is written as CSV to the file named by
+// CILKSCALE_GRAIN_OUT, or to stderr by default, with the finest-grained sites
+// first.
+//
+// The tool runs the program serially, so the measurements do not include
+// scheduling overheads.  When CILKSCALE_CALIBRATE is set, the tool uses the
+// burden cached by a previous calibration with Cilkscale.
+
+///////////////////////////////////////////////////////////////////////////
+// Data structures for measuring granularity.
+
+// Measurements of a spawn site or parallel loop.  The tool keeps a uniform
+// random sample of at most MAX_SAMPLES measurements from which to estimate the
+// median.
+struct grain_site_t {
+  static constexpr size_t MAX_SAMPLES = 1024;
+
+  // Number of tasks spawned at the site, or of iterations of the loop.
+  uint64_t count = 0;
+  // Number of measurements.
+  uint64_t num_measured = 0;
+  cilk_time_t total_work = cilk_time_t::zero();
+  // Largest trip count of the loop.
+  int64_t max_trip_count = 0;
+  std::vector<double> samples;
+
+  void add(double work, uint64_t &rng) {
+    ++num_measured;
+    if (samples.size() < MAX_SAMPLES) {
+      samples.push_back(work);
+      return;
+    }
+    // Reservoir sampling: replace a random sample with probability
+    // MAX_SAMPLES / num_measured.
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    uint64_t i = rng % num_measured;
+    if (i < MAX_SAMPLES)
+      samples[i] = work;
+  }
+
+  double median() {
+    if (samples.empty())
+      return 0.0;
+    std::nth_element(samples.begin(), samples.begin() + samples.size() / 2,
+                     samples.end());
+    return samples[samples.size() / 2];
+  }
+};
+
+// A spawned task that has started but not yet exited.
+struct open_task_t {
+  csi_id_t detach_id;
+  bool is_loop_body;
+  cilk_time_t start_work;
+};
+
+// An execution of a parallel loop that has started but not yet ended.
+struct open_loop_t {
+  csi_id_t loop_id;
+  int64_t trip_count;
+  // Number of loop-body tasks executed so far, used as the number of
+  // iterations if the trip count is unknown.
+  int64_t num_bodies;
+  cilk_time_t start_work;
+};
+
+// Top-level class to manage the state of the global tool.
+class GrainImpl_t {
+public:
+  // Timers for measuring the execution time of a strand.
+  cilkscale_timer_t start;
+  cilkscale_timer_t stop;
+
+  // Total work executed so far, excluding the time spent in the tool.
+  cilk_time_t work = cilk_time_t::zero();
+
+  std::vector<open_task_t> tasks;
+  std::vector<open_loop_t> loops;
+
+  // Measurements per detach ID and per loop ID.
+  std::vector<grain_site_t> spawns;
+  std::vector<grain_site_t> parallel_loops;
+
+  // Minimum acceptable median work of a site, as a multiple of the burden.
+  double threshold = 10.0;
+
+  uint64_t rng = 0x2545f4914f6cdd1dULL;
+
+  grain_site_t &spawn(csi_id_t detach_id) {
+    if (static_cast<size_t>(detach_id) >= spawns.size())
+      spawns.resize(detach_id + 1);
+    return spawns[detach_id];
+  }
+
+  grain_site_t &parallel_loop(csi_id_t loop_id) {
+    if (static_cast<size_t>(loop_id) >= parallel_loops.size())
+      parallel_loops.resize(loop_id + 1);
+    return parallel_loops[loop_id];
+  }
+
+  // Add the time since the last hook to the total work.
+  void end_strand() {
+    stop.gettime();
+    work += elapsed_time(&stop, &start);
+  }
+
+  void write_report(std::ostream &OS);
+
+  GrainImpl_t();
+  ~GrainImpl_t();
+};
+
+static GrainImpl_t *tool = create_serial_tool<GrainImpl_t>();
+
+bool GRAIN_INITIALIZED = false;
+
+///////////////////////////////////////////////////////////////////////////
+// Report
+
+namespace {
+// A row of the report.
+struct report_row_t {
+  const char *kind;
+  csi_id_t id;
+  const source_loc_t *loc;
+  grain_site_t *site;
+  double median;
+  double ratio;
+  // Recommended grainsize, or 0 for spawn sites.
+  int64_t grainsize;
+};
+} // namespace
+
+void GrainImpl_t::write_report(std::ostream &OS) {
+  double burden = cilk_time_t(cilkscale_timer_t::burden).get_val_d();
+  double scale = cilk_time_t(static_cast<raw_duration_t>(1)).get_scaled_val() /
+                 cilk_time_t(static_cast<raw_duration_t>(1)).get_val_d();
+
+  std::vector<report_row_t> rows;
+  for (size_t i = 0; i < spawns.size(); ++i) {
+    grain_site_t &site = spawns[i];
+    if (!site.count)
+      continue;
+    double median = site.median();
+    rows.push_back({"spawn", static_cast<csi_id_t>(i),
+                    __csi_get_detach_source_loc(i), &site, median,
+                    median / burden, 0});
+  }
+  for (size_t i = 0; i < parallel_loops.size(); ++i) {
+    grain_site_t &site = parallel_loops[i];
+    if (!site.count)
+      continue;
+    double median = site.median();
+    // Choose the smallest grainsize whose chunks of iterations do at least
+    // threshold times the burden of work, up to the largest trip count.
+    double grainsize = static_cast<double>(site.max_trip_count);
+    if (median > 0.0)
+      grainsize = std::min(grainsize, std::ceil(threshold * burden / median));
+    rows.push_back({"parallel_loop", static_cast<csi_id_t>(i),
+                    __csi_get_loop_source_loc(i), &site, median,
+                    median / burden,
+                    std::max<int64_t>(1, static_cast<int64_t>(grainsize))});
+  }
+  std::stable_sort(rows.begin(), rows.end(),
+                   [](const report_row_t &a, const report_row_t &b) {
+                     return a.ratio < b.ratio;
+                   });
+
+  OS << "kind,id,name,file,line,column,count"
+     << ",median_work (" << cilk_time_t::units << ")"
+     << ",total_work (" << cilk_time_t::units << ")"
+     << ",median_work/burden,too_fine,recommended_grainsize\n";
+  for (const report_row_t &row : rows) {
+    OS << row.kind << "," << row.id << ",";
+    if (row.loc)
+      OS << (row.loc->name ? row.loc->name : "") << ","
+         << (row.loc->filename ? row.loc->filename : "") << ","
+         << row.loc->line_number << "," << row.loc->column_number;
+    else
+      OS << ",,,";
+    OS << "," << row.site->count << "," << row.median * scale << ","
+       << row.site->total_work << "," << row.ratio << ","
+       << (row.ratio < threshold ? "yes" : "no") << ",";
+    if (row.grainsize)
+      OS << row.grainsize;
+    OS << "\n";
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////
+// Tool startup and shutdown
+
+GrainImpl_t::GrainImpl_t() {
+  cilkscale_timer_t::init();
+
+  // Use the burden cached by a previous calibration, if requested.
+  bool force_calibration;
+  if (burden_calibration_requested(force_calibration)) {
+    duration_t burden;
+    if (read_cached_burden(burden))
+      cilkscale_timer_t::burden = burden;
+    else
+      fprintf(stderr, "Cilkscale: no calibrated burden is cached for this "
+                      "host; using the default burden.\n");
+  }
+
+  if (const char *envstr = getenv("CILKSCALE_GRAIN_THRESHOLD")) {
+    double value = atof(envstr);
+    if (value > 0.0)
+      threshold = value;
+    else
+      fprintf(stderr, "Cilkscale: ignoring invalid grain threshold %s\n",
+              envstr);
+  }
+
+  start.gettime();
+}
+
+GrainImpl_t::~GrainImpl_t() {
+  // Write the report to the file named by CILKSCALE_GRAIN_OUT, or to stderr by
+  // default.
+  const char *out_file = getenv("CILKSCALE_GRAIN_OUT");
+  std::ofstream outf;
+  if (out_file) {
+    outf.open(out_file);
+    if (!outf.is_open())
+      fprintf(stderr, "Cilkscale: could not open grain report file %s\n",
+              out_file);
+  }
+  if (outf.is_open())
+    write_report(outf);
+  else
+    write_report(std::cerr);
+}
+
+///////////////////////////////////////////////////////////////////////////
+// Hooks for operating the tool.
+
+CILKTOOL_API void __csi_init() {
+#if TRACE_CALLS
+  fprintf(stderr, "__csi_init()\n");
+#endif
+
+  start_serial_tool<GrainImpl_t, tool, GRAIN_INITIALIZED>();
+}
+
+CILKTOOL_API void __csi_unit_init(const char *const file_name,
+                                  const instrumentation_counts_t counts) {
+  return;
+}
+
+CILKTOOL_API
+void __csi_before_loop(const csi_id_t loop_id, const int64_t trip_count,
+                       const loop_prop_t prop) {
+  if (!GRAIN_INITIALIZED || !tool)
+    return;
+  if (!prop.is_tapir_loop)
+    return;
+
+  tool->end_strand();
+
+#if TRACE_CALLS
+  fprintf(stderr, "before_loop(%ld, %ld)\n", loop_id, trip_count);
+#endif
+
+  tool->loops.push_back({loop_id, trip_count, 0, tool->work});
+
+  tool->start.gettime();
+}
+
+CILKTOOL_API
+void __csi_after_loop(const csi_id_t loop_id, const loop_prop_t prop) {
+  if (!GRAIN_INITIALIZED || !tool)
+    return;
+  if (!prop.is_tapir_loop)
+    return;
+
+  tool->end_strand();
+
+#if TRACE_CALLS
+  fprintf(stderr, "after_loop(%ld)\n", loop_id);
+#endif
+
+  // Close any loops exited without their after_loop hook, e.g., by an
+  // exception.
+  std::vector<open_loop_t> &loops = tool->loops;
+  while (!loops.empty() && loops.back().loop_id != loop_id)
+    loops.pop_back();
+
+  if (!loops.empty()) {
+    const open_loop_t &loop = loops.back();
+    int64_t iterations =
+        (loop.trip_count > 0) ? loop.trip_count : loop.num_bodies;
+    if (iterations > 0) {
+      cilk_time_t loop_work = tool->work - loop.start_work;
+      grain_site_t &site = tool->parallel_loop(loop_id);
+      site.count += iterations;
+      site.total_work += loop_work;
+      site.max_trip_count = std::max(site.max_trip_count, iterations);
+      site.add(loop_work.get_val_d() / iterations, tool->rng);
+    }
+    loops.pop_back();
+  }
+
+  tool->start.gettime();
+}
+
+CILKTOOL_API
+void __csi_task(const csi_id_t task_id, const csi_id_t detach_id,
+                const task_prop_t prop) {
+  if (!GRAIN_INITIALIZED || !tool)
+    return;
+
+  tool->end_strand();
+
+#if TRACE_CALLS
+  fprintf(stderr, "task(%ld, %ld)\n", task_id, detach_id);
+#endif
+
+  if (prop.is_tapir_loop_body && !tool->loops.empty())
+    ++tool->loops.back().num_bodies;
+  tool->tasks.push_back(
+      {detach_id, prop.is_tapir_loop_body != 0, tool->work});
+
+  tool->start.gettime();
+}
+
+CILKTOOL_API
+void __csi_task_exit(const csi_id_t task_exit_id, const csi_id_t task_id,
+                     const csi_id_t detach_id, const unsigned sync_reg,
+                     const task_exit_prop_t prop) {
+  if (!GRAIN_INITIALIZED || !tool)
+    return;
+
+  tool->end_strand();
+
+#if TRACE_CALLS
+  fprintf(stderr, "task_exit(%ld, %ld, %ld)\n", task_exit_id, task_id,
+          detach_id);
+#endif
+
+  // Close any tasks exited without their task_exit hook, e.g., by an
+  // exception.
+  std::vector<open_task_t> &tasks = tool->tasks;
+  while (!tasks.empty() && tasks.back().detach_id != detach_id)
+    tasks.pop_back();
+
+  if (!tasks.empty()) {
+    const open_task_t &task = tasks.back();
+    // Iterations of parallel loops are measured by the loop hooks.
+    if (!task.is_loop_body) {
+      cilk_time_t task_work = tool->work - task.start_work;
+      grain_site_t &site = tool->spawn(detach_id);
+      ++site.count;
+      site.total_work += task_work;
+      site.add(task_work.get_val_d(), tool->rng);
+    }
+    tasks.pop_back();
+  }
+
+  tool->start.gettime();
+}
@@ -0,0 +1,412 @@
+// -*- C++ -*-
+#ifndef INCLUDED_LOCKS_H
+#define INCLUDED_LOCKS_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+#include <csi/csi.h>
+
+#include "cilkscale_timer.h"
+
+// Analysis of lock contention, performed by the cilkscale-locks tool.
+//
+// The tool interposes the mutex functions to measure, per lock and per
+// acquisition site, the time spent waiting to acquire the lock and the time
+// the lock is held.  Waiting is excluded from the work and span of the
+// program, as it would vanish if the lock were split.
+//
+// The tool also bounds how much span each lock adds by serializing logically
+// parallel strands.  Critical sections of the same lock run one at a time, so
+// any part of the computation takes at least the total time that the lock is
+// held in it.  For each lock L, the tool computes a lock-aware span,
+// maintained alongside the span on the shadow stack, in which each sync block
+// -- the strands and children of a function between two syncs -- ends no
+// sooner than its start plus the time L is held within the block.  The
+// lock-aware span is a lower bound on the running time with L on any number
+// of processors, so its excess over the span bounds from below the span L
+// adds, and the work divided by the lock-aware span bounds the parallelism
+// that L allows.
+
+// Lock-aware span of one lock in a shadow-stack frame.  A frame records only
+// locks whose lock-aware span exceeds its span or that are held in the frame;
+// other locks' lock-aware spans equal the span of the frame.
+struct lock_span_t {
+  uintptr_t lock;
+  // Excess of the lock-aware span of the continuation over contin_span.
+  cilk_time_t contin_excess = cilk_time_t::zero();
+  // Longest lock-aware span of an outstanding spawned child.
+  cilk_time_t lchild_span = cilk_time_t::zero();
+  // Time the lock is held in the current sync block, and the lock-aware span
+  // at which the first critical section of the block can start.  Every later
+  // critical section of the block starts no earlier.
+  cilk_time_t block_hold = cilk_time_t::zero();
+  cilk_time_t block_start = cilk_time_t::zero();
+  // Time the lock is held in the frame so far, and the lock-aware span at
+  // which the first critical section of the frame can start.
+  cilk_time_t hold = cilk_time_t::zero();
+  cilk_time_t first_start = cilk_time_t::zero();
+
+  explicit lock_span_t(uintptr_t lock) : lock(lock) {}
+
+  cilk_time_t contin_span(const cilk_time_t &span) const {
+    return span + contin_excess;
+  }
+
+  // Get the lock-aware span at the end of the current sync block, where span
+  // is the span at its end.
+  cilk_time_t block_end(const cilk_time_t &span) const {
+    cilk_time_t end = contin_span(span);
+    if (block_hold > cilk_time_t::zero() && block_start + block_hold > end)
+      end = block_start + block_hold;
+    return end;
+  }
+
+  // Add critical sections that take time hold and can start no earlier than
+  // lock-aware span start.
+  void add_hold(const cilk_time_t &start, const cilk_time_t &hold_time) {
+    if (cilk_time_t::zero() == block_hold)
+      block_start = start;
+    if (cilk_time_t::zero() == hold)
+      first_start = start;
+    block_hold += hold_time;
+    hold += hold_time;
+  }
+};
+
+class lock_spans_t {
+  std::vector<lock_span_t> spans;
+
+  lock_span_t &get(uintptr_t lock) {
+    for (lock_span_t &span : spans)
+      if (span.lock == lock)
+        return span;
+    spans.emplace_back(lock);
+    return spans.back();
+  }
+
+  static cilk_time_t max(const cilk_time_t &a, const cilk_time_t &b) {
+    return a > b ? a : b;
+  }
+
+public:
+  // Set if lock-aware spans are computed.
+  static inline bool enabled = false;
+
+  const std::vector<lock_span_t> &get_spans() const { return spans; }
+
+  void reset() { spans.clear(); }
+
+  // Start a frame that continues the frame parent.
+  void inherit(const lock_spans_t &parent) {
+    for (const lock_span_t &p : parent.spans) {
+      if (cilk_time_t::zero() == p.contin_excess)
+        continue;
+      spans.emplace_back(p.lock);
+      spans.back().contin_excess = p.contin_excess;
+    }
+  }
+
+  // Record that lock was held for time hold, starting when the frame was at
+  // span contin_span.  The tool ends a strand when a lock is acquired, so the
+  // critical section began at contin_span.
+  void add_hold(uintptr_t lock, duration_t hold,
+                const cilk_time_t &contin_span) {
+    lock_span_t &span = get(lock);
+    span.add_hold(span.contin_span(contin_span), hold);
+  }
+
+  // Account for a sync that raised the span of the frame from contin_span to
+  // new_span, where lchild_span is the span of the longest synced child.
+  void sync(const cilk_time_t &contin_span, const cilk_time_t &lchild_span,
+            const cilk_time_t &new_span) {
+    for (lock_span_t &span : spans) {
+      cilk_time_t lspan = max(max(span.block_end(contin_span), lchild_span),
+                              span.lchild_span);
+      span.contin_excess = lspan - new_span;
+      span.block_hold = cilk_time_t::zero();
+      span.lchild_span = cilk_time_t::zero();
+    }
+  }
+
+  // Account for the return of the called frame callee, which continues this
+  // frame.
+  void add_callee(const lock_spans_t &callee) {
+    for (const lock_span_t &c : callee.spans) {
+      lock_span_t &span = get(c.lock);
+      span.contin_excess = c.contin_excess;
+      if (c.hold > cilk_time_t::zero())
+        span.add_hold(c.first_start, c.hold);
+    }
+  }
+
+  // Account for the end of the spawned frame child, whose span is child_span.
+  void add_child(const lock_spans_t &child, const cilk_time_t &child_span) {
+    for (const lock_span_t &c : child.spans) {
+      lock_span_t &span = get(c.lock);
+      span.lchild_span = max(span.lchild_span, c.contin_span(child_span));
+      if (c.hold > cilk_time_t::zero())
+        span.add_hold(c.first_start, c.hold);
+    }
+  }
+
+  // Append the frame right, whose spans are relative to contin_span of this
+  // frame, to this frame.  The longest child of right has span lchild_span
+  // relative to the same.
+  void append(const lock_spans_t &right, const cilk_time_t &contin_span,
+              const cilk_time_t &lchild_span) {
+    for (lock_span_t &span : spans)
+      span.lchild_span =
+          max(span.lchild_span, span.contin_span(contin_span) + lchild_span);
+    for (const lock_span_t &r : right.spans) {
+      lock_span_t &span = get(r.lock);
+      cilk_time_t offset = span.contin_span(contin_span);
+      span.lchild_span = max(span.lchild_span, offset + r.lchild_span);
+      if (r.hold > cilk_time_t::zero())
+        span.add_hold(offset + r.first_start, r.hold);
+      span.contin_excess += r.contin_excess;
+    }
+  }
+};
+
+// Contention statistics of a lock or an acquisition site.
+struct lock_stats_t {
+  uint64_t acquisitions = 0;
+  // Acquisitions that found the lock held.
+  uint64_t contended = 0;
+  cilk_time_t wait = cilk_time_t::zero();
+  cilk_time_t hold = cilk_time_t::zero();
+
+  void merge(const lock_stats_t &other) {
+    acquisitions += other.acquisitions;
+    contended += other.contended;
+    wait += other.wait;
+    hold += other.hold;
+  }
+};
+
+// A lock held by a worker.
+struct held_lock_t {
+  cilkscale_timer_t acquired;
+  // Span of the acquiring frame when the lock was acquired.
+  cilk_time_t span;
+  csi_id_t site;
+  // Number of nested acquisitions of a recursive lock.
+  unsigned depth;
+};
+
+// Contention statistics gathered by one worker.  Each worker updates only its
+// own statistics, which are merged when the report is written.
+//
+// The locks held by a worker are also kept here.  A lock acquired before a
+// spawn whose continuation is stolen can be released on a different worker,
+// which then removes the lock from this worker's held table, so the table is
+// protected by held_mutex.
+struct alignas(64) lock_worker_t {
+  std::unordered_map<uintptr_t, lock_stats_t> locks;
+  std::unordered_map<csi_id_t, lock_stats_t> sites;
+  std::mutex held_mutex;
+  std::unordered_map<uintptr_t, held_lock_t> held;
+
+  // Record the acquisition of lock.  Returns true if this acquisition starts
+  // a hold, rather than nesting in a hold of a recursive lock by this worker.
+  bool record_acquire(uintptr_t lock, csi_id_t site,
+                      const cilkscale_timer_t &acquired,
+                      const cilk_time_t &span, bool contended,
+                      duration_t wait) {
+    {
+      std::lock_guard<std::mutex> guard(held_mutex);
+      auto held_it = held.find(lock);
+      if (held_it != held.end()) {
+        ++held_it->second.depth;
+        return false;
+      }
+      held.emplace(lock, held_lock_t{acquired, span, site, 1});
+    }
+    for (lock_stats_t *stats : {&locks[lock], &sites[site]}) {
+      ++stats->acquisitions;
+      if (contended) {
+        ++stats->contended;
+        stats->wait += wait;
+      }
+    }
+    return true;
+  }
+
+  // Release one nesting level of lock, if this worker holds it.  Returns false
+  // if this worker does not hold lock.  Otherwise, if the release ends the
+  // hold, removes lock from the held table and sets ended to its entry.
+  bool release_held(uintptr_t lock, std::optional<held_lock_t> &ended) {
+    std::lock_guard<std::mutex> guard(held_mutex);
+    auto held_it = held.find(lock);
+    if (held_it == held.end())
+      return false;
+    if (0 == --held_it->second.depth) {
+      ended = held_it->second;
+      held.erase(held_it);
+    }
+    return true;
+  }
+
+  // Add the time hold that lock was held, after being acquired at site.
+  void record_hold(uintptr_t lock, csi_id_t site, duration_t hold) {
+    locks[lock].hold += hold;
+    sites[site].hold += hold;
+  }
+};
+
+class lock_table_t {
+  std::vector<lock_worker_t> workers;
+  // Number of locks held by all workers, which lets releases of locks that
+  // are not analyzed skip the search of the held tables.
+  std::atomic<uint64_t> num_held{0};
+
+public:
+  explicit lock_table_t(unsigned nworkers) : workers(nworkers) {}
+
+  // Get the statistics of worker, or null if worker is out of range, e.g.,
+  // because the calling thread is not a Cilk worker.
+  lock_worker_t *get_worker(unsigned worker) {
+    return worker < workers.size() ? &workers[worker] : nullptr;
+  }
+
+  // Record the acquisition of lock by worker.
+  void record_acquire(lock_worker_t &worker, uintptr_t lock, csi_id_t site,
+                      const cilkscale_timer_t &acquired,
+                      const cilk_time_t &span, bool contended,
+                      duration_t wait) {
+    if (worker.record_acquire(lock, site, acquired, span, contended, wait))
+      num_held.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // Record the release of lock by worker at time released, when the releasing
+  // frame is at span release_span.  The lock is looked up first among the
+  // locks held by worker, and then among those held by other workers, as it
+  // may have been acquired before a spawn whose continuation was stolen.
+  // Returns true, and sets hold to the time the lock was held and span to the
+  // span at which the critical section began, if this release ends the hold.
+  bool record_release(lock_worker_t &worker, uintptr_t lock,
+                      cilkscale_timer_t &released,
+                      const cilk_time_t &release_span, duration_t &hold,
+                      cilk_time_t &span) {
+    if (0 == num_held.load(std::memory_order_relaxed))
+      return false;
+    std::optional<held_lock_t> ended;
+    bool local = worker.release_held(lock, ended);
+    if (!local) {
+      bool found = false;
+      for (lock_worker_t &other : workers)
+        if (&other != &worker && (found = other.release_held(lock, ended)))
+          break;
+      if (!found)
+        // The lock was acquired outside of instrumented code.
+        return false;
+    }
+    if (!ended)
+      return false;
+    num_held.fetch_sub(1, std::memory_order_relaxed);
+    hold = elapsed_time(&released, &ended->acquired);
+    if (local)
+      span = ended->span;
+    else
+      // The span at which the lock was acquired belongs to another view of
+      // the shadow stack.  Place the critical section so that it ends at the
+      // release instead.
+      span = release_span > hold ? release_span - hold : cilk_time_t::zero();
+    worker.record_hold(lock, ended->site, hold);
+    return true;
+  }
+
+  // Write the report of lock contention for a computation with the given work
+  // and span, where spans lists the lock-aware spans.
+  void write(std::ostream &OS, const cilk_time_t &work, const cilk_time_t &span,
+             const std::vector<lock_span_t> &spans) const {
+    std::unordered_map<uintptr_t, lock_stats_t> locks;
+    std::unordered_map<csi_id_t, lock_stats_t> sites;
+    for (const lock_worker_t &worker : workers) {
+      for (const auto &lock : worker.locks)
+        locks[lock.first].merge(lock.second);
+      for (const auto &site : worker.sites)
+        sites[site.first].merge(site.second);
+    }
+
+    struct lock_row_t {
+      uintptr_t lock;
+      const lock_stats_t *stats;
+      cilk_time_t lspan;
+    };
+    std::vector<lock_row_t> lock_rows;
+    for (const auto &lock : locks) {
+      cilk_time_t lspan = span;
+      for (const lock_span_t &entry : spans)
+        if (entry.lock == lock.first)
+          lspan = entry.block_end(span);
+      lock_rows.push_back({lock.first, &lock.second, lspan});
+    }
+    // Rank locks by the span they add, and then by the time they are held.
+    std::sort(lock_rows.begin(), lock_rows.end(),
+              [](const lock_row_t &a, const lock_row_t &b) {
+                if (!(a.lspan == b.lspan))
+                  return a.lspan > b.lspan;
+                if (!(a.stats->hold == b.stats->hold))
+                  return a.stats->hold > b.stats->hold;
+                return a.lock < b.lock;
+              });
+
+    OS << "lock,acquisitions,contended"
+       << ",wait (" << cilk_time_t::units << ")"
+       << ",hold (" << cilk_time_t::units << ")"
+       << ",lock_span (" << cilk_time_t::units << ")"
+       << ",added_span (" << cilk_time_t::units << ")"
+       << ",parallelism_limit\n";
+    for (const lock_row_t &row : lock_rows)
+      OS << "0x" << std::hex << row.lock << std::dec << ","
+         << row.stats->acquisitions << "," << row.stats->contended << ","
+         << row.stats->wait << "," << row.stats->hold << "," << row.lspan
+         << "," << row.lspan - span << ","
+         << work.get_val_d() / row.lspan.get_val_d() << "\n";
+
+    struct site_row_t {
+      csi_id_t site;
+      const lock_stats_t *stats;
+    };
+    std::vector<site_row_t> site_rows;
+    for (const auto &site : sites)
+      site_rows.push_back({site.first, &site.second});
+    // Rank sites by the time spent waiting for and holding locks.
+    std::sort(site_rows.begin(), site_rows.end(),
+              [](const site_row_t &a, const site_row_t &b) {
+                cilk_time_t a_time = a.stats->wait + a.stats->hold;
+                cilk_time_t b_time = b.stats->wait + b.stats->hold;
+                if (!(a_time == b_time))
+                  return a_time > b_time;
+                return a.site < b.site;
+              });
+
+    OS << "\nsite,name,file,line,column,acquisitions,contended"
+       << ",wait (" << cilk_time_t::units << ")"
+       << ",hold (" << cilk_time_t::units << ")\n";
+    for (const site_row_t &row : site_rows) {
+      OS << row.site << ",";
+      const source_loc_t *loc = (UNKNOWN_CSI_ID == row.site)
+                                    ? nullptr
+                                    : __csi_get_callsite_source_loc(row.site);
+      if (loc)
+        OS << (loc->name ? loc->name : "") << ","
+           << (loc->filename ? loc->filename : "") << "," << loc->line_number
+           << "," << loc->column_number;
+      else
+        OS << ",,,";
+      OS << "," << row.stats->acquisitions << "," << row.stats->contended
+         << "," << row.stats->wait << "," << row.stats->hold << "\n";
+    }
+  }
+};
+
+#endif // INCLUDED_LOCKS_H
@@ -0,0 +1,184 @@
+// -*- C++ -*-
+#ifndef INCLUDED_PARALLELISM_PROFILE_H
+#define INCLUDED_PARALLELISM_PROFILE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+#include "cilkscale_timer.h"
+
+// Profile of the parallelism of the computation over the execution of its
+// serial elision, enabled by the CILKSCALE_PARALLELISM environment variable.
+//
+// Cilkscale logs each strand with its work and the span from the start of the
+// computation to the start and end of the strand, which places the strand in
+// an ideal schedule of the dag on infinitely many processors.  At exit, the
+// serial elision's execution, measured in work, is divided into buckets, and
+// the parallelism of each bucket is the average number of strands running
+// alongside the strands of that bucket in the ideal schedule.
+//
+// Each shadow stack keeps its own log.  The spans in a log are relative to the
+// start of that shadow stack, and they are offset by the span of the preceding
+// shadow stack when the logs are concatenated in reduce(), so the final log
+// lists the strands in serial order with spans from the start of the
+// computation.  To bound memory, consecutive strands are coalesced once a log
+// holds MAX_SAMPLES samples.
+
+struct parallelism_sample_t {
+  int64_t work;
+  int64_t span_begin;
+  int64_t span_end;
+
+  void merge(const parallelism_sample_t &next) {
+    work += next.work;
+    span_begin = std::min(span_begin, next.span_begin);
+    span_end = std::max(span_end, next.span_end);
+  }
+};
+
+class parallelism_log_t {
+  static constexpr size_t MAX_SAMPLES = 1 << 20;
+
+  std::vector<parallelism_sample_t> samples;
+  // Strands are coalesced into the last sample until it has this much work.
+  int64_t grain = 0;
+
+  // Halve the number of samples by merging adjacent pairs.
+  void compact() {
+    size_t n = 0;
+    int64_t total = 0;
+    for (size_t i = 0; i < samples.size(); i += 2) {
+      samples[n] = samples[i];
+      if (i + 1 < samples.size())
+        samples[n].merge(samples[i + 1]);
+      total += samples[n].work;
+      ++n;
+    }
+    samples.resize(n);
+    grain = std::max(grain, total / static_cast<int64_t>(n));
+  }
+
+public:
+  // Set if the parallelism profile is enabled.
+  static inline bool enabled = false;
+
+  // Log a strand of the given duration that ends at span span_end.
+  void add(duration_t strand_time, const cilk_time_t &span_end) {
+    if (!enabled)
+      return;
+    int64_t work = cilk_time_t(strand_time).get_raw_duration();
+    if (work <= 0)
+      return;
+    int64_t end = span_end.get_raw_duration();
+    parallelism_sample_t sample = {work, end - work, end};
+    if (!samples.empty() && samples.back().work < grain) {
+      samples.back().merge(sample);
+      return;
+    }
+    samples.push_back(sample);
+    if (samples.size() >= MAX_SAMPLES)
+      compact();
+  }
+
+  // Append the samples of other, whose spans are relative to span_offset.
+  void append(parallelism_log_t &other, const cilk_time_t &span_offset) {
+    int64_t offset = span_offset.get_raw_duration();
+    for (parallelism_sample_t sample : other.samples) {
+      sample.span_begin += offset;
+      sample.span_end += offset;
+      samples.push_back(sample);
+    }
+    other.samples.clear();
+    grain = std::max(grain, other.grain);
+    while (samples.size() >= MAX_SAMPLES)
+      compact();
+  }
+
+  // Write the profile to OS as CSV, with the given number of buckets.
+  void write(std::ostream &OS, unsigned num_buckets) const {
+    // Compute the concurrency of an ideal schedule of the computation on
+    // infinitely many processors, in which each strand runs at its depth in
+    // the dag: the concurrency at span d is the total density, i.e., work per
+    // unit of span, of the samples that cover d.  The concurrency is piecewise
+    // constant, and concurrency_integral(d) gives its integral up to d.
+    std::vector<std::pair<int64_t, double>> steps;
+    steps.reserve(2 * samples.size());
+    double total = 0.0;
+    for (const parallelism_sample_t &sample : samples) {
+      double density = static_cast<double>(sample.work) /
+                       (sample.span_end - sample.span_begin);
+      steps.emplace_back(sample.span_begin, density);
+      steps.emplace_back(sample.span_end, -density);
+      total += sample.work;
+    }
+    std::sort(steps.begin(), steps.end());
+    std::vector<int64_t> depths;
+    std::vector<double> integral, concurrency;
+    double c = 0.0, area = 0.0;
+    for (size_t i = 0; i < steps.size(); ++i) {
+      if (!depths.empty())
+        area += c * (steps[i].first - depths.back());
+      c += steps[i].second;
+      if (depths.empty() || depths.back() != steps[i].first) {
+        depths.push_back(steps[i].first);
+        integral.push_back(area);
+        concurrency.push_back(c);
+      } else {
+        concurrency.back() = c;
+      }
+    }
+    auto concurrency_integral = [&](double d) {
+      size_t i = std::upper_bound(depths.begin(), depths.end(), d) -
+                 depths.begin();
+      if (0 == i)
+        return 0.0;
+      return integral[i - 1] + concurrency[i - 1] * (d - depths[i - 1]);
+    };
+
+    // Divide the serial execution into buckets of equal work.  The
+    // parallelism of a bucket is the average concurrency at which its work
+    // runs in the ideal schedule.  The span of each sample is interpolated
+    // linearly over its work.
+    if (0.0 == total)
+      num_buckets = 0;
+    std::vector<double> work(num_buckets, 0.0), weighted(num_buckets, 0.0);
+    double width = total / num_buckets;
+    double pos = 0.0;
+    for (const parallelism_sample_t &sample : samples) {
+      double begin = pos, end = pos + sample.work;
+      double span_per_work =
+          static_cast<double>(sample.span_end - sample.span_begin) /
+          sample.work;
+      double density = 1.0 / span_per_work;
+      size_t b = std::min<size_t>(begin / width, num_buckets - 1);
+      for (; b < num_buckets && b * width < end; ++b) {
+        double lo = std::max(begin, b * width);
+        double hi =
+            (b + 1 == num_buckets) ? end : std::min(end, (b + 1) * width);
+        if (hi <= lo)
+          continue;
+        work[b] += hi - lo;
+        weighted[b] +=
+            density *
+            (concurrency_integral(sample.span_begin +
+                                  (hi - begin) * span_per_work) -
+             concurrency_integral(sample.span_begin +
+                                  (lo - begin) * span_per_work));
+      }
+      pos = end;
+    }
+
+    double scale = cilk_time_t(static_cast<raw_duration_t>(1)).get_scaled_val();
+    OS << "work_begin (" << cilk_time_t::units << ")"
+       << ",work_end (" << cilk_time_t::units << ")"
+       << ",parallelism\n";
+    for (unsigned b = 0; b < num_buckets; ++b)
+      OS << b * width * scale << "," << (b + 1) * width * scale << ","
+         << weighted[b] / work[b] << "\n";
+  }
+};
+
+#endif // INCLUDED_PARALLELISM_PROFILE_H
@@ -0,0 +1,186 @@
+// -*- C++ -*-
+#ifndef INCLUDED_PERF_COUNTER_H
+#define INCLUDED_PERF_COUNTER_H
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <linux/perf_event.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Hardware performance counter, read through the Linux perf_event interface,
+// used by the cilkscale-perf tool to measure work and span in terms of a
+// hardware event rather than time.
+//
+// The event is selected by the CILKSCALE_PERF_EVENT environment variable,
+// which may be "instructions" (the default), "cycles", or "llc-misses".  Each
+// thread opens its own counter the first time it reads it, and the counter
+// counts only user-space events of that thread.  Where the kernel permits it,
+// counters are read from user space with rdpmc; otherwise they are read with
+// read().  If the counter cannot be opened, e.g., because of
+// perf_event_paranoid settings, then the tool falls back to measuring time
+// with CLOCK_MONOTONIC, in nanoseconds.  If the counter opened at startup but
+// cannot be opened by a later thread, then the tool aborts, rather than mix
+// that thread's measurements with counts from other threads.
+struct perf_counter_t {
+  struct event_t {
+    const char *name;
+    uint32_t type;
+    uint64_t config;
+    // Units and scale for reporting counts.
+    const char *units;
+    double scale_factor;
+    // Default burden, in counts of this event.
+    int64_t burden;
+  };
+
+  static constexpr event_t events[] = {
+      {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS,
+       "Minstructions", 1000000.0, 6250},
+      {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, "Gcycles",
+       1000000000.0, 15000},
+      {"llc-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES,
+       "Kmisses", 1000.0, 100},
+  };
+  static constexpr event_t fallback_event = {
+      "time", 0, 0, "seconds", 1000000000.0, 6250};
+
+  // Selected event, or the fallback if counters are unavailable.
+  static inline const event_t *event = &events[0];
+  static inline bool available = false;
+
+  // Per-thread counter state.
+  struct thread_counter_t {
+    int fd = -1;
+    perf_event_mmap_page *page = nullptr;
+    bool opened = false;
+
+    ~thread_counter_t() {
+      if (page)
+        munmap(page, sysconf(_SC_PAGESIZE));
+      if (fd >= 0)
+        close(fd);
+    }
+  };
+
+  static thread_counter_t &thread_counter() {
+    static thread_local thread_counter_t counter;
+    return counter;
+  }
+
+  static int open_counter(const event_t *ev) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = ev->type;
+    attr.config = ev->config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+  }
+
+  static bool open_thread_counter(thread_counter_t &counter) {
+    counter.opened = true;
+    counter.fd = open_counter(event);
+    if (counter.fd < 0)
+      return false;
+    // Map the control page of the counter, to read the counter with rdpmc.
+    void *page = mmap(nullptr, sysconf(_SC_PAGESIZE), PROT_READ, MAP_SHARED,
+                      counter.fd, 0);
+    if (MAP_FAILED != page)
+      counter.page = static_cast<perf_event_mmap_page *>(page);
+    return true;
+  }
+
+  // Select the event and check that its counter can be opened.
+  static void init() {
+    event = &events[0];
+    if (const char *envstr = getenv("CILKSCALE_PERF_EVENT")) {
+      event = nullptr;
+      for (const event_t &ev : events)
+        if (0 == strcmp(envstr, ev.name))
+          event = &ev;
+      if (!event) {
+        fprintf(stderr,
+                "Cilkscale: unknown CILKSCALE_PERF_EVENT %s; using %s\n",
+                envstr, events[0].name);
+        event = &events[0];
+      }
+    }
+
+    available = open_thread_counter(thread_counter());
+    if (!available) {
+      fprintf(stderr,
+              "Cilkscale: could not open %s counter (%s); measuring time "
+              "instead\n",
+              event->name, strerror(errno));
+      event = &fallback_event;
+    }
+  }
+
+#if defined(__x86_64__) || defined(__i386__)
+  static uint64_t rdpmc(uint32_t counter) {
+    uint32_t low, high;
+    asm volatile("rdpmc" : "=a"(low), "=d"(high) : "c"(counter));
+    return static_cast<uint64_t>(high) << 32 | low;
+  }
+#endif
+
+  static int64_t read_counter(thread_counter_t &counter) {
+#if defined(__x86_64__) || defined(__i386__)
+    if (perf_event_mmap_page *pc = counter.page) {
+      // Read the counter from user space, using the protocol described in
+      // linux/perf_event.h.
+      uint32_t seq, idx;
+      int64_t count;
+      do {
+        seq = pc->lock;
+        asm volatile("" ::: "memory");
+        idx = pc->index;
+        count = pc->offset;
+        if (pc->cap_user_rdpmc && idx) {
+          uint16_t width = pc->pmc_width;
+          int64_t pmc = rdpmc(idx - 1);
+          pmc <<= 64 - width;
+          pmc >>= 64 - width;
+          count += pmc;
+        } else {
+          count = -1;
+        }
+        asm volatile("" ::: "memory");
+      } while (pc->lock != seq);
+      if (count >= 0)
+        return count;
+    }
+#endif
+    uint64_t value = 0;
+    if (sizeof(value) != ::read(counter.fd, &value, sizeof(value)))
+      return 0;
+    return value;
+  }
+
+  static int64_t now() {
+    if (__builtin_expect(!available, false)) {
+      struct timespec ts;
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+      return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+    }
+    thread_counter_t &counter = thread_counter();
+    if (__builtin_expect(!counter.opened, false)) {
+      if (!open_thread_counter(counter)) {
+        fprintf(stderr,
+                "Cilkscale: could not open %s counter for a new thread (%s)\n",
+                event->name, strerror(errno));
+        abort();
+      }
+    }
+    return read_counter(counter);
+  }
+};
+
+#endif // INCLUDED_PERF_COUNTER_H
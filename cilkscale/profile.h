@@ -0,0 +1,192 @@
+// -*- C++ -*-
+#ifndef INCLUDED_PROFILE_H
+#define INCLUDED_PROFILE_H
+
+#include <algorithm>
+#include <csi/csi.h>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+#include "cilkscale_timer.h"
+
+// Per-ID work, span, and burdened-span profile.  Cilkscale attributes the work
+// and span of every execution of a function that may spawn to that function's
+// CSI ID, and the work and span of every spawned task or parallel-loop body to
+// the CSI ID of its detach.  Measurements are inclusive, i.e., the work and
+// span of a function include those of all functions it calls.  As a result,
+// the measurements of a recursive function count nested invocations multiple
+// times.
+
+// Kinds of program locations in the profile.
+enum class profile_kind : uint8_t {
+  NONE,
+  FUNCTION,
+  SPAWN,
+  LOOP,
+};
+
+// Aggregated measurements for a single CSI ID.
+struct profile_entry_t {
+  uint64_t count = 0;
+  cilk_time_t work = cilk_time_t::zero();
+  cilk_time_t span = cilk_time_t::zero();
+  cilk_time_t bspan = cilk_time_t::zero();
+
+  void add(const cilk_time_t &w, const cilk_time_t &s, const cilk_time_t &b) {
+    ++count;
+    work += w;
+    span += s;
+    bspan += b;
+  }
+
+  void merge(const profile_entry_t &other) {
+    count += other.count;
+    work += other.work;
+    span += other.span;
+    bspan += other.bspan;
+  }
+};
+
+// Profile tables local to one worker thread.  Each worker updates only its own
+// tables, so no synchronization is needed on the hot path.
+struct local_profile_t {
+  std::vector<profile_entry_t> funcs;
+  std::vector<profile_entry_t> detaches;
+  std::vector<profile_kind> detach_kinds;
+
+  profile_entry_t &func(csi_id_t func_id) {
+    if (static_cast<size_t>(func_id) >= funcs.size())
+      funcs.resize(func_id + 1);
+    return funcs[func_id];
+  }
+
+  profile_entry_t &detach(csi_id_t detach_id, profile_kind kind) {
+    if (static_cast<size_t>(detach_id) >= detaches.size()) {
+      detaches.resize(detach_id + 1);
+      detach_kinds.resize(detach_id + 1, profile_kind::NONE);
+    }
+    detach_kinds[detach_id] = kind;
+    return detaches[detach_id];
+  }
+};
+
+class profile_t {
+  // Per-thread tables, registered in locals when first used.
+  std::mutex locals_lock;
+  std::vector<local_profile_t *> locals;
+
+  local_profile_t *register_local() {
+    local_profile_t *local = new local_profile_t();
+    std::lock_guard<std::mutex> guard(locals_lock);
+    locals.push_back(local);
+    return local;
+  }
+
+  // A row of the profile output.
+  struct row_t {
+    profile_kind kind;
+    csi_id_t id;
+    const profile_entry_t *entry;
+  };
+
+  static const char *kind_name(profile_kind kind) {
+    switch (kind) {
+    case profile_kind::FUNCTION:
+      return "function";
+    case profile_kind::SPAWN:
+      return "spawn";
+    case profile_kind::LOOP:
+      return "parallel_loop";
+    default:
+      return "unknown";
+    }
+  }
+
+  static void print_loc(std::ostream &OS, const source_loc_t *loc) {
+    if (!loc) {
+      OS << ",,,";
+      return;
+    }
+    OS << (loc->name ? loc->name : "") << ","
+       << (loc->filename ? loc->filename : "") << "," << loc->line_number
+       << "," << loc->column_number;
+  }
+
+public:
+  profile_t() {}
+  ~profile_t() {
+    for (local_profile_t *local : locals)
+      delete local;
+  }
+
+  local_profile_t &local() {
+    static thread_local local_profile_t *local = nullptr;
+    if (__builtin_expect(!local, false))
+      local = register_local();
+    return *local;
+  }
+
+  void record_func(csi_id_t func_id, const cilk_time_t &work,
+                   const cilk_time_t &span, const cilk_time_t &bspan) {
+    local().func(func_id).add(work, span, bspan);
+  }
+
+  void record_task(csi_id_t detach_id, bool is_loop_body,
+                   const cilk_time_t &work, const cilk_time_t &span,
+                   const cilk_time_t &bspan) {
+    local()
+        .detach(detach_id,
+                is_loop_body ? profile_kind::LOOP : profile_kind::SPAWN)
+        .add(work, span, bspan);
+  }
+
+  // Write the profile to OS as CSV, sorted by decreasing span.
+  void write(std::ostream &OS) {
+    // Merge the per-thread tables.
+    local_profile_t total;
+    {
+      std::lock_guard<std::mutex> guard(locals_lock);
+      for (local_profile_t *local : locals) {
+        for (size_t i = 0; i < local->funcs.size(); ++i)
+          total.func(i).merge(local->funcs[i]);
+        for (size_t i = 0; i < local->detaches.size(); ++i)
+          if (profile_kind::NONE != local->detach_kinds[i])
+            total.detach(i, local->detach_kinds[i]).merge(local->detaches[i]);
+      }
+    }
+
+    std::vector<row_t> rows;
+    for (size_t i = 0; i < total.funcs.size(); ++i)
+      if (total.funcs[i].count)
+        rows.push_back({profile_kind::FUNCTION, static_cast<csi_id_t>(i),
+                        &total.funcs[i]});
+    for (size_t i = 0; i < total.detaches.size(); ++i)
+      if (total.detaches[i].count)
+        rows.push_back({total.detach_kinds[i], static_cast<csi_id_t>(i),
+                        &total.detaches[i]});
+    std::stable_sort(rows.begin(), rows.end(),
+                     [](const row_t &a, const row_t &b) {
+                       return a.entry->span > b.entry->span;
+                     });
+
+    OS << "kind,id,name,file,line,column,count"
+       << ",work (" << cilk_time_t::units << ")"
+       << ",span (" << cilk_time_t::units << ")"
+       << ",parallelism"
+       << ",burdened_span (" << cilk_time_t::units << ")"
+       << ",burdened_parallelism\n";
+    for (const row_t &row : rows) {
+      const profile_entry_t &e = *row.entry;
+      OS << kind_name(row.kind) << "," << row.id << ",";
+      print_loc(OS, (profile_kind::FUNCTION == row.kind)
+                        ? __csi_get_func_source_loc(row.id)
+                        : __csi_get_detach_source_loc(row.id));
+      OS << "," << e.count << "," << e.work << "," << e.span << ","
+         << e.work.get_val_d() / e.span.get_val_d() << "," << e.bspan << ","
+         << e.work.get_val_d() / e.bspan.get_val_d() << "\n";
+    }
+  }
+};
+
+#endif // INCLUDED_PROFILE_H
@@ -0,0 +1,243 @@
+// -*- C++ -*-
+#ifndef INCLUDED_REGIONS_H
+#define INCLUDED_REGIONS_H
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "cilkscale_timer.h"
+
+// Named regions, delimited by wsp_region_begin() and wsp_region_end().
+// Regions may nest, and each distinct path of region names from the outermost
+// region is a node in a tree of regions.  Cilkscale aggregates the work and
+// span of all executions of each node in memory and writes a single report of
+// the tree at exit.
+
+using region_id_t = int32_t;
+static constexpr region_id_t NO_REGION = -1;
+
+// An open region, kept on the region stack of a shadow stack.
+struct open_region_t {
+  region_id_t id;
+  cilk_time_t work;
+  cilk_time_t span;
+  cilk_time_t bspan;
+  // Set if the dag of this execution of the region is recorded.
+  bool record_dag;
+};
+
+// The end of a region whose beginning is not on the region stack of the shadow
+// stack that ended it.  This happens when the region begins before a spawn and
+// ends in the continuation of that spawn, and the continuation is stolen.  The
+// end is matched with the beginning of the region when shadow stacks are
+// reduced.
+struct region_end_t {
+  cilk_time_t work;
+  cilk_time_t span;
+  cilk_time_t bspan;
+  // Index of the dag record that ends the region, or -1 if none was logged.
+  int64_t dag_index;
+};
+
+// Aggregated measurements of all executions of one region.
+struct region_stats_t {
+  uint64_t count = 0;
+  cilk_time_t work = cilk_time_t::zero();
+  cilk_time_t span = cilk_time_t::zero();
+  cilk_time_t bspan = cilk_time_t::zero();
+  cilk_time_t min_work = cilk_time_t::zero();
+  cilk_time_t max_work = cilk_time_t::zero();
+  cilk_time_t min_span = cilk_time_t::zero();
+  cilk_time_t max_span = cilk_time_t::zero();
+
+  void add(const cilk_time_t &w, const cilk_time_t &s, const cilk_time_t &b) {
+    if (0 == count++) {
+      min_work = max_work = w;
+      min_span = max_span = s;
+    } else {
+      if (min_work > w)
+        min_work = w;
+      if (w > max_work)
+        max_work = w;
+      if (min_span > s)
+        min_span = s;
+      if (s > max_span)
+        max_span = s;
+    }
+    work += w;
+    span += s;
+    bspan += b;
+  }
+
+  void merge(const region_stats_t &other) {
+    if (!other.count)
+      return;
+    if (!count) {
+      *this = other;
+      return;
+    }
+    count += other.count;
+    work += other.work;
+    span += other.span;
+    bspan += other.bspan;
+    if (min_work > other.min_work)
+      min_work = other.min_work;
+    if (other.max_work > max_work)
+      max_work = other.max_work;
+    if (min_span > other.min_span)
+      min_span = other.min_span;
+    if (other.max_span > max_span)
+      max_span = other.max_span;
+  }
+};
+
+class region_table_t {
+  struct node_t {
+    std::string name;
+    region_id_t parent;
+  };
+
+  // Key identifying a node by its parent and name.
+  struct key_t {
+    region_id_t parent;
+    std::string_view name;
+    bool operator==(const key_t &other) const {
+      return parent == other.parent && name == other.name;
+    }
+  };
+  struct key_hash_t {
+    size_t operator()(const key_t &key) const {
+      return std::hash<std::string_view>()(key.name) * 31 + key.parent;
+    }
+  };
+
+  // Nodes of the region tree.  A deque keeps the node names at stable
+  // addresses, so that keys can refer to them.
+  std::mutex lock;
+  std::deque<node_t> nodes;
+  std::unordered_map<key_t, region_id_t, key_hash_t> index;
+
+  // Per-thread state, registered in locals when first used.  Each thread
+  // caches the node lookups it has performed and aggregates measurements in
+  // its own table, so no synchronization is needed in the common case.
+  struct local_t {
+    std::unordered_map<key_t, region_id_t, key_hash_t> cache;
+    std::vector<region_stats_t> stats;
+  };
+  std::vector<local_t *> locals;
+
+  local_t &local() {
+    static thread_local local_t *local = nullptr;
+    if (__builtin_expect(!local, false)) {
+      local = new local_t();
+      std::lock_guard<std::mutex> guard(lock);
+      locals.push_back(local);
+    }
+    return *local;
+  }
+
+  std::string path(region_id_t id) {
+    const node_t &node = nodes[id];
+    if (NO_REGION == node.parent)
+      return node.name;
+    return path(node.parent) + "/" + node.name;
+  }
+
+  void write_subtree(std::ostream &OS, region_id_t parent,
+                     const std::vector<region_stats_t> &total,
+                     const std::vector<std::vector<region_id_t>> &children) {
+    for (region_id_t id : children[parent + 1]) {
+      const region_stats_t &s = total[id];
+      if (s.count)
+        OS << path(id) << "," << s.count << "," << s.work << "," << s.span
+           << "," << s.work.get_val_d() / s.span.get_val_d() << "," << s.bspan
+           << "," << s.work.get_val_d() / s.bspan.get_val_d() << ","
+           << s.min_work << "," << s.max_work << "," << s.min_span << ","
+           << s.max_span << "\n";
+      write_subtree(OS, id, total, children);
+    }
+  }
+
+public:
+  ~region_table_t() {
+    for (local_t *local : locals)
+      delete local;
+  }
+
+  // Get the ID of the region with the given name nested in parent.
+  region_id_t lookup(region_id_t parent, const char *name) {
+    local_t &l = local();
+    auto cached = l.cache.find(key_t{parent, name});
+    if (__builtin_expect(cached != l.cache.end(), true))
+      return cached->second;
+
+    region_id_t id;
+    const std::string *node_name;
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      auto found = index.find(key_t{parent, name});
+      if (found != index.end()) {
+        id = found->second;
+      } else {
+        id = static_cast<region_id_t>(nodes.size());
+        nodes.push_back(node_t{name, parent});
+        index.emplace(key_t{parent, nodes.back().name}, id);
+      }
+      node_name = &nodes[id].name;
+    }
+    // The cache key refers to the node name, which outlives the cache.
+    l.cache.emplace(key_t{parent, *node_name}, id);
+    return id;
+  }
+
+  void record(region_id_t id, const cilk_time_t &work, const cilk_time_t &span,
+              const cilk_time_t &bspan) {
+    local_t &l = local();
+    if (static_cast<size_t>(id) >= l.stats.size())
+      l.stats.resize(id + 1);
+    l.stats[id].add(work, span, bspan);
+  }
+
+  // Write the region tree to OS as CSV, in depth-first order.  Each region is
+  // identified by the slash-separated path of names from its outermost
+  // region.
+  void write(std::ostream &OS) {
+    std::lock_guard<std::mutex> guard(lock);
+    std::vector<region_stats_t> total(nodes.size());
+    for (local_t *local : locals)
+      for (size_t i = 0; i < local->stats.size(); ++i)
+        total[i].merge(local->stats[i]);
+
+    // Children of each node, indexed by node ID + 1, so that the roots are the
+    // children of NO_REGION.
+    std::vector<std::vector<region_id_t>> children(nodes.size() + 1);
+    for (size_t i = 0; i < nodes.size(); ++i)
+      children[nodes[i].parent + 1].push_back(static_cast<region_id_t>(i));
+
+    OS << "region,count"
+       << ",work (" << cilk_time_t::units << ")"
+       << ",span (" << cilk_time_t::units << ")"
+       << ",parallelism"
+       << ",burdened_span (" << cilk_time_t::units << ")"
+       << ",burdened_parallelism"
+       << ",min_work (" << cilk_time_t::units << ")"
+       << ",max_work (" << cilk_time_t::units << ")"
+       << ",min_span (" << cilk_time_t::units << ")"
+       << ",max_span (" << cilk_time_t::units << ")\n";
+    write_subtree(OS, NO_REGION, total, children);
+  }
+
+  bool empty() {
+    std::lock_guard<std::mutex> guard(lock);
+    return nodes.empty();
+  }
+};
+
+#endif // INCLUDED_REGIONS_H
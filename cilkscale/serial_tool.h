@@ -0,0 +1,80 @@
+// -*- C++ -*-
+#ifndef INCLUDED_SERIAL_TOOL_H
+#define INCLUDED_SERIAL_TOOL_H
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <cilk/cilk_api.h>
+
+// defined in libopencilk
+extern "C" int __cilkrts_is_initialized(void);
+extern "C" void __cilkrts_internal_set_nworkers(unsigned int nworkers);
+
+// Startup and shutdown of the Cilkscale tools that always run the program
+// serially, such as cilkscale-grain, cilkscale-alloc, and
+// cilkscale-working-set.  Each such tool keeps its state in an object of type
+// Impl_t, pointed to by a global tool pointer, and sets a global initialized
+// flag once __csi_init has run.  The tool object is created as soon as the
+// OpenCilk runtime is initialized and is destroyed when the runtime exits.
+
+// Ensure that this tool is run serially
+static inline void ensure_serial_tool(void) {
+  fprintf(stderr, "Forcing CILK_NWORKERS=1.\n");
+  if (__cilkrts_is_initialized()) {
+    __cilkrts_internal_set_nworkers(1);
+  } else {
+    // Force the number of Cilk workers to be 1.
+    char *e = getenv("CILK_NWORKERS");
+    if (!e || 0 != strcmp(e, "1")) {
+      if (setenv("CILK_NWORKERS", "1", 1)) {
+        fprintf(stderr, "Error setting CILK_NWORKERS to be 1\n");
+        exit(1);
+      }
+    }
+  }
+}
+
+// Create the tool object, for the initializer of the tool pointer.
+template <typename Impl_t> static Impl_t *create_serial_tool(void) {
+  if (!__cilkrts_is_initialized())
+    // If the OpenCilk runtime is not yet initialized, then csi_init will
+    // register a call to init_serial_tool to initialize the tool after the
+    // runtime is initialized.
+    return nullptr;
+
+  return new Impl_t();
+}
+
+// Custom function to intialize tool after the OpenCilk runtime is initialized.
+template <typename Impl_t, Impl_t *&tool> static void init_serial_tool(void) {
+  assert(nullptr == tool && "Tool already initialized");
+  tool = new Impl_t();
+}
+
+template <typename Impl_t, Impl_t *&tool, bool &initialized>
+static void destroy_serial_tool(void) {
+  if (tool) {
+    delete tool;
+    tool = nullptr;
+  }
+
+  initialized = false;
+}
+
+// Start the tool.  Called from __csi_init.
+template <typename Impl_t, Impl_t *&tool, bool &initialized>
+static void start_serial_tool(void) {
+  if (!__cilkrts_is_initialized())
+    __cilkrts_atinit(init_serial_tool<Impl_t, tool>);
+
+  __cilkrts_atexit(destroy_serial_tool<Impl_t, tool, initialized>);
+
+  ensure_serial_tool();
+
+  initialized = true;
+}
+
+#endif // INCLUDED_SERIAL_TOOL_H
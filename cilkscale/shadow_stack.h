@@ -3,6 +3,11 @@
 #define INCLUDED_SHADOW_STACK_H
 
 #include "cilkscale_timer.h"
+#include "critical_path.h"
+#include "dag.h"
+#include "locks.h"
+#include "parallelism_profile.h"
+#include "regions.h"
 
 #ifndef SERIAL_TOOL
 #define SERIAL_TOOL 1
@@ -48,6 +53,18 @@ struct shadow_stack_frame_t {
   // child
   cilk_time_t contin_bspan = cilk_time_t::zero();
 
+  // Paths that achieve lchild_span and contin_span, respectively, when
+  // critical-path tracking is enabled.
+  path_t lchild_path;
+  path_t contin_path;
+  // Portion of contin_span accounted for in contin_path.  Any time added to
+  // contin_span without being added to contin_path is added to the path at the
+  // next strand-ending event.
+  cilk_time_t contin_path_span = cilk_time_t::zero();
+
+  // Lock-aware spans, when lock contention is analyzed.
+  lock_spans_t locks;
+
   // Function type
   frame_type type = frame_type::NONE;
 
@@ -60,6 +77,65 @@ struct shadow_stack_frame_t {
     contin_span = cilk_time_t::zero();
     lchild_bspan = cilk_time_t::zero();
     contin_bspan = cilk_time_t::zero();
+    lchild_path.reset();
+    contin_path.reset();
+    contin_path_span = cilk_time_t::zero();
+    if (lock_spans_t::enabled)
+      locks.reset();
+  }
+
+  // Add the time of a strand, which ended with the given event, to the
+  // continuation of this frame.
+  void add_strand_time(duration_t strand_time, path_event event, csi_id_t id) {
+    contin_work += strand_time;
+    contin_span += strand_time;
+    contin_bspan += strand_time;
+
+    if (path_t::enabled) {
+      contin_path.extend(event, id, contin_span - contin_path_span);
+      contin_path_span = contin_span;
+    }
+  }
+
+  // Copy the continuation work and span of parent into this frame.
+  void inherit_contin(const shadow_stack_frame_t &parent) {
+    contin_work = parent.contin_work;
+    contin_span = parent.contin_span;
+    contin_bspan = parent.contin_bspan;
+    if (path_t::enabled) {
+      contin_path = parent.contin_path;
+      contin_path_span = parent.contin_path_span;
+    }
+    if (lock_spans_t::enabled)
+      locks.inherit(parent.locks);
+  }
+
+  // Account for a sync of all outstanding spawned children of this frame.
+  void sync() {
+    if (lock_spans_t::enabled)
+      locks.sync(contin_span, lchild_span,
+                 lchild_span > contin_span ? lchild_span : contin_span);
+
+    // Add achild_work to contin_work, and reset contin_work.
+    contin_work += achild_work;
+    achild_work = cilk_time_t::zero();
+
+    // Select the largest of lchild_span and contin_span, and then reset
+    // lchild_span.
+    if (lchild_span > contin_span) {
+      contin_span = lchild_span;
+      if (path_t::enabled) {
+        contin_path = std::move(lchild_path);
+        contin_path_span = lchild_span;
+      }
+    }
+    lchild_span = cilk_time_t::zero();
+    if (path_t::enabled)
+      lchild_path.reset();
+
+    if (lchild_bspan > contin_bspan)
+      contin_bspan = lchild_bspan;
+    lchild_bspan = cilk_time_t::zero();
   }
 };
 
@@ -72,6 +148,20 @@ struct shadow_stack_t {
   cilkscale_timer_t start;
   cilkscale_timer_t stop;
 
+  // Stack of named regions that have begun but not yet ended.
+  std::vector<open_region_t> regions;
+  // Ends of regions that began before this shadow stack was created, in order.
+  std::vector<region_end_t> region_ends;
+
+  // Table in which the regions matched by reductions are recorded.
+  static inline region_table_t *region_table = nullptr;
+
+  // Log of the computation dag, if dag recording is enabled.
+  dag_log_t dag;
+
+  // Log of strands for the parallelism profile, if it is enabled.
+  parallelism_log_t parallelism;
+
 private:
   // Dynamic array of shadow-stack frames.
   shadow_stack_frame_t *frames;
@@ -88,7 +178,11 @@ public:
     frames[0].init(type);
   }
 
-  shadow_stack_t(const shadow_stack_t &copy) : capacity(copy.capacity),
+  shadow_stack_t(const shadow_stack_t &copy) : regions(copy.regions),
+                                               region_ends(copy.region_ends),
+                                               dag(copy.dag),
+                                               parallelism(copy.parallelism),
+                                               capacity(copy.capacity),
                                                bot(copy.bot) {
     frames = new shadow_stack_frame_t[capacity];
     for (stack_index_t i = 0; i <= bot; ++i)
@@ -108,6 +202,11 @@ public:
     return frames[bot];
   }
 
+  shadow_stack_frame_t &peek_parent() const {
+    assert(bot > 0 && "No parent frame on shadow stack.");
+    return frames[bot - 1];
+  }
+
   shadow_stack_frame_t &push(frame_type type) {
     ++bot;
 
@@ -171,6 +270,15 @@ public:
             r_bot.contin_bspan, r_bot.lchild_bspan);
 #endif
 
+    // Work and spans in the right stack are relative to the continuation work
+    // and spans of the left stack.
+    cilk_time_t work_offset = l_bot.contin_work;
+    cilk_time_t span_offset = l_bot.contin_span;
+    cilk_time_t bspan_offset = l_bot.contin_bspan;
+
+    if (lock_spans_t::enabled)
+      l_bot.locks.append(r_bot.locks, l_bot.contin_span, r_bot.lchild_span);
+
     // Add the work variables from the right stack into the left.
     l_bot.contin_work += r_bot.contin_work;
     l_bot.achild_work += r_bot.achild_work;
@@ -179,9 +287,17 @@ public:
     // longest child, set this new span in keft.
     if (l_bot.contin_span + r_bot.lchild_span > l_bot.lchild_span) {
       l_bot.lchild_span = l_bot.contin_span + r_bot.lchild_span;
+      if (path_t::enabled) {
+        l_bot.lchild_path = l_bot.contin_path;
+        l_bot.lchild_path.append(r_bot.lchild_path);
+      }
     }
     // Add the continuation span from the right stack into the left.
     l_bot.contin_span += r_bot.contin_span;
+    if (path_t::enabled) {
+      l_bot.contin_path.append(r_bot.contin_path);
+      l_bot.contin_path_span += r_bot.contin_path_span;
+    }
 
     // If the left stack has a longer path from the root to the end of its
     // longest child, set this new span in keft.
@@ -191,12 +307,63 @@ public:
     // Add the continuation span from the right stack into the left.
     l_bot.contin_bspan += r_bot.contin_bspan;
 
+    // Regions ended in the right stack without beginning there are the
+    // innermost regions open in the left stack.  If the left stack has no open
+    // region left, the end is passed on to be matched by a later reduction.
+    for (region_end_t end : right->region_ends) {
+      end.work += work_offset;
+      end.span += span_offset;
+      end.bspan += bspan_offset;
+      if (left->regions.empty()) {
+        if (end.dag_index >= 0)
+          end.dag_index += left->dag.size();
+        left->region_ends.push_back(end);
+        continue;
+      }
+      const open_region_t &region = left->regions.back();
+      right->dag.resolve_region_end(end.dag_index, region.record_dag);
+      region_table->record(region.id, end.work - region.work,
+                           end.span - region.span, end.bspan - region.bspan);
+      left->regions.pop_back();
+    }
+    // Regions begun in the right stack were begun after those in the left.
+    for (open_region_t region : right->regions) {
+      region.work += work_offset;
+      region.span += span_offset;
+      region.bspan += bspan_offset;
+      left->regions.push_back(region);
+    }
+    // Likewise for the dag and strands logged in the right stack.
+    left->dag.append(right->dag);
+    left->parallelism.append(right->parallelism, span_offset);
+
     right->~shadow_stack_t();
   }
 
   duration_t elapsed_time() {
     return ::elapsed_time(&stop, &start);
   }
+
+  // End the current strand, which ends with the event at the program point
+  // id.  Adds the strand's execution time to the bottom frame and the
+  // parallelism profile, and returns that time.  The caller records the strand
+  // in the dag.
+  duration_t end_strand(path_event event, csi_id_t id) {
+    stop.gettime();
+    shadow_stack_frame_t &bottom = peek_bot();
+    duration_t strand_time = elapsed_time();
+    bottom.add_strand_time(strand_time, event, id);
+    parallelism.add(strand_time, bottom.contin_span);
+    return strand_time;
+  }
+
+  // End the current strand, as above, and record it in the dag as a strand
+  // ending with dag_ev.
+  duration_t end_strand(path_event event, csi_id_t id, dag_event dag_ev) {
+    duration_t strand_time = end_strand(event, id);
+    dag.add(dag_ev, strand_time);
+    return strand_time;
+  }
 };
 
 typedef shadow_stack_t _Hyperobject(shadow_stack_t::identity,
@@ -0,0 +1,571 @@
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <unistd.h>
+
+#include "serial_tool.h"
+#include <cilk/cilk_api.h>
+#include <csi/csi.h>
+
+#define CILKTOOL_API extern "C" __attribute__((visibility("default")))
+
+#ifndef TRACE_CALLS
+#define TRACE_CALLS 0
+#endif
+
+// Working-set and reuse-distance analyzer.
+//
+// The cilkscale-working-set tool uses the load and store hooks to estimate,
+// for the subtree of the spawn tree rooted at each spawned task, the number of
+// distinct cache lines the subtree touches, and a sampled histogram of the
+// reuse distances of the accesses in that subtree.  Tasks are aggregated by
+// spawn site and by depth, i.e., the number of enclosing instances of
+// functions that may spawn, so a divide-and-conquer kernel reports its working
+// set at each level of the recursion.  The program must be instrumented for
+// loads and stores.
+//
+// Distinct lines are counted with a HyperLogLog sketch per open task, which is
+// merged into the sketch of the enclosing task when the task exits.  Reuse
+// distances -- the number of distinct lines accessed between two accesses to
+// the same line -- are measured exactly on a spatially hashed sample of the
+// lines, one in CILKSCALE_REUSE_SAMPLING (default 64), and scaled by the
+// sampling period.
+//
+// The report compares working sets and reuse distances against the L1, L2, and
+// last-level cache sizes of the host, which CILKSCALE_CACHE_SIZES overrides
+// with a comma-separated list of three sizes in bytes.  For each spawn site,
+// it reports the shallowest depth from which the subproblems fit in each
+// cache.  The report is written as CSV to the file named by
+// CILKSCALE_WORKING_SET_OUT, or to stderr by default.
+
+///////////////////////////////////////////////////////////////////////////
+// Data structures for estimating working sets and reuse distances.
+
+static constexpr unsigned LG_CACHE_LINE_SIZE = 6;
+static constexpr uint64_t CACHE_LINE_SIZE = 1UL << LG_CACHE_LINE_SIZE;
+// Number of buckets in the reuse-distance histogram.  The last bucket is
+// open-ended, and the bounds of all buckets, in bytes, fit in 64 bits.
+static constexpr unsigned NUM_REUSE_BUCKETS = 64 - LG_CACHE_LINE_SIZE;
+
+static inline uint64_t hash_line(uint64_t line) {
+  // splitmix64 finalizer
+  line += 0x9e3779b97f4a7c15ULL;
+  line = (line ^ (line >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  line = (line ^ (line >> 27)) * 0x94d049bb133111ebULL;
+  return line ^ (line >> 31);
+}
+
+// Approximate counter of distinct cache lines.  The counter keeps the hashes of
+// the lines exactly while there are few of them, which keeps small tasks
+// cheap, and then switches to a HyperLogLog sketch.
+class distinct_lines_t {
+  static constexpr unsigned LG_REGISTERS = 8;
+  static constexpr unsigned NUM_REGISTERS = 1 << LG_REGISTERS;
+  static constexpr size_t MAX_SMALL = 32;
+
+  std::vector<uint64_t> small;
+  // HyperLogLog registers, empty until the counter switches to the sketch.
+  std::vector<uint8_t> registers;
+  // Hash of the last line inserted, to skip repeated accesses to a line.
+  uint64_t last = 0;
+  bool has_last = false;
+
+  void add_register(uint64_t hash) {
+    unsigned idx = hash >> (64 - LG_REGISTERS);
+    uint64_t rest = hash << LG_REGISTERS;
+    uint8_t rank =
+        rest ? __builtin_clzll(rest) + 1 : (64 - LG_REGISTERS + 1);
+    if (rank > registers[idx])
+      registers[idx] = rank;
+  }
+
+  void switch_to_sketch() {
+    registers.assign(NUM_REGISTERS, 0);
+    for (uint64_t hash : small)
+      add_register(hash);
+    small.clear();
+  }
+
+public:
+  void reset() {
+    small.clear();
+    registers.clear();
+    has_last = false;
+  }
+
+  void insert(uint64_t hash) {
+    if (has_last && hash == last)
+      return;
+    last = hash;
+    has_last = true;
+    if (registers.empty()) {
+      if (std::find(small.begin(), small.end(), hash) != small.end())
+        return;
+      if (small.size() < MAX_SMALL) {
+        small.push_back(hash);
+        return;
+      }
+      switch_to_sketch();
+    }
+    add_register(hash);
+  }
+
+  void merge(const distinct_lines_t &other) {
+    if (other.registers.empty()) {
+      for (uint64_t hash : other.small)
+        insert(hash);
+      return;
+    }
+    if (registers.empty())
+      switch_to_sketch();
+    for (unsigned i = 0; i < NUM_REGISTERS; ++i)
+      registers[i] = std::max(registers[i], other.registers[i]);
+  }
+
+  double estimate() const {
+    if (registers.empty())
+      return static_cast<double>(small.size());
+    double sum = 0.0;
+    unsigned zeros = 0;
+    for (uint8_t r : registers) {
+      sum += std::ldexp(1.0, -r);
+      zeros += (0 == r);
+    }
+    const double m = NUM_REGISTERS;
+    double e = (0.7213 / (1.0 + 1.079 / m)) * m * m / sum;
+    // Use linear counting for small cardinalities.
+    if (e <= 2.5 * m && zeros)
+      e = m * std::log(m / zeros);
+    return e;
+  }
+};
+
+// Tracker of reuse distances among the sampled lines.  A Fenwick tree over
+// access times marks the time of the latest access to each line, so the reuse
+// distance of an access is the number of marks since the previous access to
+// its line.
+class reuse_tracker_t {
+  std::unordered_map<uint64_t, uint32_t> last_access;
+  // Fenwick tree, indexed from 1.
+  std::vector<int32_t> tree;
+  uint32_t now = 0;
+
+  void add(uint32_t i, int32_t v) {
+    for (; i < tree.size(); i += i & -i)
+      tree[i] += v;
+  }
+  int64_t prefix(uint32_t i) const {
+    int64_t sum = 0;
+    for (; i > 0; i -= i & -i)
+      sum += tree[i];
+    return sum;
+  }
+
+  // Renumber the latest accesses of the lines consecutively, growing the tree
+  // if it would be more than half full.
+  void compact() {
+    std::vector<std::pair<uint32_t, uint64_t>> order;
+    order.reserve(last_access.size());
+    for (const auto &entry : last_access)
+      order.emplace_back(entry.second, entry.first);
+    std::sort(order.begin(), order.end());
+    size_t capacity = std::max(tree.size(), 4 * order.size() + 2);
+    tree.assign(capacity, 0);
+    now = 0;
+    for (const auto &entry : order) {
+      last_access[entry.second] = ++now;
+      add(now, 1);
+    }
+  }
+
+public:
+  reuse_tracker_t() : tree(1 << 16, 0) {}
+
+  // Record an access to line, and return its reuse distance in sampled lines,
+  // or -1 if this is the first access to the line.
+  int64_t access(uint64_t line) {
+    if (now + 1 >= tree.size())
+      compact();
+    ++now;
+    int64_t distance = -1;
+    auto ins = last_access.emplace(line, now);
+    if (!ins.second) {
+      uint32_t prev = ins.first->second;
+      distance = prefix(now - 1) - prefix(prev);
+      add(prev, -1);
+      ins.first->second = now;
+    }
+    add(now, 1);
+    return distance;
+  }
+};
+
+// Levels of the memory hierarchy that an access or working set fits in.
+enum cache_level_t : unsigned {
+  LEVEL_L1 = 0,
+  LEVEL_L2,
+  LEVEL_LLC,
+  LEVEL_MEMORY,
+  NUM_CACHE_LEVELS
+};
+
+static const char *cache_level_names[NUM_CACHE_LEVELS] = {"L1", "L2", "LLC",
+                                                          "memory"};
+
+// Sampled accesses by the cache level that their reuse distance fits in, and
+// sampled first accesses to a line.
+struct reuse_counts_t {
+  uint64_t reuses[NUM_CACHE_LEVELS] = {0};
+  uint64_t cold = 0;
+
+  void add(const reuse_counts_t &other) {
+    for (unsigned l = 0; l < NUM_CACHE_LEVELS; ++l)
+      reuses[l] += other.reuses[l];
+    cold += other.cold;
+  }
+};
+
+// Measurements of the tasks spawned at one spawn site and depth.
+struct working_set_stats_t {
+  uint64_t instances = 0;
+  double total_lines = 0.0;
+  double max_lines = 0.0;
+  reuse_counts_t counts;
+
+  double mean_lines() const {
+    return instances ? total_lines / instances : 0.0;
+  }
+};
+
+// A spawned task that has started but not yet exited.
+struct open_task_t {
+  csi_id_t detach_id;
+  // Lines touched and reuse distances sampled by the subtree of the task so
+  // far.
+  distinct_lines_t lines;
+  reuse_counts_t counts;
+  working_set_stats_t *stats;
+};
+
+// Top-level class to manage the state of the global tool.
+class WorkingSetImpl_t {
+public:
+  // Stack of open tasks.  Entry 0 is the root of the computation, and entries
+  // beyond num_open are kept to reuse their storage.
+  std::vector<open_task_t> tasks;
+  size_t num_open = 1;
+
+  // Number of open instances of functions that may spawn.
+  size_t depth = 0;
+
+  reuse_tracker_t reuse;
+  // Sample one in sampling_period lines for measuring reuse distances.
+  uint64_t sampling_period = 64;
+
+  // Sizes of the caches, in lines.
+  double cache_lines[LEVEL_MEMORY] = {32768 / CACHE_LINE_SIZE,
+                                      1048576 / CACHE_LINE_SIZE,
+                                      33554432 / CACHE_LINE_SIZE};
+
+  // Measurements by spawn site and depth.
+  std::map<std::pair<csi_id_t, size_t>, working_set_stats_t> stats;
+  working_set_stats_t program_stats;
+  // Histogram of the sampled reuse distances of the whole program, by the
+  // base-2 logarithm of the scaled distance.
+  uint64_t reuse_histogram[NUM_REUSE_BUCKETS] = {0};
+
+  cache_level_t level_of(double lines) const {
+    for (unsigned l = LEVEL_L1; l < LEVEL_MEMORY; ++l)
+      if (lines <= cache_lines[l])
+        return static_cast<cache_level_t>(l);
+    return LEVEL_MEMORY;
+  }
+
+  void access(uintptr_t addr, int32_t num_bytes) {
+    uint64_t first = addr >> LG_CACHE_LINE_SIZE;
+    uint64_t last = (addr + std::max(num_bytes, 1) - 1) >> LG_CACHE_LINE_SIZE;
+    open_task_t &task = tasks[num_open - 1];
+    for (uint64_t line = first; line <= last; ++line) {
+      uint64_t hash = hash_line(line);
+      task.lines.insert(hash);
+      if ((hash >> 32) % sampling_period)
+        continue;
+      int64_t distance = reuse.access(line);
+      if (distance < 0) {
+        ++task.counts.cold;
+        continue;
+      }
+      double scaled = static_cast<double>(distance) * sampling_period;
+      ++task.counts.reuses[level_of(scaled)];
+      unsigned bucket = scaled < 1.0 ? 0 : std::ilogb(scaled) + 1;
+      ++reuse_histogram[std::min(bucket, NUM_REUSE_BUCKETS - 1)];
+    }
+  }
+
+  void write_report(std::ostream &OS);
+
+  WorkingSetImpl_t();
+  ~WorkingSetImpl_t();
+};
+
+static WorkingSetImpl_t *tool = create_serial_tool<WorkingSetImpl_t>();
+
+bool WORKING_SET_INITIALIZED = false;
+
+///////////////////////////////////////////////////////////////////////////
+// Report
+
+static void write_loc(std::ostream &OS, const source_loc_t *loc) {
+  if (loc)
+    OS << (loc->name ? loc->name : "") << ","
+       << (loc->filename ? loc->filename : "") << "," << loc->line_number
+       << "," << loc->column_number;
+  else
+    OS << ",,,";
+}
+
+static void write_stats(std::ostream &OS, const working_set_stats_t &s,
+                        const WorkingSetImpl_t &impl) {
+  const reuse_counts_t &c = s.counts;
+  uint64_t sampled = c.cold;
+  for (unsigned l = 0; l < NUM_CACHE_LEVELS; ++l)
+    sampled += c.reuses[l];
+  OS << "," << s.instances << "," << s.mean_lines() << "," << s.max_lines
+     << "," << s.mean_lines() * CACHE_LINE_SIZE << ","
+     << s.max_lines * CACHE_LINE_SIZE << ","
+     << cache_level_names[impl.level_of(s.mean_lines())] << "," << sampled;
+  for (unsigned l = 0; l < NUM_CACHE_LEVELS; ++l)
+    OS << "," << (sampled ? static_cast<double>(c.reuses[l]) / sampled : 0.0);
+  OS << "," << (sampled ? static_cast<double>(c.cold) / sampled : 0.0)
+     << "\n";
+}
+
+void WorkingSetImpl_t::write_report(std::ostream &OS) {
+  OS << "kind,id,name,file,line,column,depth,instances,mean_lines,max_lines"
+     << ",mean_working_set (bytes),max_working_set (bytes),fits_in"
+     << ",sampled_accesses,reuse_in_L1,reuse_in_L2,reuse_in_LLC"
+     << ",reuse_beyond_LLC,cold\n";
+  OS << "program,,,,,,0";
+  write_stats(OS, program_stats, *this);
+  for (const auto &entry : stats) {
+    OS << "spawn," << entry.first.first << ",";
+    write_loc(OS, __csi_get_detach_source_loc(entry.first.first));
+    OS << "," << entry.first.second;
+    write_stats(OS, entry.second, *this);
+  }
+
+  // For each spawn site, report the shallowest depth from which the mean
+  // working sets of the subproblems at that depth and all deeper depths fit in
+  // each cache, or nothing if the deepest subproblems do not fit.
+  OS << "\nid,name,file,line,column,fits_in_L1_from_depth"
+     << ",fits_in_L2_from_depth,fits_in_LLC_from_depth\n";
+  for (auto it = stats.begin(); it != stats.end();) {
+    csi_id_t id = it->first.first;
+    size_t min_depth = it->first.second, max_depth = min_depth;
+    size_t from_depth[LEVEL_MEMORY] = {min_depth, min_depth, min_depth};
+    for (; it != stats.end() && it->first.first == id; ++it) {
+      max_depth = it->first.second;
+      cache_level_t level = level_of(it->second.mean_lines());
+      for (unsigned l = LEVEL_L1; l < LEVEL_MEMORY; ++l)
+        if (level > l)
+          from_depth[l] = max_depth + 1;
+    }
+    OS << id << ",";
+    write_loc(OS, __csi_get_detach_source_loc(id));
+    for (unsigned l = LEVEL_L1; l < LEVEL_MEMORY; ++l) {
+      OS << ",";
+      if (from_depth[l] <= max_depth)
+        OS << from_depth[l];
+    }
+    OS << "\n";
+  }
+
+  OS << "\nreuse_distance (bytes),sampled_accesses\n";
+  for (unsigned i = 0; i < NUM_REUSE_BUCKETS - 1; ++i)
+    if (reuse_histogram[i])
+      OS << "<" << (CACHE_LINE_SIZE << i) << "," << reuse_histogram[i]
+         << "\n";
+  if (reuse_histogram[NUM_REUSE_BUCKETS - 1])
+    OS << ">=" << (CACHE_LINE_SIZE << (NUM_REUSE_BUCKETS - 2)) << ","
+       << reuse_histogram[NUM_REUSE_BUCKETS - 1] << "\n";
+}
+
+///////////////////////////////////////////////////////////////////////////
+// Tool startup and shutdown
+
+WorkingSetImpl_t::WorkingSetImpl_t() {
+  tasks.resize(1);
+  tasks[0].detach_id = UNKNOWN_CSI_ID;
+  tasks[0].stats = &program_stats;
+
+  // Get the cache sizes of the host, if available.
+#if defined(_SC_LEVEL1_DCACHE_SIZE) && defined(_SC_LEVEL2_CACHE_SIZE) &&      \
+    defined(_SC_LEVEL3_CACHE_SIZE)
+  const int names[LEVEL_MEMORY] = {_SC_LEVEL1_DCACHE_SIZE,
+                                   _SC_LEVEL2_CACHE_SIZE,
+                                   _SC_LEVEL3_CACHE_SIZE};
+  for (unsigned l = LEVEL_L1; l < LEVEL_MEMORY; ++l) {
+    long size = sysconf(names[l]);
+    if (size > 0)
+      cache_lines[l] = size / CACHE_LINE_SIZE;
+  }
+#endif
+
+  if (const char *envstr = getenv("CILKSCALE_CACHE_SIZES")) {
+    double sizes[LEVEL_MEMORY];
+    if (3 == sscanf(envstr, "%lf,%lf,%lf", &sizes[LEVEL_L1], &sizes[LEVEL_L2],
+                    &sizes[LEVEL_LLC]) &&
+        sizes[LEVEL_L1] > 0.0 && sizes[LEVEL_L2] > 0.0 &&
+        sizes[LEVEL_LLC] > 0.0) {
+      for (unsigned l = LEVEL_L1; l < LEVEL_MEMORY; ++l)
+        cache_lines[l] = sizes[l] / CACHE_LINE_SIZE;
+    } else {
+      fprintf(stderr, "Cilkscale: ignoring invalid cache sizes %s\n", envstr);
+    }
+  }
+
+  if (const char *envstr = getenv("CILKSCALE_REUSE_SAMPLING")) {
+    long value = atol(envstr);
+    if (value > 0)
+      sampling_period = value;
+    else
+      fprintf(stderr, "Cilkscale: ignoring invalid reuse sampling %s\n",
+              envstr);
+  }
+}
+
+WorkingSetImpl_t::~WorkingSetImpl_t() {
+  // Account for the root of the computation.
+  double lines = tasks[0].lines.estimate();
+  program_stats.instances = 1;
+  program_stats.total_lines = lines;
+  program_stats.max_lines = lines;
+  program_stats.counts = tasks[0].counts;
+
+  // Write the report to the file named by CILKSCALE_WORKING_SET_OUT, or to
+  // stderr by default.
+  const char *out_file = getenv("CILKSCALE_WORKING_SET_OUT");
+  std::ofstream outf;
+  if (out_file) {
+    outf.open(out_file);
+    if (!outf.is_open())
+      fprintf(stderr, "Cilkscale: could not open working-set report file %s\n",
+              out_file);
+  }
+  if (outf.is_open())
+    write_report(outf);
+  else
+    write_report(std::cerr);
+}
+
+///////////////////////////////////////////////////////////////////////////
+// Hooks for operating the tool.
+
+CILKTOOL_API void __csi_init() {
+#if TRACE_CALLS
+  fprintf(stderr, "__csi_init()\n");
+#endif
+
+  start_serial_tool<WorkingSetImpl_t, tool, WORKING_SET_INITIALIZED>();
+}
+
+CILKTOOL_API void __csi_unit_init(const char *const file_name,
+                                  const instrumentation_counts_t counts) {
+  return;
+}
+
+CILKTOOL_API
+void __csi_func_entry(const csi_id_t func_id, const func_prop_t prop) {
+  if (!WORKING_SET_INITIALIZED || !tool)
+    return;
+  if (prop.may_spawn)
+    ++tool->depth;
+}
+
+CILKTOOL_API
+void __csi_func_exit(const csi_id_t func_exit_id, const csi_id_t func_id,
+                     const func_exit_prop_t prop) {
+  if (!WORKING_SET_INITIALIZED || !tool)
+    return;
+  if (prop.may_spawn && tool->depth > 0)
+    --tool->depth;
+}
+
+CILKTOOL_API
+void __csi_before_load(const csi_id_t load_id, const void *addr,
+                       const int32_t num_bytes, const load_prop_t prop) {
+  if (!WORKING_SET_INITIALIZED || !tool)
+    return;
+
+  tool->access(reinterpret_cast<uintptr_t>(addr), num_bytes);
+}
+
+CILKTOOL_API
+void __csi_before_store(const csi_id_t store_id, const void *addr,
+                        const int32_t num_bytes, const store_prop_t prop) {
+  if (!WORKING_SET_INITIALIZED || !tool)
+    return;
+
+  tool->access(reinterpret_cast<uintptr_t>(addr), num_bytes);
+}
+
+CILKTOOL_API
+void __csi_task(const csi_id_t task_id, const csi_id_t detach_id,
+                const task_prop_t prop) {
+  if (!WORKING_SET_INITIALIZED || !tool)
+    return;
+
+#if TRACE_CALLS
+  fprintf(stderr, "task(%ld, %ld)\n", task_id, detach_id);
+#endif
+
+  if (tool->num_open == tool->tasks.size())
+    tool->tasks.emplace_back();
+  open_task_t &task = tool->tasks[tool->num_open++];
+  task.detach_id = detach_id;
+  task.lines.reset();
+  task.counts = reuse_counts_t();
+  task.stats = &tool->stats[std::make_pair(detach_id, tool->depth)];
+}
+
+CILKTOOL_API
+void __csi_task_exit(const csi_id_t task_exit_id, const csi_id_t task_id,
+                     const csi_id_t detach_id, const unsigned sync_reg,
+                     const task_exit_prop_t prop) {
+  if (!WORKING_SET_INITIALIZED || !tool)
+    return;
+
+#if TRACE_CALLS
+  fprintf(stderr, "task_exit(%ld, %ld, %ld)\n", task_exit_id, task_id,
+          detach_id);
+#endif
+
+  // Close any tasks exited without their task_exit hook, e.g., by an
+  // exception.  The root of the computation is never closed.
+  while (tool->num_open > 1) {
+    open_task_t &task = tool->tasks[--tool->num_open];
+    double lines = task.lines.estimate();
+    working_set_stats_t &s = *task.stats;
+    ++s.instances;
+    s.total_lines += lines;
+    s.max_lines = std::max(s.max_lines, lines);
+    s.counts.add(task.counts);
+    // The subtree of the task belongs to the subtree of the enclosing task.
+    open_task_t &parent = tool->tasks[tool->num_open - 1];
+    parent.lines.merge(task.lines);
+    parent.counts.add(task.counts);
+    if (task.detach_id == detach_id)
+      break;
+  }
+}
@@ -73,6 +73,8 @@ static_assert(sizeof(instrumentation_counts_t) ==
               sizeof(csi_id_t) * NUM_FED_TYPES,
               "Mismatch between NUM_FED_TYPES and size of "
               "instrumentation_counts_t");
+static_assert((int)NUM_CSI_ID_TYPES == (int)NUM_FED_TYPES,
+              "Mismatch between NUM_FED_TYPES and NUM_CSI_ID_TYPES");
 
 // A SizeInfo table is a flat list of SizeInfo entries, indexed by a CSI ID.
 typedef struct {
@@ -86,6 +88,10 @@ typedef enum {
   NUM_SIZEINFO_TYPES // Must be last
 } sizeinfo_type_t;
 
+// Names of the allocation and free functions, indexed by the allocfn_ty and
+// free_ty properties, respectively.  cilksan/csanrt.cpp and
+// cilkscale/csanrt.cpp have their own tables, which also name posix_memalign,
+// strdup, and strndup.
 const char *allocfn_str[] =
   {
    "void *malloc(size_t size)",
@@ -179,6 +185,28 @@ static bool sizeinfo_tables_initialized = false;
 // which results in the __csi_init() function being called.
 static bool csi_init_called = false;
 
+// An interest of a tool in the IDs of some type, which selects either the IDs
+// in a range or the IDs whose source locations satisfy a filter.
+typedef struct id_interest_t {
+    bool enable;
+    csi_id_t first;
+    csi_id_t last;
+    csi_id_filter_t filter;
+    void *arg;
+    struct id_interest_t *next;
+} id_interest_t;
+
+// The lists of interests in IDs, in order of declaration.  This is indexed by
+// a value of 'fed_type_t'.
+static id_interest_t *id_interests[NUM_FED_TYPES] = {NULL};
+
+// The number of words allocated for the bits of each enable bitmap.  This is
+// indexed by a value of 'fed_type_t'.
+static uint64_t enabled_ids_capacity[NUM_FED_TYPES] = {0};
+
+// The bits of an enable bitmap that covers no IDs yet.
+static uint64_t no_enabled_ids[1] = {0};
+
 // ------------------------------------------------------------------------
 // Private function definitions
 // ------------------------------------------------------------------------
@@ -356,6 +384,126 @@ const sizeinfo_t *get_sizeinfo_entry(sizeinfo_type_t sizeinfo_type,
     }
 }
 
+// NOTE: The functions modifying the enable bitmaps are NOT thread safe.  Like
+// the FED tables, the bitmaps are never freed, in case they are being
+// accessed.
+
+// Return the number of IDs of the given type that have been loaded.
+static inline csi_id_t num_loaded_ids(fed_type_t fed_type) {
+    if (!fed_tables_initialized)
+        return 0;
+    return fed_tables[fed_type].num_total_entries;
+}
+
+// Set the bit of the given ID in the bitmap of the given type to enable.
+static inline void set_id_enabled(fed_type_t fed_type, csi_id_t csi_id,
+                                  bool enable) {
+    uint64_t *word = &__csi_enabled_ids[fed_type].bits[csi_id / 64];
+    uint64_t mask = ((uint64_t)1) << (csi_id % 64);
+    if (enable)
+        *word |= mask;
+    else
+        *word &= ~mask;
+}
+
+// Apply the given interest to the IDs of the given type in the range [first,
+// last), which have been loaded.
+static void apply_id_interest(fed_type_t fed_type,
+                              const id_interest_t *interest, csi_id_t first,
+                              csi_id_t last) {
+    if (interest->filter) {
+        for (csi_id_t csi_id = first; csi_id < last; ++csi_id)
+            if (interest->filter(get_fed_entry(fed_type, csi_id),
+                                 interest->arg))
+                set_id_enabled(fed_type, csi_id, interest->enable);
+        return;
+    }
+    if (first < interest->first)
+        first = interest->first;
+    if (last > interest->last)
+        last = interest->last;
+    for (csi_id_t csi_id = first; csi_id < last; ++csi_id)
+        set_id_enabled(fed_type, csi_id, interest->enable);
+}
+
+// Extend the bitmap of the given type, if the type has one, to the IDs loaded
+// since it was last extended, and apply all declared interests to those IDs.
+static void update_enabled_ids(fed_type_t fed_type) {
+    csi_id_bitmap_t *bitmap = &__csi_enabled_ids[fed_type];
+    if (!bitmap->bits)
+        return;
+    csi_id_t old_num_ids = bitmap->num_ids;
+    csi_id_t new_num_ids = num_loaded_ids(fed_type);
+    if (new_num_ids <= old_num_ids)
+        return;
+
+    uint64_t old_num_words = (old_num_ids + 63) / 64;
+    uint64_t new_num_words = (new_num_ids + 63) / 64;
+    uint64_t capacity = enabled_ids_capacity[fed_type];
+    if (new_num_words > capacity) {
+        // The old bits are not freed, because hooks running on other threads
+        // may still be reading them through __csi_id_enabled.  Doubling the
+        // capacity keeps the retired arrays smaller in total than the current
+        // one.
+        if (new_num_words < 2 * capacity)
+            new_num_words = 2 * capacity;
+        uint64_t *new_bits = (uint64_t *)calloc(sizeof(uint64_t), new_num_words);
+        assert(new_bits != NULL);
+        memcpy(new_bits, bitmap->bits, sizeof(uint64_t) * old_num_words);
+        bitmap->bits = new_bits;
+        enabled_ids_capacity[fed_type] = new_num_words;
+    }
+
+    for (const id_interest_t *interest = id_interests[fed_type]; interest;
+         interest = interest->next)
+        apply_id_interest(fed_type, interest, old_num_ids, new_num_ids);
+
+    // Publish the new IDs only after their bits are set.
+    bitmap->num_ids = new_num_ids;
+}
+
+// Declare an interest in IDs of the given type, and apply it to the IDs loaded
+// so far.
+static void add_id_interest(fed_type_t fed_type, id_interest_t interest) {
+    id_interest_t *new_interest = (id_interest_t *)malloc(sizeof(id_interest_t));
+    assert(new_interest != NULL);
+    *new_interest = interest;
+    new_interest->next = NULL;
+    id_interest_t **tail = &id_interests[fed_type];
+    while (*tail)
+        tail = &(*tail)->next;
+    *tail = new_interest;
+
+    csi_id_bitmap_t *bitmap = &__csi_enabled_ids[fed_type];
+    if (!bitmap->bits) {
+        // Once a tool declares an interest in a type, only the IDs it is
+        // interested in are enabled.  The bitmap starts out empty and is
+        // filled by update_enabled_ids.
+        bitmap->bits = no_enabled_ids;
+        bitmap->num_ids = 0;
+        update_enabled_ids(fed_type);
+    } else {
+        apply_id_interest(fed_type, new_interest, 0, bitmap->num_ids);
+    }
+}
+
+// Check if the file of the given source location is under the directory
+// named by arg.
+static bool is_loc_in_path(const source_loc_t *loc, void *arg) {
+    const char *path = (const char *)arg;
+    size_t path_len = strlen(path);
+    if (!loc || !loc->filename || 0 == path_len)
+        return false;
+    for (const char *match = strstr(loc->filename, path); match;
+         match = strstr(match + 1, path)) {
+        // The path must match whole components of the file name.
+        if ((match == loc->filename || match[-1] == '/') &&
+            (path[path_len - 1] == '/' || match[path_len] == '/'))
+            return true;
+    }
+    return false;
+}
+
 // ------------------------------------------------------------------------
 // External function definitions, including CSIRT API functions.
 // ------------------------------------------------------------------------
@@ -365,6 +513,9 @@ EXTERN_C
 // Not used at the moment
 // __thread bool __csi_disable_instrumentation;
 
+// The per-ID enable bitmaps.  This is indexed by a value of 'fed_type_t'.
+CSIRT_API csi_id_bitmap_t __csi_enabled_ids[NUM_CSI_ID_TYPES] = {{0, NULL}};
+
 typedef struct {
     int64_t num_entries;
     csi_id_t *id_base;
@@ -427,6 +578,10 @@ CSIRT_API void __csirt_unit_init(
         update_ids(i, unit_fed_tables[i].num_entries, unit_fed_tables[i].id_base);
     }
 
+    // Extend the enable bitmaps to the new unit's IDs.
+    for (unsigned i = 0; i < NUM_FED_TYPES; i++)
+        update_enabled_ids(i);
+
     // Add all SizeInfo tables from the new unit
     for (int i = 0; i < NUM_SIZEINFO_TYPES; ++i) {
         add_sizeinfo_table((sizeinfo_type_t)i, unit_sizeinfo_tables[i].num_entries,
@@ -449,6 +604,37 @@ CSIRT_API void __csirt_unit_init(
     assert(res);
 }
 
+CSIRT_API
+void __csi_enable_ids(const csi_id_type_t type, const csi_id_t first,
+                      const csi_id_t last) {
+    id_interest_t interest = {true, first, last, NULL, NULL, NULL};
+    add_id_interest((fed_type_t)type, interest);
+}
+
+CSIRT_API
+void __csi_disable_ids(const csi_id_type_t type, const csi_id_t first,
+                       const csi_id_t last) {
+    id_interest_t interest = {false, first, last, NULL, NULL, NULL};
+    add_id_interest((fed_type_t)type, interest);
+}
+
+CSIRT_API
+void __csi_enable_ids_if(const csi_id_type_t type, csi_id_filter_t filter,
+                         void *arg) {
+    id_interest_t interest = {true, 0, 0, filter, arg, NULL};
+    add_id_interest((fed_type_t)type, interest);
+}
+
+CSIRT_API
+void __csi_enable_ids_in_path(const csi_id_type_t type, const char *path) {
+    // Copy path, which the filter refers to for as long as the interest is
+    // registered.  strdup is not available in strict C11.
+    size_t len = strlen(path) + 1;
+    char *path_copy = (char *)malloc(len);
+    memcpy(path_copy, path, len);
+    __csi_enable_ids_if(type, is_loc_in_path, path_copy);
+}
+
 CSIRT_API
 __attribute__((const))
 const source_loc_t *__csi_get_func_source_loc(const csi_id_t func_id) {
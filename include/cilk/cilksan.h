@@ -16,6 +16,8 @@
 
 #endif // #ifdef __cplusplus
 
+#include <stddef.h>
+
 #ifdef __cilksan__
 
 CILKSAN_EXTERN_C void __cilksan_enable_checking(void) CILKSAN_NOTHROW;
@@ -32,6 +34,14 @@ __cilksan_register_lock_explicit(const void *mutex) CILKSAN_NOTHROW;
 CILKSAN_EXTERN_C void
 __cilksan_unregister_lock_explicit(const void *mutex) CILKSAN_NOTHROW;
 
+// Annotate [ptr, ptr+len) as private to the current strand, such as a scratch
+// buffer used by a single task.  Cilksan skips race checking on accesses to the
+// region, but warns if logically parallel strands access it.
+CILKSAN_EXTERN_C void __cilksan_mark_private(const void *ptr,
+                                             size_t len) CILKSAN_NOTHROW;
+CILKSAN_EXTERN_C void __cilksan_unmark_private(const void *ptr,
+                                               size_t len) CILKSAN_NOTHROW;
+
 #else // #ifdef __cilksan__
 
 #ifdef __cplusplus
@@ -50,6 +60,11 @@ static inline void
 __cilksan_register_lock_explicit(const void *mutex) CILKSAN_NOTHROW {}
 static inline void
 __cilksan_unregister_lock_explicit(const void *mutex) CILKSAN_NOTHROW {}
+
+static inline void __cilksan_mark_private(const void *ptr,
+                                          size_t len) CILKSAN_NOTHROW {}
+static inline void __cilksan_unmark_private(const void *ptr,
+                                            size_t len) CILKSAN_NOTHROW {}
 #ifdef __cplusplus
 } // extern "C"
 #endif // __cplusplus
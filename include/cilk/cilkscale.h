@@ -94,6 +94,17 @@ static inline wsp_t wsp_sub(wsp_t lhs, wsp_t rhs) CILKSCALE_NOTHROW {
 
 static inline void wsp_dump(wsp_t wsp, const char *tag) { return; }
 
+static inline void wsp_region_begin(const char *name) CILKSCALE_NOTHROW {
+  return;
+}
+
+static inline void wsp_region_end(void) CILKSCALE_NOTHROW { return; }
+
+static inline void wsp_sweep(const char *tag, void (*body)(void *),
+                             void *arg) {
+  body(arg);
+}
+
 #ifdef __cplusplus
 } // extern "C"
 #endif // __cplusplus
@@ -111,6 +122,27 @@ wsp_t wsp_sub(wsp_t lhs, wsp_t rhs) CILKSCALE_NOTHROW;
 CILKSCALE_EXTERN_C
 void wsp_dump(wsp_t wsp, const char *tag);
 
+// Begin and end a named region.  Regions may nest.  Cilkscale aggregates the
+// work and span of all executions of each region in memory, and writes a
+// report of all regions at program exit.
+CILKSCALE_EXTERN_C
+void wsp_region_begin(const char *name) CILKSCALE_NOTHROW;
+
+CILKSCALE_EXTERN_C
+void wsp_region_end(void) CILKSCALE_NOTHROW;
+
+// Run body(arg) and dump its measurements with the given tag.  When
+// cilkscale-benchmark is run with CILKSCALE_SWEEP set to a comma-separated
+// list of worker counts, body is instead re-executed at each of those worker
+// counts within this process, and its median execution time at P workers is
+// dumped with the tag "<tag>@P".  CILKSCALE_SWEEP_WARMUP and
+// CILKSCALE_SWEEP_REPS set the number of untimed and timed executions at each
+// worker count, which default to 1 and 3.  Because the worker count can only
+// change outside of parallel code, wsp_sweep must be called from serial code,
+// i.e., not from a function that spawns.
+CILKSCALE_EXTERN_C
+void wsp_sweep(const char *tag, void (*body)(void *), void *arg);
+
 #endif // #ifndef __cilkscale__
 
 #endif // INCLUDED_CILK_CILKSCALE_H
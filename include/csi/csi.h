@@ -347,4 +347,74 @@ const char *__csan_get_allocfn_str(const allocfn_prop_t prop);
 __attribute__((pure))
 const char *__csan_get_free_str(const free_prop_t prop);
 
+// Types of CSI IDs, each with its own ID space.  The order of these types
+// matches the order of the fields of instrumentation_counts_t.
+typedef enum {
+  CSI_ID_FUNC,
+  CSI_ID_FUNC_EXIT,
+  CSI_ID_LOOP,
+  CSI_ID_LOOP_EXIT,
+  CSI_ID_BB,
+  CSI_ID_CALLSITE,
+  CSI_ID_LOAD,
+  CSI_ID_STORE,
+  CSI_ID_DETACH,
+  CSI_ID_TASK,
+  CSI_ID_TASK_EXIT,
+  CSI_ID_DETACH_CONTINUE,
+  CSI_ID_SYNC,
+  CSI_ID_ALLOCA,
+  CSI_ID_ALLOCFN,
+  CSI_ID_FREE,
+  NUM_CSI_ID_TYPES // Must be last
+} csi_id_type_t;
+
+// Per-ID enable bitmaps.
+//
+// A tool that cares about only some of the IDs of a type declares its interest
+// in those IDs, by ID range or by source location, typically from __csi_init.
+// All IDs of a type are enabled until a tool first declares interest in that
+// type, after which only the IDs it declared interest in are enabled.  The CSI
+// runtime reevaluates the declared interests for the IDs of each unit it
+// initializes, so interests can be declared before the IDs they select are
+// loaded.  These functions are not thread safe.
+
+// Filter that selects an ID by its source location, which may be NULL.
+typedef bool (*csi_id_filter_t)(const source_loc_t *loc, void *arg);
+
+// Enable or disable the IDs of type type in the range [first, last).
+void __csi_enable_ids(const csi_id_type_t type, const csi_id_t first,
+                      const csi_id_t last);
+void __csi_disable_ids(const csi_id_type_t type, const csi_id_t first,
+                       const csi_id_t last);
+// Enable the IDs of type type whose source locations satisfy filter, which is
+// called with arg.
+void __csi_enable_ids_if(const csi_id_type_t type, csi_id_filter_t filter,
+                         void *arg);
+// Enable the IDs of type type in source files under the directory path, such
+// as "src/kernels".
+void __csi_enable_ids_in_path(const csi_id_type_t type, const char *path);
+
+// The enabled IDs of one type.  Bit (id % 64) of bits[id / 64] is set if id is
+// enabled.  If bits is NULL, all IDs are enabled.
+typedef struct {
+  // Number of IDs covered by bits.
+  csi_id_t num_ids;
+  uint64_t *bits;
+} csi_id_bitmap_t;
+
+extern csi_id_bitmap_t __csi_enabled_ids[NUM_CSI_ID_TYPES];
+
+// Check if id of type type is enabled.  Hooks can use this check to return
+// early for IDs the tool is not interested in.
+static inline bool __csi_id_enabled(const csi_id_type_t type,
+                                    const csi_id_t id) {
+  const csi_id_bitmap_t *bitmap = &__csi_enabled_ids[type];
+  if (!bitmap->bits)
+    return true;
+  if ((uint64_t)id >= (uint64_t)bitmap->num_ids)
+    return false;
+  return (bitmap->bits[id / 64] >> (id % 64)) & 1;
+}
+
 EXTERN_C_END
@@ -0,0 +1,59 @@
+// RUN: %clangxx_cilksan -fopencilk -Og %s -o %t -g
+// RUN: %run %t 2>&1 | FileCheck %s --check-prefixes=CHECK,CHECK-NOFS
+// RUN: env CILKSAN_FALSE_SHARING=1 %run %t 2>&1 | FileCheck %s --check-prefixes=CHECK,CHECK-FS
+
+#include <cilk/cilk.h>
+#include <cstdio>
+#include <cstdlib>
+
+constexpr int N = 8;
+constexpr int ITERS = 100;
+
+struct alignas(64) padded_t {
+  long val;
+};
+
+__attribute__((noinline))
+void update(long *counter, int i) {
+  for (int j = 0; j < ITERS; ++j)
+    *counter += i * j;
+}
+
+int main(int argc, char *argv[]) {
+  // Counters packed into a single cache line.
+  long *packed = (long *)aligned_alloc(64, N * sizeof(long));
+  // Counters padded to separate cache lines.
+  padded_t *padded = (padded_t *)aligned_alloc(64, N * sizeof(padded_t));
+  for (int i = 0; i < N; ++i) {
+    packed[i] = 0;
+    padded[i].val = 0;
+  }
+
+  cilk_for (int i = 0; i < N; ++i)
+    update(&packed[i], i);
+
+  cilk_for (int i = 0; i < N; ++i)
+    update(&padded[i].val, i);
+
+  long total = 0;
+  for (int i = 0; i < N; ++i)
+    total += packed[i] + padded[i].val;
+  printf("%ld\n", total);
+  free(packed);
+  free(padded);
+  return 0;
+}
+
+// CHECK: Cilksan detected 0 distinct races.
+
+// CHECK-NOFS-NOT: False sharing
+
+// CHECK-FS: False sharing on cache line {{[0-9a-f]+}}: {{[0-9]+}} conflicting accesses
+// CHECK-FS: Write
+// CHECK-FS-NEXT: counter
+// CHECK-FS: Write
+// CHECK-FS-NEXT: counter
+// CHECK-FS: Allocation context
+// CHECK-FS-NEXT: Heap object packed
+// CHECK-FS-NOT: Heap object padded
+// CHECK-FS: Cilksan detected false sharing on 1 cache lines.
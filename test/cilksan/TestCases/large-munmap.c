@@ -0,0 +1,71 @@
+// Check that Cilksan correctly clears shadow memory when unmapping buffers
+// that span multiple whole shadow pages.
+//
+// RUN: %clang_cilksan -fopencilk -Og %s -o %t -g
+// RUN: %run %t 2>&1 | FileCheck %s
+
+#include <cilk/cilk.h>
+#include <stdio.h>
+#include <sys/mman.h>
+
+#define GB (1UL << 30)
+#define LEN (3 * GB + 4096)
+
+__attribute__((noinline))
+void touch(char *buf, size_t off) {
+  buf[off] = 1;
+}
+
+// Write locations in the partial pages at either end of the buffer and in the
+// whole pages in between.
+__attribute__((noinline))
+void touch_all(char *buf) {
+  touch(buf, 0);
+  touch(buf, GB + 8);
+  touch(buf, 2 * GB + 8);
+  touch(buf, LEN - 1);
+}
+
+// Unmap the buffer, map fresh memory at the same addresses, and write the same
+// locations again.
+__attribute__((noinline))
+int remap_and_touch_all(char *buf) {
+  munmap(buf, LEN);
+  if (mmap(buf, LEN, PROT_READ | PROT_WRITE,
+           MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1,
+           0) != buf) {
+    perror("mmap");
+    return 1;
+  }
+  touch_all(buf);
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  char *buf = (char *)mmap(NULL, LEN, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (buf == MAP_FAILED) {
+    perror("mmap");
+    return 1;
+  }
+
+  // The spawned writes are logically parallel with the writes in the
+  // continuation, but the continuation first unmaps the memory they wrote.
+  // Unless the shadow memory for the whole range was cleared, the writes to the
+  // new mapping appear to race with the spawned writes.
+  int err;
+  cilk_scope {
+    cilk_spawn touch_all(buf);
+    err = remap_and_touch_all(buf);
+  }
+  if (err)
+    return 1;
+
+  munmap(buf, LEN);
+  return 0;
+}
+
+// CHECK-NOT: Race detected on location
+
+// CHECK: Cilksan detected 0 distinct races.
+// CHECK-NEXT: Cilksan suppressed 0 duplicate race reports.
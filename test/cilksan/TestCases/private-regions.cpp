@@ -0,0 +1,56 @@
+// RUN: %clangxx_cilksan -fopencilk -Og %s -o %t -g
+// RUN: %run %t 2>&1 | FileCheck %s
+
+#include <cilk/cilk.h>
+#include <cilk/cilksan.h>
+#include <cstdio>
+#include <cstdlib>
+
+constexpr int N = 64;
+constexpr int WS = 256;
+
+__attribute__((noinline))
+double kernel(double *ws, int i) {
+  double sum = 0.0;
+  for (int j = 0; j < WS; ++j)
+    ws[j] = i * j;
+  for (int j = 0; j < WS; ++j)
+    sum += ws[j];
+  return sum;
+}
+
+__attribute__((noinline))
+void fill(double *buf, int i) {
+  buf[i % WS] = i;
+}
+
+int main(int argc, char *argv[]) {
+  double results[N];
+
+  // Per-task workspaces are private to each iteration.
+  cilk_for (int i = 0; i < N; ++i) {
+    double *ws = (double *)malloc(WS * sizeof(double));
+    __cilksan_mark_private(ws, WS * sizeof(double));
+    results[i] = kernel(ws, i);
+    __cilksan_unmark_private(ws, WS * sizeof(double));
+    free(ws);
+  }
+
+  // A shared buffer incorrectly annotated as private.
+  double *shared = (double *)malloc(WS * sizeof(double));
+  __cilksan_mark_private(shared, WS * sizeof(double));
+  cilk_for (int i = 0; i < N; ++i)
+    fill(shared, i);
+  __cilksan_unmark_private(shared, WS * sizeof(double));
+
+// CHECK: Cilksan Warning: Private region [0x{{[0-9a-f]+}}, 0x{{[0-9a-f]+}}) accessed by parallel strands at fill
+
+  double total = 0.0;
+  for (int i = 0; i < N; ++i)
+    total += results[i] + shared[i];
+  printf("%f\n", total);
+  free(shared);
+  return 0;
+}
+
+// CHECK: Cilksan detected 0 distinct races.
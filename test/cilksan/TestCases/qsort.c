@@ -0,0 +1,66 @@
+// RUN: %clang_cilksan -fopencilk -Og %s -o %t -g
+// RUN: %run %t 2>&1 | FileCheck %s
+
+#include <cilk/cilk.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define N 1000
+
+int key_offset = 0;
+
+__attribute__((noinline))
+int compare(const void *a, const void *b) {
+  int x = *(const int *)a + key_offset;
+  int y = *(const int *)b + key_offset;
+  return (x > y) - (x < y);
+}
+
+__attribute__((noinline))
+void sort(int *arr, size_t n) {
+  qsort(arr, n, sizeof(int), compare);
+}
+
+int main(int argc, char *argv[]) {
+  int *a = (int *)malloc(N * sizeof(int));
+  int *b = (int *)malloc(N * sizeof(int));
+  for (int i = 0; i < N; ++i) {
+    a[i] = rand();
+    b[i] = rand();
+  }
+
+  // Sorting disjoint arrays in parallel is race free.
+  cilk_scope {
+    cilk_spawn sort(a, N);
+    sort(b, N);
+  }
+
+  // The comparator races with the parallel update to key_offset.
+  cilk_scope {
+    cilk_spawn sort(a, N);
+    key_offset = 1;
+  }
+
+// CHECK: Race detected on location
+// CHECK-NEXT: * Read {{[0-9a-f]+}} compare
+// CHECK-NEXT: to variable key_offset
+
+  // Sorting an array in parallel with a write to it races.
+  cilk_scope {
+    cilk_spawn sort(b, N);
+    b[N / 2] = 0;
+  }
+
+// CHECK: Race detected on location
+// CHECK-NEXT: * {{Read|Write}} {{[0-9a-f]+}} {{compare|sort}}
+// CHECK: * Write {{[0-9a-f]+}} main
+
+  int *found = (int *)bsearch(&a[N / 2], a, N, sizeof(int), compare);
+  printf("%d %d\n", a[0] <= a[N - 1], found == &a[N / 2]);
+
+  free(a);
+  free(b);
+  return 0;
+}
+
+// CHECK: Cilksan detected {{[1-9][0-9]*}} distinct races.
@@ -0,0 +1,33 @@
+// RUN: %clangxx_cilksan -fopencilk -Og %s -o %t -g
+// RUN: %run %t 2>&1 | FileCheck %s --check-prefixes=CHECK,CHECK-NOPROF
+// RUN: env CILKSAN_REDUCER_PROFILE=1 %run %t 2>&1 | FileCheck %s --check-prefixes=CHECK,CHECK-PROF
+
+#include <cilk/cilk.h>
+#include <cilk/opadd_reducer.h>
+#include <cstdio>
+
+constexpr int N = 1000;
+
+__attribute__((noinline))
+long sum_reducer(int n) {
+  cilk::opadd_reducer<long> sum = 0;
+  cilk_for (int i = 0; i < n; ++i)
+    sum += i;
+  return sum;
+}
+
+int main(int argc, char *argv[]) {
+  printf("%ld\n", sum_reducer(N));
+  return 0;
+}
+
+// CHECK: Cilksan detected 0 distinct races.
+
+// CHECK-NOPROF-NOT: Cilksan reducer profile
+
+// CHECK-PROF: Cilksan reducer profile:
+// CHECK-PROF-NEXT: register site,file,line,column,reducers,lookups,views created,identity time (ns),reductions,reduce time (ns)
+// CHECK-PROF-NEXT: sum_reducer,{{.*}}reducer-profile.cpp,13,{{[0-9]+}},1,[[LOOKUPS:[1-9][0-9]*]],[[VIEWS:[1-9][0-9]*]],{{[0-9]+}},[[VIEWS]],{{[0-9]+}}
+// CHECK-PROF: simulated steals with views,{{[1-9][0-9]*}}
+// CHECK-PROF-NEXT: views per steal,{{[0-9.]+}}
+// CHECK-PROF-NEXT: max views per steal,1
@@ -0,0 +1,40 @@
+// RUN: %clang_cilksan -fopencilk -Og %s -o %t -g
+// RUN: env CILKSAN_STATS=1 %run %t 2>&1 | FileCheck %s --check-prefix=CSV
+// RUN: env CILKSAN_STATS=json %run %t 2>&1 | FileCheck %s --check-prefix=JSON
+
+#include <cilk/cilk.h>
+#include <stdio.h>
+
+#define N 1000
+
+int a[N];
+
+int main(int argc, char *argv[]) {
+  cilk_for (int i = 0; i < N; ++i)
+    a[i] = i;
+  long sum = 0;
+  for (int i = 0; i < N; ++i)
+    sum += a[i];
+  printf("%ld\n", sum);
+  return 0;
+}
+
+// CSV: Cilksan detected 0 distinct races.
+// CSV: ,size (bytes),count
+// CSV: {{^}}writes,4,{{[1-9][0-9]*}}
+// CSV: total writes,,{{[1-9][0-9]*}}
+// CSV: hook store,,{{[1-9][0-9]*}}
+// CSV: occupancy filter hit rate,,{{[0-9.]+}}
+// CSV: fast path ratio,,{{[0-9.]+}}
+// CSV: shadow lines allocated,,{{[1-9][0-9]*}}
+// CSV: DS nodes live,,{{[0-9]+}}
+
+// JSON: Cilksan detected 0 distinct races.
+// JSON: {
+// JSON: "writes": {{.*}}"4": {{[1-9][0-9]*}}
+// JSON: "hooks": {
+// JSON-SAME: "store": {{[1-9][0-9]*}}
+// JSON: "occupancy_filter_hit_rate":
+// JSON: "fast_path_ratio":
+// JSON: "max_ds_nodes_live": {{[0-9]+}}
+// JSON-NEXT: }
@@ -0,0 +1,56 @@
+// RUN: %clang_cilksan -fopencilk -Og %s -o %t -g
+// RUN: echo "# Benign races on counters" > %t.supp
+// RUN: echo "fun:bump_counter" >> %t.supp
+// RUN: echo "alloc:suppressions.c:34" >> %t.supp
+// RUN: %run %t 2>&1 | FileCheck %s --check-prefixes=CHECK,CHECK-NOSUPP
+// RUN: env CILKSAN_SUPPRESSIONS=%t.supp %run %t 2>&1 | FileCheck %s --check-prefixes=CHECK,CHECK-SUPP
+
+#include <cilk/cilk.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+long counter = 0;
+long global = 0;
+
+__attribute__((noinline))
+void bump_counter(long *c) {
+  (*c)++;
+}
+
+__attribute__((noinline))
+void update(long *x) {
+  (*x)++;
+}
+
+int main(int argc, char *argv[]) {
+  cilk_for (int i = 0; i < 100; ++i)
+    bump_counter(&counter);
+  printf("%ld\n", counter);
+
+// CHECK-NOSUPP: Race detected on location
+// CHECK-NOSUPP-NEXT: * Write {{[0-9a-f]+}} bump_counter
+// CHECK-SUPP-NOT: bump_counter
+
+  long *stats = (long *)malloc(sizeof(long));
+  *stats = 0;
+  cilk_for (int i = 0; i < 100; ++i)
+    update(stats);
+  printf("%ld\n", *stats);
+  free(stats);
+
+// CHECK-NOSUPP: Race detected on location
+// CHECK-NOSUPP: Heap object
+// CHECK-SUPP-NOT: Heap object
+
+  cilk_for (int i = 0; i < 100; ++i)
+    update(&global);
+  printf("%ld\n", global);
+
+// CHECK: Race detected on location
+// CHECK-NEXT: * Write {{[0-9a-f]+}} update
+
+  return 0;
+}
+
+// CHECK-NOSUPP: Cilksan detected 6 distinct races.
+// CHECK-SUPP: Cilksan detected 2 distinct races.
@@ -0,0 +1,25 @@
+// RUN: %clang_csi_toolc %tooldir/null-tool.c -o %t-null-tool.o
+// RUN: %clang_csi_toolc %tooldir/enable-ids-in-path-tool.c -o %t-tool.o
+// RUN: %link_csi %t-tool.o %t-null-tool.o -o %t-tool.o
+// RUN: %clang_csi_c %s -o %t.o
+// RUN: %clang_csi_c %supportdir/a.c -o %t.a.o
+// RUN: %clang_csi_c %supportdir/b.c -o %t.b.o
+// RUN: %clang_csi %t.o %t.a.o %t.b.o %t-tool.o -o %t
+// RUN: %run %t | FileCheck %s
+
+#include <stdio.h>
+
+#include "support/a.h"
+
+int main(int argc, char **argv) {
+  printf("In main.\n");
+  a();
+  // Only the functions in the support directory are enabled.
+  // CHECK-NOT: Enter function main
+  // CHECK: In main.
+  // CHECK-NEXT: Enter function a
+  // CHECK-NEXT: In a.
+  // CHECK-NEXT: Enter function b
+  // CHECK-NEXT: In b.
+  return 0;
+}
@@ -0,0 +1,12 @@
+#include <stdio.h>
+#include "csi.h"
+
+void __csi_init() {
+    __csi_enable_ids_in_path(CSI_ID_FUNC, "support");
+}
+
+void __csi_func_entry(const csi_id_t func_id, const func_prop_t prop) {
+    if (!__csi_id_enabled(CSI_ID_FUNC, func_id))
+        return;
+    printf("Enter function %s\n", __csi_get_func_source_loc(func_id)->name);
+}